@@ -0,0 +1,85 @@
+#include <benchmark/benchmark.h>
+
+#include <ActiveObject.h>
+#include <Storage.h>
+
+#include <mutex>
+
+namespace
+{
+    struct Counter
+    {
+        int add(int value)
+        {
+            count += value;
+            return count;
+        }
+
+        int count = 0;
+    };
+
+    // stands in for an interface with 'int add(int);'
+    class Countable
+    {
+    public:
+        Countable()
+            : impl_(Counter())
+        {}
+
+        int add(int value)
+        {
+            return impl_.get<Counter>().add(value);
+        }
+
+    private:
+        clang::type_erasure::Storage<false> impl_;
+    };
+
+    // what '-active-object' replaces: an interface behind an external mutex
+    struct Locked
+    {
+        int add(int value)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return value_.add(value);
+        }
+
+        std::mutex mutex;
+        Countable value_;
+    };
+
+    clang::type_erasure::ActiveObject<Countable>& active()
+    {
+        static clang::type_erasure::ActiveObject<Countable> object{Countable()};
+        return object;
+    }
+}
+
+static void active_object_mutex(benchmark::State& state)
+{
+    static Locked object;
+    for(auto _ : state)
+        benchmark::DoNotOptimize(object.add(1));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(active_object_mutex)->ThreadRange(1, 8)->UseRealTime();
+
+// enqueues without allocation and without waiting for the result
+static void active_object_post(benchmark::State& state)
+{
+    for(auto _ : state)
+        active().post([](Countable& object) { return object.add(1); }, [](int count) { benchmark::DoNotOptimize(count); });
+    // wait for the calls of this thread
+    active().call([](Countable& object) { return object.add(0); }).get();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(active_object_post)->ThreadRange(1, 8)->UseRealTime();
+
+// round trip through a future, which allocates its shared state
+static void active_object_future(benchmark::State& state)
+{
+    for(auto _ : state)
+        benchmark::DoNotOptimize(active().call([](Countable& object) { return object.add(1); }).get());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(active_object_future)->ThreadRange(1, 8)->UseRealTime();
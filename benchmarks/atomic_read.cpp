@@ -0,0 +1,117 @@
+#include <benchmark/benchmark.h>
+
+#include <Atomic.h>
+#include <Storage.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct Payload
+    {
+        explicit Payload(int value)
+            : values(64, value)
+        {}
+
+        int front() const
+        {
+            return values.front();
+        }
+
+        std::vector<int> values;
+    };
+
+    using Storage = clang::type_erasure::COWStorage<false>;
+
+    // Publishes new values while the readers run.
+    class ConcurrentWriter
+    {
+    public:
+        template <class Publish>
+        void start(Publish publish)
+        {
+            done = false;
+            writer = std::thread([this, publish]
+            {
+                for(int i = 0; !done.load(std::memory_order_relaxed); ++i)
+                    publish(i);
+            });
+        }
+
+        void stop()
+        {
+            done = true;
+            writer.join();
+        }
+
+    private:
+        std::atomic<bool> done{false};
+        std::thread writer;
+    };
+
+    ConcurrentWriter writer;
+
+    clang::type_erasure::Atomic<Storage>& atomic()
+    {
+        static clang::type_erasure::Atomic<Storage> instance{ Storage(Payload(0)) };
+        return instance;
+    }
+
+    struct Locked
+    {
+        std::mutex mutex;
+        Storage value = Storage(Payload(0));
+    };
+
+    Locked& locked()
+    {
+        static Locked instance;
+        return instance;
+    }
+
+    void StartAtomicWriter(const benchmark::State&)
+    {
+        writer.start([](int i) { atomic().store(Storage(Payload(i))); });
+    }
+
+    void StartLockedWriter(const benchmark::State&)
+    {
+        writer.start([](int i)
+        {
+            auto value = Storage(Payload(i));
+            std::lock_guard<std::mutex> lock(locked().mutex);
+            locked().value = std::move(value);
+        });
+    }
+
+    void StopWriter(const benchmark::State&)
+    {
+        writer.stop();
+    }
+
+    void BM_Atomic_Read(benchmark::State& state)
+    {
+        for(auto _ : state)
+        {
+            const auto snapshot = atomic().load();
+            benchmark::DoNotOptimize(snapshot->get<Payload>().front());
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    void BM_Mutex_Read(benchmark::State& state)
+    {
+        for(auto _ : state)
+        {
+            std::lock_guard<std::mutex> lock(locked().mutex);
+            benchmark::DoNotOptimize(static_cast<const Storage&>(locked().value).get<Payload>().front());
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+}
+
+BENCHMARK(BM_Atomic_Read)->ThreadRange(1, 32)->UseRealTime()->Setup(StartAtomicWriter)->Teardown(StopWriter);
+BENCHMARK(BM_Mutex_Read)->ThreadRange(1, 32)->UseRealTime()->Setup(StartLockedWriter)->Teardown(StopWriter);
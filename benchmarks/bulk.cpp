@@ -0,0 +1,171 @@
+#include <benchmark/benchmark.h>
+
+#include <Storage.h>
+#include <TypeErasureUtil.h>
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+    // as generated with 'clang-type-erase -custom -sbo -buffer-size=16 -bulk' for
+    // struct Shape { double area() const; };
+    class Shape;
+
+    namespace ShapeDetail
+    {
+        template <class Interface>
+        struct Table
+        {
+            using area_function = double (*)(const void*);
+            area_function area;
+            using area_n_function = void (*)(const void* const*, std::size_t, double*);
+            area_n_function area_n;
+        };
+
+        template <class T>
+        using TryBulkMemFn_area = decltype(T::area_n(std::declval<const T* const*>(), std::size_t(), std::declval<double*>()));
+
+        template <class T, class = void>
+        struct HasBulkMemFn_area : std::false_type
+        {};
+
+        template <class T>
+        struct HasBulkMemFn_area<T, type_erasure_table_detail::voider<TryBulkMemFn_area<T>>> : std::true_type
+        {};
+
+        template <class Interface, class Impl>
+        struct execution_wrapper
+        {
+            static double area(const void* data)
+            {
+                return type_erasure_table_detail::object_access<Impl>::get(data).area();
+            }
+
+            static void area_n(const void* const* data, std::size_t count, double* results)
+            {
+                area_n(HasBulkMemFn_area<Impl>(), data, count, results);
+            }
+
+            static void area_n(std::true_type, const void* const* data, std::size_t count, double* results)
+            {
+                type_erasure_table_detail::for_each_chunk<Impl>(data, count, [&](const Impl* const* objects, std::size_t first, std::size_t n)
+                {
+                    Impl::area_n(objects, n, results + first);
+                });
+            }
+
+            static void area_n(std::false_type, const void* const* data, std::size_t count, double* results)
+            {
+                for(std::size_t i = 0; i < count; ++i)
+                    results[i] = area(data[i]);
+            }
+        };
+    }
+
+    class Shape
+    {
+    public:
+        template <class T,
+                  std::enable_if_t<!std::is_same<std::decay_t<T>, Shape>::value>* = nullptr>
+        Shape(T&& value)
+            : function_({&ShapeDetail::execution_wrapper<Shape, std::decay_t<T>>::area,
+                         &ShapeDetail::execution_wrapper<Shape, std::decay_t<T>>::area_n}),
+              impl_(std::forward<T>(value))
+        {}
+
+        double area() const
+        {
+            return function_.area(impl_.object());
+        }
+
+        static void area_n(const Shape* objects, std::size_t count, double* results)
+        {
+            type_erasure_table_detail::for_each_run(objects, count,
+                                                    [](const Shape& object) { return object.function_.area_n; },
+                                                    [](const Shape& object) { return object.impl_.object(); },
+                                                    [&](const void* const* data, std::size_t first, std::size_t n)
+            {
+                objects[first].function_.area_n(data, n, results + first);
+            });
+        }
+
+    private:
+        ShapeDetail::Table<Shape> function_;
+        clang::type_erasure::SBOStorage<16, false, Shape> impl_;
+    };
+
+    struct Square
+    {
+        double area() const
+        {
+            return side * side;
+        }
+
+        double side;
+    };
+
+    struct BulkSquare
+    {
+        double area() const
+        {
+            return side * side;
+        }
+
+        static void area_n(const BulkSquare* const* objects, std::size_t count, double* results)
+        {
+            for(std::size_t i = 0; i < count; ++i)
+                results[i] = objects[i]->side * objects[i]->side;
+        }
+
+        double side;
+    };
+
+    template <class Impl>
+    std::vector<Shape> makeShapes(std::size_t count)
+    {
+        std::vector<Shape> shapes;
+        shapes.reserve(count);
+        for(std::size_t i = 0; i < count; ++i)
+            shapes.emplace_back(Impl{double(i)});
+        return shapes;
+    }
+}
+
+static void bulk_area_scalar_calls(benchmark::State& state)
+{
+    const auto shapes = makeShapes<BulkSquare>(state.range(0));
+    std::vector<double> areas(shapes.size());
+    for(auto _ : state)
+    {
+        for(std::size_t i = 0; i < shapes.size(); ++i)
+            areas[i] = shapes[i].area();
+        benchmark::DoNotOptimize(areas.data());
+    }
+}
+BENCHMARK(bulk_area_scalar_calls)->Arg(1000);
+
+static void bulk_area_fallback(benchmark::State& state)
+{
+    const auto shapes = makeShapes<Square>(state.range(0));
+    std::vector<double> areas(shapes.size());
+    for(auto _ : state)
+    {
+        Shape::area_n(shapes.data(), shapes.size(), areas.data());
+        benchmark::DoNotOptimize(areas.data());
+    }
+}
+BENCHMARK(bulk_area_fallback)->Arg(1000);
+
+static void bulk_area_implementation(benchmark::State& state)
+{
+    const auto shapes = makeShapes<BulkSquare>(state.range(0));
+    std::vector<double> areas(shapes.size());
+    for(auto _ : state)
+    {
+        Shape::area_n(shapes.data(), shapes.size(), areas.data());
+        benchmark::DoNotOptimize(areas.data());
+    }
+}
+BENCHMARK(bulk_area_implementation)->Arg(1000);
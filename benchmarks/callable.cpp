@@ -0,0 +1,103 @@
+#include <benchmark/benchmark.h>
+
+#include <Storage.h>
+#include <TypeErasureUtil.h>
+
+#include <functional>
+#include <type_traits>
+
+namespace
+{
+    // as generated with 'clang-type-erase -function "int(int)" -name Callback -custom -sbo -buffer-size=32 -non-copyable'
+    class Callback;
+
+    namespace CallbackDetail
+    {
+        template <class Interface>
+        struct Table
+        {
+            using call_int_function = int (*)(void*, int);
+            call_int_function call_int;
+        };
+
+        template <class Interface, class Impl>
+        struct execution_wrapper
+        {
+            static int call_int(void* data, int arg0)
+            {
+                return type_erasure_table_detail::object_access<Impl>::get(data).operator()(std::move(arg0));
+            }
+        };
+    }
+
+    class Callback
+    {
+    public:
+        Callback() noexcept = default;
+
+        template <class T,
+                  std::enable_if_t<!std::is_same<std::decay_t<T>, Callback>::value>* = nullptr>
+        Callback(T&& value)
+            : function_({&CallbackDetail::execution_wrapper<Callback, std::decay_t<T>>::call_int}),
+              impl_(std::forward<T>(value))
+        {}
+
+        int operator()(int arg0)
+        {
+            return function_.call_int(impl_.object(), arg0);
+        }
+
+    private:
+        CallbackDetail::Table<Callback> function_;
+        clang::type_erasure::NonCopyableSBOStorage<32, false, Callback> impl_;
+    };
+
+    // three pointers, too large for the small buffer of std::function in libstdc++
+    template <class Function>
+    Function makeCallable(int& a, int& b, int& c)
+    {
+        return [&a, &b, &c](int x) { return a + b + c + x; };
+    }
+}
+
+static void callable_construction_std_function(benchmark::State& state)
+{
+    int a = 1, b = 2, c = 3;
+    for(auto _ : state)
+    {
+        auto function = makeCallable<std::function<int(int)>>(a, b, c);
+        benchmark::DoNotOptimize(function);
+    }
+}
+BENCHMARK(callable_construction_std_function);
+
+static void callable_construction_generated(benchmark::State& state)
+{
+    int a = 1, b = 2, c = 3;
+    for(auto _ : state)
+    {
+        auto function = makeCallable<Callback>(a, b, c);
+        benchmark::DoNotOptimize(function);
+    }
+}
+BENCHMARK(callable_construction_generated);
+
+static void callable_invocation_std_function(benchmark::State& state)
+{
+    int a = 1, b = 2, c = 3;
+    auto function = makeCallable<std::function<int(int)>>(a, b, c);
+    benchmark::DoNotOptimize(function);
+    for(auto _ : state)
+        benchmark::DoNotOptimize(function(state.iterations()));
+}
+BENCHMARK(callable_invocation_std_function);
+
+static void callable_invocation_generated(benchmark::State& state)
+{
+    int a = 1, b = 2, c = 3;
+    auto function = makeCallable<Callback>(a, b, c);
+    benchmark::DoNotOptimize(function);
+    for(auto _ : state)
+        benchmark::DoNotOptimize(function(state.iterations()));
+}
+BENCHMARK(callable_invocation_generated);
@@ -0,0 +1,179 @@
+// The interfaces as generated with 'clang-type-erase -custom -sbo -cpp-standard=17', with and
+// without '-no-exceptions'. The specifications expand to what the tool writes in both modes, such
+// that building this file with and without '-fno-exceptions' compares the code size of the
+// generated code.
+#include <Storage.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    struct Square
+    {
+        double area() const
+        {
+            return side * side;
+        }
+
+        void scale(double factor)
+        {
+            side *= factor;
+        }
+
+        std::string name() const
+        {
+            return "square";
+        }
+
+        double side = 2;
+    };
+
+    struct Circle
+    {
+        double area() const
+        {
+            return 3.14159 * radius * radius;
+        }
+
+        void scale(double factor)
+        {
+            radius *= factor;
+        }
+
+        std::string name() const
+        {
+            return "circle";
+        }
+
+        double radius = 1;
+    };
+
+    // does not fit into the buffer
+    struct Polygon
+    {
+        double area() const
+        {
+            auto area = 0.0;
+            for(std::size_t i = 0; i + 1 < points.size(); ++i)
+                area += points[i].first * points[i + 1].second - points[i + 1].first * points[i].second;
+            return area / 2;
+        }
+
+        void scale(double factor)
+        {
+            for(auto& point : points)
+                point = { point.first * factor, point.second * factor };
+        }
+
+        std::string name() const
+        {
+            return "polygon";
+        }
+
+        std::vector<std::pair<double, double>> points = { {0, 0}, {1, 0}, {1, 1}, {0, 0} };
+        char label[64] = {};
+    };
+
+    struct ShapeTable
+    {
+        using area_function = double (*)(const void*) CLANG_TYPE_ERASE_NOTHROW_FUNCTION;
+        area_function area;
+        using scale_function = void (*)(void*, double) CLANG_TYPE_ERASE_NOTHROW_FUNCTION;
+        scale_function scale;
+        using name_function = std::string (*)(const void*) CLANG_TYPE_ERASE_NOTHROW_FUNCTION;
+        name_function name;
+    };
+
+    template <class Impl>
+    struct execution_wrapper
+    {
+        static double area(const void* data) CLANG_TYPE_ERASE_NOTHROW
+        {
+            return static_cast<const Impl*>(data)->area();
+        }
+
+        static void scale(void* data, double factor) CLANG_TYPE_ERASE_NOTHROW
+        {
+            static_cast<Impl*>(data)->scale(factor);
+        }
+
+        static std::string name(const void* data) CLANG_TYPE_ERASE_NOTHROW
+        {
+            return static_cast<const Impl*>(data)->name();
+        }
+    };
+
+    class Shape
+    {
+    public:
+        Shape() noexcept = default;
+
+        template <class T>
+        Shape(T&& value) CLANG_TYPE_ERASE_NOTHROW
+            : function_({ &execution_wrapper<std::decay_t<T>>::area,
+                          &execution_wrapper<std::decay_t<T>>::scale,
+                          &execution_wrapper<std::decay_t<T>>::name }),
+              impl_(std::forward<T>(value))
+        {}
+
+        double area() const CLANG_TYPE_ERASE_NOTHROW
+        {
+            return function_.area(impl_.object());
+        }
+
+        void scale(double factor) CLANG_TYPE_ERASE_NOTHROW
+        {
+            function_.scale(impl_.object(), factor);
+        }
+
+        std::string name() const CLANG_TYPE_ERASE_NOTHROW
+        {
+            return function_.name(impl_.object());
+        }
+
+    private:
+        ShapeTable function_;
+        clang::type_erasure::SBOStorage<16, false> impl_;
+    };
+
+    std::vector<Shape> makeShapes(std::size_t count)
+    {
+        std::vector<Shape> shapes;
+        shapes.reserve(count);
+        for(std::size_t i = 0; i < count; ++i)
+            if(i % 3 == 0)
+                shapes.emplace_back(Circle());
+            else if(i % 3 == 1)
+                shapes.emplace_back(Square());
+            else
+                shapes.emplace_back(Polygon());
+        return shapes;
+    }
+
+    std::vector<Shape> scaled(std::vector<Shape> shapes, double factor)
+    {
+        for(auto& shape : shapes)
+            shape.scale(factor);
+        return shapes;
+    }
+}
+
+double totalArea(std::size_t count)
+{
+    auto area = 0.0;
+    for(const auto& shape : scaled(makeShapes(count), 2))
+        area += shape.area();
+    return area;
+}
+
+std::size_t nameLength(std::size_t count)
+{
+    const auto shapes = makeShapes(count);
+    auto copies = shapes;
+    std::size_t length = 0;
+    for(const auto& shape : copies)
+        length += shape.name().size();
+    return length;
+}
@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+
+#include <Storage.h>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+    struct Payload
+    {
+        Payload()
+            : values(256, 1)
+        {}
+
+        int sum() const
+        {
+            return std::accumulate(begin(values), end(values), 0);
+        }
+
+        void set_value(int value)
+        {
+            values.front() = value;
+        }
+
+        std::vector<int> values;
+    };
+
+    template <class Storage>
+    const Storage& shared()
+    {
+        static const Storage storage = Storage(Payload());
+        return storage;
+    }
+
+    // Each thread reads through its own copy, all copies share the same payload.
+    template <class Storage>
+    void BM_COW_Read(benchmark::State& state)
+    {
+        const Storage copy = shared<Storage>();
+        for(auto _ : state)
+            benchmark::DoNotOptimize(copy.template get<Payload>().sum());
+    }
+
+    // Copies and destroys a shared object, i.e. contended reference counting.
+    template <class Storage>
+    void BM_COW_Copy(benchmark::State& state)
+    {
+        for(auto _ : state)
+        {
+            Storage copy = shared<Storage>();
+            benchmark::DoNotOptimize(copy);
+        }
+    }
+
+    // Copies a shared object and modifies the copy, which unshares the payload.
+    template <class Storage>
+    void BM_COW_CopyAndWrite(benchmark::State& state)
+    {
+        for(auto _ : state)
+        {
+            Storage copy = shared<Storage>();
+            copy.template get<Payload>().set_value(2);
+            benchmark::DoNotOptimize(copy);
+        }
+    }
+
+    // Modifies an object whose payload is not shared, i.e. the cost of the uniqueness check.
+    template <class Storage>
+    void BM_COW_UniqueWrite(benchmark::State& state)
+    {
+        Storage copy = Storage(Payload());
+        for(auto _ : state)
+        {
+            copy.template get<Payload>().set_value(2);
+            benchmark::ClobberMemory();
+        }
+    }
+
+    using COW = clang::type_erasure::COWStorage<false>;
+    using SBOCOW = clang::type_erasure::SBOCOWStorage<16, false>;
+}
+
+BENCHMARK_TEMPLATE(BM_COW_Read, COW)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_COW_Read, SBOCOW)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_COW_Copy, COW)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_COW_Copy, SBOCOW)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_COW_CopyAndWrite, COW)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_COW_CopyAndWrite, SBOCOW)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_COW_UniqueWrite, COW)->ThreadRange(1, 64)->UseRealTime();
@@ -0,0 +1,76 @@
+#include <benchmark/benchmark.h>
+
+#include <DeferredDestruction.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <vector>
+
+namespace
+{
+    // an object with an expensive destructor, which frees one node per element
+    struct Tree
+    {
+        explicit Tree(std::size_t size)
+            : nodes(size, 1)
+        {}
+
+        std::size_t size() const
+        {
+            return nodes.size();
+        }
+
+        std::list<int> nodes;
+    };
+
+    struct Tag;
+
+    using Immediate = clang::type_erasure::Storage<false, Tag>;
+    using Deferred = clang::type_erasure::Storage<false, clang::type_erasure::DeferredDestruction<Tag>>;
+
+    double percentile(std::vector<double>& latencies, double fraction)
+    {
+        const auto position = begin(latencies) + static_cast<std::ptrdiff_t>(fraction * (latencies.size() - 1));
+        std::nth_element(begin(latencies), position, end(latencies));
+        return *position;
+    }
+
+    // Latency of releasing the last reference to an object, e.g. at the end of a request. The
+    // number of iterations is fixed, as the deferred releases are too fast for the measured time
+    // to determine it.
+    template <class Storage>
+    void release(benchmark::State& state)
+    {
+        std::vector<double> latencies;
+        for(auto _ : state)
+        {
+            Storage storage(clang::type_erasure::in_place_type<Tree>, state.range(0));
+            benchmark::DoNotOptimize(storage.object());
+
+            const auto start = std::chrono::steady_clock::now();
+            storage = Storage();
+            const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+            state.SetIterationTime(elapsed.count());
+            latencies.push_back(elapsed.count() * 1e9);
+        }
+        clang::type_erasure::drainDeferredDestruction();
+
+        state.counters["p50_ns"] = percentile(latencies, 0.5);
+        state.counters["p99_ns"] = percentile(latencies, 0.99);
+        state.counters["max_ns"] = *std::max_element(begin(latencies), end(latencies));
+    }
+}
+
+static void deferred_destruction_immediate(benchmark::State& state)
+{
+    release<Immediate>(state);
+}
+BENCHMARK(deferred_destruction_immediate)->Range(1 << 4, 1 << 14)->Iterations(2000)->UseManualTime();
+
+static void deferred_destruction_deferred(benchmark::State& state)
+{
+    release<Deferred>(state);
+}
+BENCHMARK(deferred_destruction_deferred)->Range(1 << 4, 1 << 14)->Iterations(2000)->UseManualTime();
@@ -0,0 +1,38 @@
+#include <benchmark/benchmark.h>
+
+#include "shapes.h"
+
+// The interfaces are only implemented in shapes.cpp. Without link-time optimization, all calls
+// are virtual. In devirtualization_lto, Shape::area() has a single implementation and is called
+// directly (Clang: -fwhole-program-vtables, GCC: speculative devirtualization), while
+// Solid::volume() remains virtual.
+
+static void devirtualization_single_implementation(benchmark::State& state)
+{
+    const auto shapes = makeShapes(1024);
+    for(auto _ : state)
+    {
+        std::size_t large = 0;
+        for(const auto& shape : shapes)
+            large += shape.area() > 3;
+        benchmark::DoNotOptimize(large);
+    }
+    state.SetItemsProcessed(state.iterations() * shapes.size());
+}
+BENCHMARK(devirtualization_single_implementation);
+
+static void devirtualization_two_implementations(benchmark::State& state)
+{
+    const auto solids = makeSolids(1024);
+    for(auto _ : state)
+    {
+        std::size_t large = 0;
+        for(const auto& solid : solids)
+            large += solid.volume() > 3;
+        benchmark::DoNotOptimize(large);
+    }
+    state.SetItemsProcessed(state.iterations() * solids.size());
+}
+BENCHMARK(devirtualization_two_implementations);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,53 @@
+#include "shapes.h"
+
+namespace
+{
+    struct Square
+    {
+        double area() const
+        {
+            return side * side;
+        }
+
+        double side = 2;
+    };
+
+    struct Cube
+    {
+        double volume() const
+        {
+            return side * side * side;
+        }
+
+        double side = 2;
+    };
+
+    struct Ball
+    {
+        double volume() const
+        {
+            return 4.18879 * radius * radius * radius;
+        }
+
+        double radius = 1;
+    };
+}
+
+std::vector<Shape> makeShapes(std::size_t count)
+{
+    std::vector<Shape> shapes;
+    for(std::size_t i = 0; i < count; ++i)
+        shapes.emplace_back(Square());
+    return shapes;
+}
+
+std::vector<Solid> makeSolids(std::size_t count)
+{
+    std::vector<Solid> solids;
+    for(std::size_t i = 0; i < count; ++i)
+        if(i % 2)
+            solids.emplace_back(Ball());
+        else
+            solids.emplace_back(Cube());
+    return solids;
+}
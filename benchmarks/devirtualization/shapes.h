@@ -0,0 +1,140 @@
+#pragma once
+
+#include <SmartPointerStorage.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// as generated with 'clang-type-erase' for
+// struct Shape { double area() const; };
+// struct Solid { double volume() const; };
+class Shape
+{
+    struct CLANG_TYPE_ERASE_HIDDEN Interface
+    {
+        virtual ~Interface() = default;
+        virtual clang::type_erasure::polymorphic::TypeTag type_tag() const noexcept = 0;
+        virtual std::unique_ptr<Interface> clone() const = 0;
+        virtual double area() const = 0;
+    };
+
+    template <class Impl>
+    struct WrapperBase : Interface
+    {
+        template <class T>
+        WrapperBase(T&& t)
+            : impl(std::forward<T>(t))
+        {}
+
+        double area() const override
+        {
+            return impl.area();
+        }
+
+        Impl impl;
+    };
+
+    template <class Impl>
+    struct Wrapper final : WrapperBase<Impl>
+    {
+        template <class T>
+        Wrapper(T&& t)
+            : WrapperBase<Impl>(std::forward<T>(t))
+        {}
+
+        clang::type_erasure::polymorphic::TypeTag type_tag() const noexcept override
+        {
+            return clang::type_erasure::polymorphic::typeTag<Impl>();
+        }
+
+        std::unique_ptr<Interface> clone() const override
+        {
+            return std::make_unique<Wrapper>(this->impl);
+        }
+    };
+
+public:
+    template <class T,
+              std::enable_if_t<!std::is_same<std::decay_t<T>, Shape>::value>* = nullptr>
+    Shape(T&& value)
+        : impl_(std::forward<T>(value))
+    {}
+
+    double area() const
+    {
+        return impl_->area();
+    }
+
+private:
+    clang::type_erasure::polymorphic::Storage<Interface, Wrapper> impl_;
+};
+
+class Solid
+{
+    struct CLANG_TYPE_ERASE_HIDDEN Interface
+    {
+        virtual ~Interface() = default;
+        virtual clang::type_erasure::polymorphic::TypeTag type_tag() const noexcept = 0;
+        virtual std::unique_ptr<Interface> clone() const = 0;
+        virtual double volume() const = 0;
+    };
+
+    template <class Impl>
+    struct WrapperBase : Interface
+    {
+        template <class T>
+        WrapperBase(T&& t)
+            : impl(std::forward<T>(t))
+        {}
+
+        double volume() const override
+        {
+            return impl.volume();
+        }
+
+        Impl impl;
+    };
+
+    template <class Impl>
+    struct Wrapper final : WrapperBase<Impl>
+    {
+        template <class T>
+        Wrapper(T&& t)
+            : WrapperBase<Impl>(std::forward<T>(t))
+        {}
+
+        clang::type_erasure::polymorphic::TypeTag type_tag() const noexcept override
+        {
+            return clang::type_erasure::polymorphic::typeTag<Impl>();
+        }
+
+        std::unique_ptr<Interface> clone() const override
+        {
+            return std::make_unique<Wrapper>(this->impl);
+        }
+    };
+
+public:
+    template <class T,
+              std::enable_if_t<!std::is_same<std::decay_t<T>, Solid>::value>* = nullptr>
+    Solid(T&& value)
+        : impl_(std::forward<T>(value))
+    {}
+
+    double volume() const
+    {
+        return impl_->volume();
+    }
+
+private:
+    clang::type_erasure::polymorphic::Storage<Interface, Wrapper> impl_;
+};
+
+/// Squares only, defined in another translation unit than the calls.
+std::vector<Shape> makeShapes(std::size_t count);
+
+/// Cubes and balls, defined in another translation unit than the calls.
+std::vector<Solid> makeSolids(std::size_t count);
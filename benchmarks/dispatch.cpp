@@ -0,0 +1,136 @@
+#include <benchmark/benchmark.h>
+
+#include <Storage.h>
+#include <TypeErasureUtil.h>
+
+#include <functional>
+#include <memory>
+
+namespace
+{
+    struct Counter
+    {
+        int foo() const
+        {
+            return value;
+        }
+
+        void set_value(int new_value)
+        {
+            value = new_value;
+        }
+
+        int value = 1;
+    };
+
+    // hand-written virtual call
+    struct Base
+    {
+        virtual ~Base() = default;
+        virtual int foo() const = 0;
+        virtual void set_value(int) = 0;
+    };
+
+    struct VirtualCounter : Base
+    {
+        int foo() const override
+        {
+            return impl.foo();
+        }
+
+        void set_value(int value) override
+        {
+            impl.set_value(value);
+        }
+
+        Counter impl;
+    };
+
+    // call sequence of an interface generated with '-custom'
+    using Storage = clang::type_erasure::Storage<true>;
+
+    template <class Interface>
+    struct Table
+    {
+        using foo_function = int (*)(const void*);
+        foo_function foo;
+        using set_value_int_function = void (*)(void*, int);
+        set_value_int_function set_value_int;
+    };
+
+    template <class Interface, class Impl>
+    struct execution_wrapper
+    {
+        static int foo(const void* data)
+        {
+            return type_erasure_table_detail::object_access<Impl>::get(data).foo();
+        }
+
+        static void set_value_int(void* data, int value)
+        {
+            type_erasure_table_detail::object_access<Impl>::get(data).set_value(std::move(value));
+        }
+    };
+
+    class Fooable
+    {
+    public:
+        template <class T>
+        Fooable(T&& value)
+            : function_({&execution_wrapper<Fooable, std::decay_t<T>>::foo,
+                         &execution_wrapper<Fooable, std::decay_t<T>>::set_value_int}),
+              impl_(std::forward<T>(value))
+        {}
+
+        int foo() const
+        {
+            return function_.foo(impl_.object());
+        }
+
+        void set_value(int value)
+        {
+            function_.set_value_int(impl_.object(), value);
+        }
+
+    private:
+        Table<Fooable> function_;
+        Storage impl_;
+    };
+}
+
+static void virtual_call(benchmark::State& state)
+{
+    std::unique_ptr<Base> fooable = std::make_unique<VirtualCounter>();
+    benchmark::DoNotOptimize(fooable);
+    for(auto _ : state)
+    {
+        fooable->set_value(state.iterations());
+        benchmark::DoNotOptimize(fooable->foo());
+    }
+}
+BENCHMARK(virtual_call);
+
+static void table_call(benchmark::State& state)
+{
+    Fooable fooable = Counter();
+    benchmark::DoNotOptimize(fooable);
+    for(auto _ : state)
+    {
+        fooable.set_value(state.iterations());
+        benchmark::DoNotOptimize(fooable.foo());
+    }
+}
+BENCHMARK(table_call);
+
+static void table_call_reference_wrapper(benchmark::State& state)
+{
+    Counter counter;
+    Fooable fooable = std::ref(counter);
+    benchmark::DoNotOptimize(fooable);
+    for(auto _ : state)
+    {
+        fooable.set_value(state.iterations());
+        benchmark::DoNotOptimize(fooable.foo());
+    }
+}
+BENCHMARK(table_call_reference_wrapper);
@@ -0,0 +1,49 @@
+#include <benchmark/benchmark.h>
+
+#include <Storage.h>
+
+#include <array>
+#include <utility>
+
+namespace
+{
+    struct Tag;
+
+    using SBOStorage = clang::type_erasure::SBOStorage<32, false, Tag>;
+    using COWStorage = clang::type_erasure::COWStorage<false, Tag>;
+
+    struct Large
+    {
+        std::array<int, 32> data{};
+    };
+
+    // what a conversion without converting move does: the source is stored as implementation
+    struct Wrapped
+    {
+        SBOStorage storage;
+    };
+}
+
+// hands over the heap allocated object
+static void flavour_conversion_move(benchmark::State& state)
+{
+    for(auto _ : state)
+    {
+        SBOStorage storage(Large{});
+        COWStorage cow(std::move(storage));
+        benchmark::DoNotOptimize(cow);
+    }
+}
+BENCHMARK(flavour_conversion_move);
+
+// stores the source storage as object, i.e. allocates again and adds an indirection
+static void flavour_conversion_wrap(benchmark::State& state)
+{
+    for(auto _ : state)
+    {
+        SBOStorage storage(Large{});
+        COWStorage cow(Wrapped{std::move(storage)});
+        benchmark::DoNotOptimize(cow);
+    }
+}
+BENCHMARK(flavour_conversion_wrap);
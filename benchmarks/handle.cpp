@@ -0,0 +1,156 @@
+#include <benchmark/benchmark.h>
+
+#include <HandleStorage.h>
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+    struct Square
+    {
+        double area() const
+        {
+            return side * side;
+        }
+
+        double side = 2;
+    };
+
+    struct Circle
+    {
+        double area() const
+        {
+            return 3.14159 * radius * radius;
+        }
+
+        double radius = 1;
+    };
+
+    struct ShapeTable
+    {
+        double (*area)(const void*);
+    };
+
+    template <class Impl>
+    double callArea(const void* data)
+    {
+        return static_cast<const Impl*>(data)->area();
+    }
+
+    // as generated with 'clang-type-erase -custom -sbo -buffer-size=16' for
+    // struct Shape { double area() const; };
+    class Shape
+    {
+    public:
+        template <class T>
+        Shape(T value)
+            : function_{ &callArea<T> },
+              impl_(std::move(value))
+        {}
+
+        double area() const
+        {
+            return function_.area(impl_.object());
+        }
+
+    private:
+        ShapeTable function_;
+        clang::type_erasure::SBOStorage<16, false> impl_;
+    };
+
+    // as generated with 'clang-type-erase -custom -handle', the slabs are shared by all
+    // interfaces with the same tag
+    template <class Tag>
+    class BasicHandleShape
+    {
+    public:
+        template <class T>
+        BasicHandleShape(T value)
+            : impl_(clang::type_erasure::in_place_type<T>, ShapeTable{ &callArea<T> }, std::move(value))
+        {}
+
+        double area() const
+        {
+            return impl_.template functions<ShapeTable>().area(impl_.object());
+        }
+
+    private:
+        clang::type_erasure::HandleStorage<false, Tag> impl_;
+    };
+
+    struct IterateHandles;
+    struct IterateSlabs;
+    using HandleShape = BasicHandleShape<IterateHandles>;
+    using SlabShape = BasicHandleShape<IterateSlabs>;
+
+    template <class Erased>
+    std::vector<Erased> makeShapes(std::size_t count)
+    {
+        std::vector<Erased> shapes;
+        shapes.reserve(count);
+        for(std::size_t i = 0; i < count; ++i)
+            if(i % 2 == 0)
+                shapes.emplace_back(Circle());
+            else
+                shapes.emplace_back(Square());
+        return shapes;
+    }
+
+    // memory per object, the slots of the handle storages hold the objects without padding
+    template <class Erased>
+    std::size_t bytesPerObject()
+    {
+        return sizeof(Erased) + (std::is_same<Erased, Shape>::value ? 0 : sizeof(Square));
+    }
+
+    template <class Erased>
+    void iterate(benchmark::State& state)
+    {
+        const auto shapes = makeShapes<Erased>(state.range(0));
+        for(auto _ : state)
+        {
+            std::size_t large = 0;
+            for(const auto& shape : shapes)
+                large += shape.area() > 3;
+            benchmark::DoNotOptimize(large);
+        }
+        state.SetItemsProcessed(state.iterations() * shapes.size());
+        state.counters["bytes_per_object"] = bytesPerObject<Erased>();
+    }
+}
+
+static void handle_iterate_sbo(benchmark::State& state)
+{
+    iterate<Shape>(state);
+}
+BENCHMARK(handle_iterate_sbo)->Range(1 << 10, 1 << 20);
+
+static void handle_iterate_handles(benchmark::State& state)
+{
+    iterate<HandleShape>(state);
+}
+BENCHMARK(handle_iterate_handles)->Range(1 << 10, 1 << 20);
+
+// visits the slabs of the implementations instead of the interfaces
+static void handle_iterate_slabs(benchmark::State& state)
+{
+    const auto shapes = makeShapes<SlabShape>(state.range(0));
+    for(auto _ : state)
+    {
+        std::size_t large = 0;
+        clang::type_erasure::forEachInSlab<IterateSlabs, Circle>([&large](const Circle& circle)
+        {
+            large += circle.area() > 3;
+        });
+        clang::type_erasure::forEachInSlab<IterateSlabs, Square>([&large](const Square& square)
+        {
+            large += square.area() > 3;
+        });
+        benchmark::DoNotOptimize(large);
+    }
+    state.SetItemsProcessed(state.iterations() * shapes.size());
+    state.counters["bytes_per_object"] = bytesPerObject<SlabShape>();
+}
+BENCHMARK(handle_iterate_slabs)->Range(1 << 10, 1 << 20);
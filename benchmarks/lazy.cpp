@@ -0,0 +1,135 @@
+#include <benchmark/benchmark.h>
+
+#include <Storage.h>
+#include <Lazy.h>
+
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+    // strategy that precomputes a table in its constructor
+    struct Strategy
+    {
+        explicit Strategy(int seed)
+            : weights(256)
+        {
+            std::iota(begin(weights), end(weights), seed);
+        }
+
+        int score(int x) const
+        {
+            return weights[static_cast<std::size_t>(x) % weights.size()];
+        }
+
+        std::vector<int> weights;
+    };
+
+    struct StrategyFactory
+    {
+        Strategy operator()() const
+        {
+            return Strategy(seed);
+        }
+
+        int seed;
+    };
+
+    struct ScorerTable
+    {
+        int (*score)(const void*, int);
+    };
+
+    template <class Impl>
+    int callScore(const void* data, int x)
+    {
+        return type_erasure_table_detail::object_access<Impl>::get(data).score(x);
+    }
+
+    // as generated with 'clang-type-erase -custom -sbo -lazy' for struct Scorer { int score(int) const; };
+    class Scorer
+    {
+    public:
+        template <class T>
+        Scorer(T value)
+            : function_{ &callScore<T> },
+              impl_(std::move(value))
+        {}
+
+        int score(int x) const
+        {
+            return function_.score(impl_.object(), x);
+        }
+
+    private:
+        ScorerTable function_;
+        clang::type_erasure::SBOStorage<64, false> impl_;
+    };
+
+    std::vector<Scorer> makeEager(std::size_t count)
+    {
+        std::vector<Scorer> scorers;
+        scorers.reserve(count);
+        for(std::size_t i = 0; i < count; ++i)
+            scorers.emplace_back(Strategy(static_cast<int>(i)));
+        return scorers;
+    }
+
+    std::vector<Scorer> makeLazy(std::size_t count)
+    {
+        std::vector<Scorer> scorers;
+        scorers.reserve(count);
+        for(std::size_t i = 0; i < count; ++i)
+            scorers.emplace_back(clang::type_erasure::lazy<Strategy>(StrategyFactory{static_cast<int>(i)}));
+        return scorers;
+    }
+
+    template <class Make>
+    void construct(benchmark::State& state, Make make)
+    {
+        for(auto _ : state)
+            benchmark::DoNotOptimize(make(static_cast<std::size_t>(state.range(0))));
+    }
+
+    // calls after the first call, which has built the lazy strategies
+    template <class Make>
+    void call(benchmark::State& state, Make make)
+    {
+        const auto scorers = make(static_cast<std::size_t>(state.range(0)));
+        for(const auto& scorer : scorers)
+            benchmark::DoNotOptimize(scorer.score(0));
+
+        for(auto _ : state)
+        {
+            int sum = 0;
+            for(const auto& scorer : scorers)
+                sum += scorer.score(7);
+            benchmark::DoNotOptimize(sum);
+        }
+    }
+}
+
+static void lazy_construct_eager(benchmark::State& state)
+{
+    construct(state, makeEager);
+}
+BENCHMARK(lazy_construct_eager)->Range(1 << 6, 1 << 12);
+
+static void lazy_construct_lazy(benchmark::State& state)
+{
+    construct(state, makeLazy);
+}
+BENCHMARK(lazy_construct_lazy)->Range(1 << 6, 1 << 12);
+
+static void lazy_call_eager(benchmark::State& state)
+{
+    call(state, makeEager);
+}
+BENCHMARK(lazy_call_eager)->Range(1 << 6, 1 << 12);
+
+static void lazy_call_lazy(benchmark::State& state)
+{
+    call(state, makeLazy);
+}
+BENCHMARK(lazy_call_lazy)->Range(1 << 6, 1 << 12);
@@ -0,0 +1,118 @@
+#include <benchmark/benchmark.h>
+
+#include <Queue.h>
+#include <Storage.h>
+
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace
+{
+    constexpr int n_tasks = 100000;
+
+    // a small task, e.g. a lambda that captures three pointers
+    struct Task
+    {
+        explicit Task(int value)
+            : value(value)
+        {}
+
+        int run() const
+        {
+            return value;
+        }
+
+        int value;
+        void* captures[2] = {nullptr, nullptr};
+    };
+
+    using Storage = clang::type_erasure::NonCopyableSBOStorage<32, false>;
+
+    class MutexQueue
+    {
+    public:
+        bool try_push(Storage&& storage)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push(std::move(storage));
+            return true;
+        }
+
+        template <class F>
+        bool try_consume(F&& f)
+        {
+            Storage storage;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(queue.empty())
+                    return false;
+                storage = std::move(queue.front());
+                queue.pop();
+            }
+            f(storage);
+            return true;
+        }
+
+    private:
+        std::mutex mutex;
+        std::queue<Storage> queue;
+    };
+
+    // one producer and one consumer, the consumer runs on the benchmark thread
+    template <class Queue, class Push>
+    void transfer(benchmark::State& state, Queue& queue, Push push)
+    {
+        for(auto _ : state)
+        {
+            std::thread producer([&queue, &push]
+            {
+                for(int i = 0; i < n_tasks; ++i)
+                    while(!push(queue, i))
+                        std::this_thread::yield();
+            });
+
+            int sum = 0;
+            for(int consumed = 0; consumed < n_tasks; )
+            {
+                if(queue.try_consume([&sum](Storage& storage) { sum += storage.get<Task>().run(); }))
+                    ++consumed;
+                else
+                    std::this_thread::yield();
+            }
+            benchmark::DoNotOptimize(sum);
+            producer.join();
+        }
+        state.SetItemsProcessed(state.iterations() * n_tasks);
+    }
+}
+
+static void queue_mutex(benchmark::State& state)
+{
+    MutexQueue queue;
+    transfer(state, queue, [](MutexQueue& queue, int i) { return queue.try_push(Storage(Task(i))); });
+}
+BENCHMARK(queue_mutex)->UseRealTime();
+
+static void queue_lock_free_spsc(benchmark::State& state)
+{
+    using Queue = clang::type_erasure::Queue<Storage, 1024, false, false>;
+    auto queue = std::make_unique<Queue>();
+    transfer(state, *queue, [](Queue& queue, int i)
+    {
+        return queue.try_emplace(clang::type_erasure::in_place_type<Task>, i);
+    });
+}
+BENCHMARK(queue_lock_free_spsc)->UseRealTime();
+
+static void queue_lock_free_mpmc(benchmark::State& state)
+{
+    using Queue = clang::type_erasure::Queue<Storage, 1024>;
+    auto queue = std::make_unique<Queue>();
+    transfer(state, *queue, [](Queue& queue, int i)
+    {
+        return queue.try_emplace(clang::type_erasure::in_place_type<Task>, i);
+    });
+}
+BENCHMARK(queue_lock_free_mpmc)->UseRealTime();
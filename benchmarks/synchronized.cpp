@@ -0,0 +1,93 @@
+#include <benchmark/benchmark.h>
+
+#include <Storage.h>
+#include <Synchronized.h>
+
+#include <mutex>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+    struct Payload
+    {
+        int sum() const
+        {
+            return std::accumulate(begin(values), end(values), 0);
+        }
+
+        std::vector<int> values = std::vector<int>(16, 1);
+    };
+
+    // stands in for an interface with 'int sum() const;'
+    template <class Storage>
+    class Summable
+    {
+    public:
+        Summable()
+            : impl_(Payload())
+        {}
+
+        int sum() const
+        {
+            return impl_.template get<Payload>().sum();
+        }
+
+    private:
+        Storage impl_;
+    };
+
+    using Plain = Summable<clang::type_erasure::Storage<false>>;
+    using Shared = Summable<clang::type_erasure::COWStorage<false>>;
+
+    // what '-synchronized' replaces: an interface behind an external mutex
+    struct Locked
+    {
+        int sum() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return value.sum();
+        }
+
+        mutable std::mutex mutex;
+        Plain value;
+    };
+
+    template <class Erased, template <class> class Holder>
+    struct Synchronized
+    {
+        int sum() const
+        {
+            return value.read([](const Erased& object) { return object.sum(); });
+        }
+
+        Holder<Erased> value;
+    };
+
+    template <class Object>
+    void read(benchmark::State& state)
+    {
+        static Object object;
+        for(auto _ : state)
+            benchmark::DoNotOptimize(object.sum());
+        state.SetItemsProcessed(state.iterations());
+    }
+}
+
+static void synchronized_read_mutex(benchmark::State& state)
+{
+    read<Locked>(state);
+}
+BENCHMARK(synchronized_read_mutex)->ThreadRange(1, 32)->UseRealTime();
+
+static void synchronized_read_shared_lock(benchmark::State& state)
+{
+    read<Synchronized<Plain, clang::type_erasure::Synchronized>>(state);
+}
+BENCHMARK(synchronized_read_shared_lock)->ThreadRange(1, 32)->UseRealTime();
+
+static void synchronized_read_snapshot(benchmark::State& state)
+{
+    read<Synchronized<Shared, clang::type_erasure::SnapshotSynchronized>>(state);
+}
+BENCHMARK(synchronized_read_snapshot)->ThreadRange(1, 32)->UseRealTime();
@@ -0,0 +1,87 @@
+#include <benchmark/benchmark.h>
+
+#include <SmartPointerStorage.h>
+
+#include <functional>
+#include <memory>
+
+namespace
+{
+    struct Counter
+    {
+        int foo() const
+        {
+            return value;
+        }
+
+        int value = 1;
+    };
+
+    struct Other
+    {
+        int foo() const
+        {
+            return 2;
+        }
+    };
+
+    // as generated in the polymorphic mode
+    struct Interface
+    {
+        virtual ~Interface() = default;
+        virtual clang::type_erasure::polymorphic::TypeTag type_tag() const noexcept = 0;
+        virtual int foo() const = 0;
+    };
+
+    template <class Impl>
+    struct Wrapper : Interface
+    {
+        template <class T>
+        Wrapper(T&& t)
+            : impl(std::forward<T>(t))
+        {}
+
+        clang::type_erasure::polymorphic::TypeTag type_tag() const noexcept override
+        {
+            return clang::type_erasure::polymorphic::typeTag<Impl>();
+        }
+
+        int foo() const override
+        {
+            return impl.foo();
+        }
+
+        Impl impl;
+    };
+
+    using Storage = clang::type_erasure::polymorphic::Storage<Interface, Wrapper>;
+
+    template <class T>
+    const T* dynamicTarget(const Interface* interface)
+    {
+        auto wrapped = dynamic_cast<const Wrapper<T>*>(interface);
+        return wrapped ? &wrapped->impl : nullptr;
+    }
+}
+
+static void target_dynamic_cast(benchmark::State& state)
+{
+    const std::unique_ptr<Interface> interface = std::make_unique<Wrapper<Counter>>(Counter());
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(dynamicTarget<Counter>(interface.get()));
+        benchmark::DoNotOptimize(dynamicTarget<Other>(interface.get()));
+    }
+}
+BENCHMARK(target_dynamic_cast);
+
+static void target_type_tag(benchmark::State& state)
+{
+    const Storage storage(Counter{});
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(storage.target<Counter>());
+        benchmark::DoNotOptimize(storage.target<Other>());
+    }
+}
+BENCHMARK(target_type_tag);
@@ -0,0 +1,119 @@
+#include <benchmark/benchmark.h>
+
+#include <ThinStorage.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace
+{
+    struct Square
+    {
+        double area() const
+        {
+            return side * side;
+        }
+
+        double side = 2;
+    };
+
+    struct Circle
+    {
+        double area() const
+        {
+            return 3.14159 * radius * radius;
+        }
+
+        double radius = 1;
+    };
+
+    struct ShapeTable
+    {
+        double (*area)(const void*);
+    };
+
+    template <class Impl>
+    double callArea(const void* data)
+    {
+        return static_cast<const Impl*>(data)->area();
+    }
+
+    // as generated with 'clang-type-erase -custom' for struct Shape { double area() const; };
+    class Shape
+    {
+    public:
+        template <class T>
+        Shape(T value)
+            : function_{ &callArea<T> },
+              impl_(std::move(value))
+        {}
+
+        double area() const
+        {
+            return function_.area(impl_.object());
+        }
+
+    private:
+        ShapeTable function_;
+        clang::type_erasure::Storage<false> impl_;
+    };
+
+    // as generated with 'clang-type-erase -custom -thin'
+    class ThinShape
+    {
+    public:
+        template <class T>
+        ThinShape(T value)
+            : impl_(clang::type_erasure::in_place_type<T>, ShapeTable{ &callArea<T> }, std::move(value))
+        {}
+
+        double area() const
+        {
+            return impl_.functions<ShapeTable>().area(impl_.object());
+        }
+
+    private:
+        clang::type_erasure::ThinStorage<false> impl_;
+    };
+
+    template <class Erased>
+    std::vector<Erased> makeShapes(std::size_t count)
+    {
+        std::vector<Erased> shapes;
+        shapes.reserve(count);
+        for(std::size_t i = 0; i < count; ++i)
+            if(i % 2 == 0)
+                shapes.emplace_back(Circle());
+            else
+                shapes.emplace_back(Square());
+        return shapes;
+    }
+
+    // the heap blocks are not included, they are of the same size for both interfaces
+    template <class Erased>
+    void iterate(benchmark::State& state)
+    {
+        const auto shapes = makeShapes<Erased>(state.range(0));
+        for(auto _ : state)
+        {
+            std::size_t large = 0;
+            for(const auto& shape : shapes)
+                large += shape.area() > 3;
+            benchmark::DoNotOptimize(large);
+        }
+        state.SetItemsProcessed(state.iterations() * shapes.size());
+        state.counters["interface_bytes"] = sizeof(Erased);
+    }
+}
+
+static void thin_iterate_table_in_interface(benchmark::State& state)
+{
+    iterate<Shape>(state);
+}
+BENCHMARK(thin_iterate_table_in_interface)->Range(1 << 8, 1 << 18);
+
+static void thin_iterate_table_in_block(benchmark::State& state)
+{
+    iterate<ThinShape>(state);
+}
+BENCHMARK(thin_iterate_table_in_block)->Range(1 << 8, 1 << 18);
@@ -0,0 +1,106 @@
+#include <benchmark/benchmark.h>
+
+#include <Storage.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace
+{
+    struct Square
+    {
+        double area() const
+        {
+            return side * side;
+        }
+
+        double side = 2;
+    };
+
+    struct Circle
+    {
+        double area() const
+        {
+            return 3.14159 * radius * radius;
+        }
+
+        double radius = 1;
+    };
+
+    // as generated with 'clang-type-erase -custom -sbo -buffer-size=16' for
+    // struct Shape { double area() const; };
+    class Shape
+    {
+        using area_function = double (*)(const void*);
+
+        template <class Impl>
+        static double area(const void* data)
+        {
+            return static_cast<const Impl*>(data)->area();
+        }
+
+    public:
+        template <class T>
+        Shape(T value)
+            : area_(&area<T>),
+              impl_(std::move(value))
+        {}
+
+        double area() const
+        {
+            return area_(impl_.object());
+        }
+
+        template <class T>
+        const T* target() const noexcept
+        {
+            return impl_.template target<T>();
+        }
+
+    private:
+        area_function area_;
+        clang::type_erasure::SBOStorage<16, false> impl_;
+    };
+
+    // 95% of the shapes are squares
+    std::vector<Shape> makeShapes()
+    {
+        std::vector<Shape> shapes;
+        for(std::size_t i = 0; i < 512; ++i)
+            if(i % 20 == 0)
+                shapes.emplace_back(Circle());
+            else
+                shapes.emplace_back(Square());
+        return shapes;
+    }
+}
+
+static void visit_function_table(benchmark::State& state)
+{
+    const auto shapes = makeShapes();
+    for(auto _ : state)
+    {
+        std::size_t large = 0;
+        for(const auto& shape : shapes)
+            large += shape.area() > 3;
+        benchmark::DoNotOptimize(large);
+    }
+    state.SetItemsProcessed(state.iterations() * shapes.size());
+}
+BENCHMARK(visit_function_table);
+
+static void visit_expected_type(benchmark::State& state)
+{
+    const auto shapes = makeShapes();
+    for(auto _ : state)
+    {
+        std::size_t large = 0;
+        for(const auto& shape : shapes)
+            large += clang::type_erasure::visit<Square>(shape,
+                                                        [](const Square& square) { return square.area(); },
+                                                        [](const Shape& other) { return other.area(); }) > 3;
+        benchmark::DoNotOptimize(large);
+    }
+    state.SetItemsProcessed(state.iterations() * shapes.size());
+}
+BENCHMARK(visit_expected_type);
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "ErrorHandling.h"
+#include "Queue.h"
+#include "Storage.h"
+
+namespace clang
+{
+    namespace type_erasure
+    {
+        /// Call of a method of Erased that is queued for an active object. Callables that fit into
+        /// the buffer are stored without allocation.
+        template <class Erased, int buffer_size>
+        class Command
+        {
+        public:
+            template <class F>
+            explicit Command(F&& f)
+                : run_(&run<std::decay_t<F>>),
+                  callable_(std::forward<F>(f))
+            {}
+
+            void operator()(Erased& object)
+            {
+                run_(callable_.object(), object);
+            }
+
+        private:
+            template <class F>
+            static void run(void* f, Erased& object)
+            {
+                (*static_cast<F*>(f))(object);
+            }
+
+            void (*run_)(void*, Erased&);
+            NonCopyableSBOStorage<buffer_size, false> callable_;
+        };
+
+        namespace detail
+        {
+            template <class R, class F, class Erased>
+            void fulfil(std::promise<R>& promise, F& f, Erased& object, std::false_type)
+            {
+                promise.set_value(f(object));
+            }
+
+            template <class R, class F, class Erased>
+            void fulfil(std::promise<R>& promise, F& f, Erased& object, std::true_type)
+            {
+                f(object);
+                promise.set_value();
+            }
+
+            template <class F, class Done, class Erased>
+            void complete(F& f, Done& done, Erased& object, std::false_type)
+            {
+                done(f(object));
+            }
+
+            template <class F, class Done, class Erased>
+            void complete(F& f, Done& done, Erased& object, std::true_type)
+            {
+                f(object);
+                done();
+            }
+        }
+
+        /// Owns an object of the interface Erased whose methods are called on a dedicated thread,
+        /// see '-active-object'.
+        ///
+        /// Callers from any thread enqueue commands in a bounded lock-free queue, see Queue, and
+        /// wait if it is full. The thread of the object runs all queued commands in a batch before
+        /// it waits for new ones, thus the implementation needs no locking. Commands that fit into
+        /// a buffer of buffer_size bytes are enqueued without allocation; call() additionally
+        /// allocates the shared state of its future, post() does not.
+        template <class Erased, std::size_t capacity = 256, int buffer_size = 64>
+        class ActiveObject
+        {
+            using Call = Command<Erased, buffer_size>;
+
+        public:
+            explicit ActiveObject(Erased object)
+                : object_(std::move(object)),
+                  worker_([this] { run(); })
+            {}
+
+            ActiveObject(const ActiveObject&) = delete;
+            ActiveObject& operator=(const ActiveObject&) = delete;
+
+            /// Runs the commands that have been enqueued so far and stops the thread.
+            ~ActiveObject()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stopped_ = true;
+                }
+                wakeup_.notify_one();
+                worker_.join();
+            }
+
+            /// Calls f(Erased&) on the thread of the object. The future holds its result or the
+            /// exception that it has thrown.
+            template <class F, class R = decltype(std::declval<F&>()(std::declval<Erased&>()))>
+            std::future<R> call(F f)
+            {
+                std::promise<R> promise;
+                auto future = promise.get_future();
+                push([f = std::move(f), promise = std::move(promise)](Erased& object) mutable
+                {
+                    CLANG_TYPE_ERASE_TRY
+                    {
+                        detail::fulfil(promise, f, object, std::is_void<R>());
+                    }
+                    CLANG_TYPE_ERASE_CATCH_ALL
+                    {
+                        promise.set_exception(std::current_exception());
+                    }
+                });
+                return future;
+            }
+
+            /// Calls f(Erased&) on the thread of the object and afterwards done with its result, or
+            /// without arguments if f returns void, on the same thread. Exceptions thrown by f or
+            /// done terminate the program.
+            template <class F, class Done>
+            void post(F f, Done done)
+            {
+                using R = decltype(f(std::declval<Erased&>()));
+                push([f = std::move(f), done = std::move(done)](Erased& object) mutable
+                {
+                    detail::complete(f, done, object, std::is_void<R>());
+                });
+            }
+
+        private:
+            template <class F>
+            void push(F&& f)
+            {
+                while(!queue_.try_emplace(std::forward<F>(f)))
+                    std::this_thread::yield();
+                // counted after the command is enqueued, such that the worker only wakes up for
+                // commands that it can run, it may have run this one already
+                pending_.fetch_add(1, std::memory_order_seq_cst);
+                if(sleeping_.load(std::memory_order_seq_cst))
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    wakeup_.notify_one();
+                }
+            }
+
+            void run()
+            {
+                while(true)
+                {
+                    while(queue_.try_consume([this](Call& command) { command(object_); }))
+                        pending_.fetch_sub(1, std::memory_order_relaxed);
+
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    sleeping_.store(true, std::memory_order_seq_cst);
+                    wakeup_.wait(lock, [this] { return pending_.load(std::memory_order_seq_cst) > 0 || stopped_; });
+                    sleeping_.store(false, std::memory_order_relaxed);
+                    if(stopped_ && pending_.load(std::memory_order_relaxed) <= 0)
+                        return;
+                }
+            }
+
+            Erased object_;
+            Queue<Call, capacity, true, false> queue_;
+            std::atomic<std::ptrdiff_t> pending_{0};
+            std::atomic<bool> sleeping_{false};
+            bool stopped_ = false;
+            std::mutex mutex_;
+            std::condition_variable wakeup_;
+            // started last, after all members that it uses
+            std::thread worker_;
+        };
+    }
+}
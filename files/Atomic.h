@@ -0,0 +1,290 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace clang
+{
+    namespace type_erasure
+    {
+        namespace detail
+        {
+            /// Announces the epoch in which a thread reads from some Atomic.
+            struct EpochRecord
+            {
+                // 0 if the owning thread does not read
+                std::atomic<std::uint64_t> epoch{0};
+                std::atomic<bool> in_use{false};
+                EpochRecord* next = nullptr;
+                // only accessed by the owning thread
+                unsigned nesting = 0;
+            };
+
+
+            /// Epoch-based reclamation for the payloads of Atomic.
+            ///
+            /// Readers announce the current epoch before loading a pointer and clear their
+            /// announcement afterwards. A retired payload is deleted once no reader announces an
+            /// epoch that is not later than the epoch in which the payload was retired.
+            class EpochDomain
+            {
+                struct Retired
+                {
+                    void* data;
+                    void (*del)(void*);
+                    std::uint64_t epoch;
+                };
+
+                class Registration
+                {
+                public:
+                    explicit Registration(EpochRecord& record) noexcept
+                        : record(record)
+                    {}
+
+                    ~Registration()
+                    {
+                        record.in_use.store(false, std::memory_order_release);
+                    }
+
+                    EpochRecord& record;
+                };
+
+            public:
+                static EpochDomain& instance()
+                {
+                    static EpochDomain domain;
+                    return domain;
+                }
+
+                EpochDomain(const EpochDomain&) = delete;
+                EpochDomain& operator=(const EpochDomain&) = delete;
+
+                ~EpochDomain()
+                {
+                    for(auto& retired : retired_)
+                        retired.del(retired.data);
+                    // records are intentionally leaked, threads may still refer to them
+                }
+
+                /// Returns the record of the calling thread, which has to be passed to unpin() on the
+                /// same thread.
+                EpochRecord& pin() noexcept
+                {
+                    auto& record = threadRecord();
+                    if(record.nesting++ == 0)
+                        record.epoch.store(epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+                    return record;
+                }
+
+                void unpin(EpochRecord& record) noexcept
+                {
+                    assert(&record == &threadRecord() && "snapshots must be released on the thread that took them");
+                    assert(record.nesting > 0);
+                    if(--record.nesting == 0)
+                        record.epoch.store(0, std::memory_order_release);
+                }
+
+                void retire(void* data, void (*del)(void*))
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    retired_.push_back(Retired{data, del, epoch_.fetch_add(1, std::memory_order_seq_cst)});
+                    reclaim();
+                }
+
+            private:
+                EpochDomain() = default;
+
+                EpochRecord& threadRecord()
+                {
+                    static thread_local Registration registration(acquireRecord());
+                    return registration.record;
+                }
+
+                EpochRecord& acquireRecord()
+                {
+                    for(auto record = records_.load(std::memory_order_acquire); record; record = record->next)
+                    {
+                        auto in_use = false;
+                        if(!record->in_use.load(std::memory_order_relaxed) &&
+                           record->in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire))
+                            return *record;
+                    }
+
+                    auto record = new EpochRecord;
+                    record->in_use.store(true, std::memory_order_relaxed);
+                    record->next = records_.load(std::memory_order_relaxed);
+                    while(!records_.compare_exchange_weak(record->next, record,
+                                                          std::memory_order_release,
+                                                          std::memory_order_relaxed))
+                    {}
+                    return *record;
+                }
+
+                // requires mutex_
+                void reclaim()
+                {
+                    auto oldest_reader = UINT64_MAX;
+                    for(auto record = records_.load(std::memory_order_acquire); record; record = record->next)
+                    {
+                        const auto epoch = record->epoch.load(std::memory_order_seq_cst);
+                        if(epoch != 0)
+                            oldest_reader = std::min(oldest_reader, epoch);
+                    }
+
+                    const auto reclaimable = std::partition(retired_.begin(), retired_.end(),
+                                                            [oldest_reader](const Retired& retired)
+                    {
+                        return retired.epoch >= oldest_reader;
+                    });
+                    std::for_each(reclaimable, retired_.end(), [](const Retired& retired)
+                    {
+                        retired.del(retired.data);
+                    });
+                    retired_.erase(reclaimable, retired_.end());
+                }
+
+                // starts at 1, 0 marks threads that do not read
+                std::atomic<std::uint64_t> epoch_{1};
+                std::atomic<EpochRecord*> records_{nullptr};
+                std::mutex mutex_;
+                std::vector<Retired> retired_;
+            };
+
+            template <class T>
+            void deleteRetired(void* data) noexcept
+            {
+                delete static_cast<const T*>(data);
+            }
+        }
+
+
+        /// Holder that publishes immutable values of a type-erased interface.
+        ///
+        /// Readers obtain a snapshot of the current value without locking and without waiting
+        /// for writers. Writers replace the value, the previous value is deleted as soon as no
+        /// snapshot refers to it anymore. Intended for copy-on-write interfaces, for which
+        /// update() only copies the parts of the implementation that are actually modified.
+        template <class Erased>
+        class Atomic
+        {
+        public:
+            /// Pins the value that was current when the snapshot has been taken.
+            ///
+            /// A snapshot announces the epoch of the thread that has taken it and must be destroyed
+            /// on that thread. It can be moved, e.g. returned from functions, but not handed over to
+            /// other threads; these take a snapshot of their own or copy the value.
+            class Snapshot
+            {
+            public:
+                Snapshot(Snapshot&& other) noexcept
+                    : value(other.value),
+                      record(other.record)
+                {
+                    other.value = nullptr;
+                }
+
+                Snapshot& operator=(Snapshot&& other) noexcept
+                {
+                    if(this == &other)
+                        return *this;
+                    if(value)
+                        detail::EpochDomain::instance().unpin(*record);
+                    value = other.value;
+                    record = other.record;
+                    other.value = nullptr;
+                    return *this;
+                }
+
+                ~Snapshot()
+                {
+                    if(value)
+                        detail::EpochDomain::instance().unpin(*record);
+                }
+
+                const Erased& get() const noexcept
+                {
+                    assert(value);
+                    return *value;
+                }
+
+                const Erased& operator*() const noexcept
+                {
+                    return get();
+                }
+
+                const Erased* operator->() const noexcept
+                {
+                    return &get();
+                }
+
+            private:
+                friend class Atomic;
+
+                explicit Snapshot(const std::atomic<const Erased*>& current) noexcept
+                    : record(&detail::EpochDomain::instance().pin())
+                {
+                    value = current.load(std::memory_order_seq_cst);
+                }
+
+                const Erased* value;
+                detail::EpochRecord* record;
+            };
+
+            Atomic()
+                : current(new Erased())
+            {}
+
+            explicit Atomic(Erased value)
+                : current(new Erased(std::move(value)))
+            {}
+
+            Atomic(const Atomic&) = delete;
+            Atomic& operator=(const Atomic&) = delete;
+
+            /// Requires that no snapshot of this object is alive.
+            ~Atomic()
+            {
+                delete current.load(std::memory_order_relaxed);
+            }
+
+            Snapshot load() const noexcept
+            {
+                return Snapshot(current);
+            }
+
+            void store(Erased value)
+            {
+                const auto previous = current.exchange(new Erased(std::move(value)), std::memory_order_seq_cst);
+                detail::EpochDomain::instance().retire(const_cast<Erased*>(previous), &detail::deleteRetired<Erased>);
+            }
+
+            /// Applies modify to a copy of the current value and publishes the result.
+            /// Repeats if another writer has published a value in the meantime.
+            template <class Modify>
+            void update(Modify modify)
+            {
+                auto snapshot = load();
+                while(true)
+                {
+                    auto next = new Erased(snapshot.get());
+                    modify(*next);
+                    auto expected = snapshot.value;
+                    if(current.compare_exchange_strong(expected, next, std::memory_order_seq_cst))
+                        break;
+                    delete next;
+                    snapshot = load();
+                }
+                detail::EpochDomain::instance().retire(const_cast<Erased*>(snapshot.value), &detail::deleteRetired<Erased>);
+            }
+
+        private:
+            std::atomic<const Erased*> current;
+        };
+    }
+}
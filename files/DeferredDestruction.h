@@ -0,0 +1,176 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Storage.h"
+
+namespace clang
+{
+    namespace type_erasure
+    {
+        /// Tag of storages whose heap blocks are deleted on a background thread.
+        ///
+        /// If the last storage that refers to a heap block is reset or destroyed, the block is
+        /// handed to a reclamation queue instead of being deleted, such that expensive destructors
+        /// do not add to the latency of the releasing thread. Objects in the buffer of
+        /// small buffer storages are still destroyed immediately.
+        template <class Tag>
+        struct DeferredDestruction
+        {};
+
+        namespace detail
+        {
+            /// Queue of heap blocks whose deletion has been deferred.
+            ///
+            /// The blocks are deleted in batches by a background thread, which is started with the
+            /// first deferred deletion. It wakes up when a batch is full or when the oldest block
+            /// has been waiting for the given interval.
+            class Reclaimer
+            {
+                struct Retired
+                {
+                    ObjectTable::delete_fn del;
+                    SharedCount* block;
+                };
+
+                /// Stops the background thread at exit and deletes the remaining blocks.
+                struct Shutdown
+                {
+                    ~Shutdown()
+                    {
+                        reclaimer.stop();
+                    }
+
+                    Reclaimer& reclaimer;
+                };
+
+            public:
+                static constexpr std::size_t batch_size = 64;
+
+                static Reclaimer& instance()
+                {
+                    // leaked, such that storages that are destroyed after the shutdown still find it
+                    static auto reclaimer = new Reclaimer;
+                    static Shutdown shutdown{*reclaimer};
+                    return *reclaimer;
+                }
+
+                Reclaimer(const Reclaimer&) = delete;
+                Reclaimer& operator=(const Reclaimer&) = delete;
+
+                /// Deletes block immediately if it can not be queued, e.g. after the shutdown.
+                void retire(ObjectTable::delete_fn del, SharedCount* block) noexcept
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        if(!stopped_)
+                        {
+                            CLANG_TYPE_ERASE_TRY
+                            {
+                                if(!worker_.joinable())
+                                    worker_ = std::thread([this] { run(); });
+                                pending_.push_back(Retired{del, block});
+                                if(pending_.size() == 1 || pending_.size() == batch_size)
+                                    wakeup_.notify_one();
+                                return;
+                            }
+                            CLANG_TYPE_ERASE_CATCH_ALL
+                            {}
+                        }
+                    }
+                    del(block);
+                }
+
+                /// Deletes all blocks that have been queued so far, on the calling thread.
+                void drain() noexcept
+                {
+                    std::vector<Retired> batch;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        batch.swap(pending_);
+                        // blocks that have been taken over by the background thread
+                        idle_.wait(lock, [this] { return !deleting_; });
+                    }
+                    destroy(batch);
+                }
+
+                void stop() noexcept
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        stopped_ = true;
+                    }
+                    wakeup_.notify_one();
+                    if(worker_.joinable())
+                        worker_.join();
+                    drain();
+                }
+
+            private:
+                Reclaimer() = default;
+
+                static void destroy(std::vector<Retired>& batch) noexcept
+                {
+                    for(const auto& retired : batch)
+                        retired.del(retired.block);
+                    batch.clear();
+                }
+
+                void run() noexcept
+                {
+                    std::vector<Retired> batch;
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    while(true)
+                    {
+                        wakeup_.wait(lock, [this] { return stopped_ || !pending_.empty(); });
+                        wakeup_.wait_for(lock, std::chrono::milliseconds(1),
+                                         [this] { return stopped_ || pending_.size() >= batch_size; });
+                        if(stopped_)
+                            return;
+
+                        // hands the capacity of the last batch to the queue
+                        batch.swap(pending_);
+                        deleting_ = true;
+                        lock.unlock();
+                        destroy(batch);
+                        lock.lock();
+                        deleting_ = false;
+                        idle_.notify_all();
+                    }
+                }
+
+                std::mutex mutex_;
+                std::condition_variable wakeup_;
+                std::condition_variable idle_;
+                std::vector<Retired> pending_;
+                std::thread worker_;
+                bool deleting_ = false;
+                bool stopped_ = false;
+            };
+
+            template <class Tag>
+            struct Reclamation< DeferredDestruction<Tag> >
+            {
+                static void del(const ObjectTable& table, SharedCount* block) noexcept
+                {
+                    // empty storages release no block
+                    if(block)
+                        Reclaimer::instance().retire(table.del, block);
+                }
+            };
+        }
+
+        /// Deletes all heap blocks whose deletion has been deferred so far on the calling thread,
+        /// e.g. before measuring memory or before objects that are referred to by the stored
+        /// objects are destroyed.
+        inline void drainDeferredDestruction() noexcept
+        {
+            detail::Reclaimer::instance().drain();
+        }
+    }
+}
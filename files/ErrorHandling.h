@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+/// Builds without exceptions report errors to the failure handler instead of throwing and make
+/// all lifecycle operations of the storages noexcept. This is the case if exceptions are disabled
+/// with '-fno-exceptions' or if CLANG_TYPE_ERASE_NO_EXCEPTIONS is defined.
+#if !defined(CLANG_TYPE_ERASE_NO_EXCEPTIONS) && !defined(__cpp_exceptions) && !defined(__EXCEPTIONS)
+#define CLANG_TYPE_ERASE_NO_EXCEPTIONS
+#endif
+
+#ifdef CLANG_TYPE_ERASE_NO_EXCEPTIONS
+#define CLANG_TYPE_ERASE_TRY if(true)
+#define CLANG_TYPE_ERASE_CATCH_ALL else
+#define CLANG_TYPE_ERASE_RETHROW
+#define CLANG_TYPE_ERASE_NOTHROW noexcept
+#define CLANG_TYPE_ERASE_NOEXCEPT(...) noexcept
+#else
+#define CLANG_TYPE_ERASE_TRY try
+#define CLANG_TYPE_ERASE_CATCH_ALL catch(...)
+#define CLANG_TYPE_ERASE_RETHROW throw
+#define CLANG_TYPE_ERASE_NOTHROW
+#define CLANG_TYPE_ERASE_NOEXCEPT(...) noexcept(__VA_ARGS__)
+#endif
+
+/// Exception specification of function pointer types, which is part of the type since C++17.
+#if defined(CLANG_TYPE_ERASE_NO_EXCEPTIONS) && defined(__cpp_noexcept_function_type)
+#define CLANG_TYPE_ERASE_NOTHROW_FUNCTION noexcept
+#else
+#define CLANG_TYPE_ERASE_NOTHROW_FUNCTION
+#endif
+
+namespace clang
+{
+    namespace type_erasure
+    {
+        /// Called with a description of the error if a storage fails without exceptions, e.g. if
+        /// memory can not be allocated. The process is aborted if the handler returns.
+        using failure_handler = void(*)(const char* what);
+
+        namespace detail
+        {
+            inline std::atomic<failure_handler>& failureHandler() noexcept
+            {
+                static std::atomic<failure_handler> handler{nullptr};
+                return handler;
+            }
+        }
+
+        /// Installs the handler for failures in builds without exceptions and returns the
+        /// previous one. Without a handler, failures abort the process.
+        inline failure_handler setFailureHandler(failure_handler handler) noexcept
+        {
+            return detail::failureHandler().exchange(handler);
+        }
+
+        namespace detail
+        {
+            [[noreturn]] inline void abortWith(const char* what) noexcept
+            {
+                if(const auto handler = failureHandler().load())
+                    handler(what);
+                std::abort();
+            }
+
+            /// Throws Exception(what), or calls the failure handler and aborts in builds without
+            /// exceptions.
+            template <class Exception>
+            [[noreturn]] void fail(const char* what)
+            {
+#ifdef CLANG_TYPE_ERASE_NO_EXCEPTIONS
+                abortWith(what);
+#else
+                throw Exception(what);
+#endif
+            }
+
+            [[noreturn]] inline void failAllocation()
+            {
+#ifdef CLANG_TYPE_ERASE_NO_EXCEPTIONS
+                abortWith("memory allocation failed");
+#else
+                throw std::bad_alloc();
+#endif
+            }
+
+            /// Entry of the function tables of empty interfaces, see '-null-object'. Calls of methods
+            /// of empty or moved-from interfaces are reported to the failure handler, without
+            /// checking for emptiness in each call.
+            template <class FunctionPointer>
+            struct EmptyCall;
+
+            template <class R, class... Args>
+            struct EmptyCall<R(*)(Args...)>
+            {
+                [[noreturn]] static R call(Args...) noexcept
+                {
+                    abortWith("method called on an empty interface");
+                }
+            };
+
+#ifdef __cpp_noexcept_function_type
+            template <class R, class... Args>
+            struct EmptyCall<R(*)(Args...) noexcept> : EmptyCall<R(*)(Args...)>
+            {};
+#endif
+
+            /// Allocates size bytes on the heap, builds without exceptions use the non-throwing
+            /// operator new and report failures to the failure handler.
+            inline void* allocate(std::size_t size) CLANG_TYPE_ERASE_NOTHROW
+            {
+#ifdef CLANG_TYPE_ERASE_NO_EXCEPTIONS
+                const auto memory = ::operator new(size, std::nothrow);
+                if(!memory)
+                    failAllocation();
+                return memory;
+#else
+                return ::operator new(size);
+#endif
+            }
+
+            /// Creates an object of type T on the heap, which is destroyed with delete.
+            template <class T, class... Args>
+            T* allocateObject(Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+            {
+#ifdef CLANG_TYPE_ERASE_NO_EXCEPTIONS
+                const auto object = new (std::nothrow) T(std::forward<Args>(args)...);
+                if(!object)
+                    failAllocation();
+                return object;
+#else
+                return new T(std::forward<Args>(args)...);
+#endif
+            }
+        }
+    }
+}
@@ -0,0 +1,459 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Storage.h"
+
+namespace clang
+{
+    namespace type_erasure
+    {
+        namespace detail
+        {
+            /// Handles consist of the index of the type of the stored object in the registry of
+            /// the interface and the index of its slot in the slab of that type.
+            constexpr unsigned handleSlotBits = 24;
+            constexpr std::uint32_t handleSlotMask = (std::uint32_t(1) << handleSlotBits) - 1;
+            // type index 0 is reserved for empty storages
+            constexpr std::size_t maxHandleTypes = std::size_t(1) << (32 - handleSlotBits);
+
+            /// Slabs grow in chunks of 2^slabChunkBits slots, which are never moved or released.
+            constexpr unsigned slabChunkBits = 12;
+            constexpr std::uint32_t slabChunkMask = (std::uint32_t(1) << slabChunkBits) - 1;
+            constexpr std::size_t maxSlabChunks = std::size_t(1) << (handleSlotBits - slabChunkBits);
+
+            /// Dense storage of all objects of type T that are stored in handle storages with Tag.
+            template <class Tag, class T>
+            class Slab
+            {
+            public:
+                static Slab& instance()
+                {
+                    static Slab slab;
+                    return slab;
+                }
+
+                /// Returns an unused slot, the object must be constructed by the caller.
+                std::uint32_t allocate()
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(!free.empty())
+                    {
+                        const auto slot = free.back();
+                        free.pop_back();
+                        live[slot] = true;
+                        return slot;
+                    }
+                    if(end > handleSlotMask)
+                        fail<std::length_error>("slab of handle storage is full");
+                    if(live.size() == live.capacity())
+                        live.reserve(2 * live.capacity() + 64);
+                    // such that release does not allocate
+                    if(free.capacity() < live.capacity())
+                        free.reserve(live.capacity());
+                    if((end & slabChunkMask) == 0)
+                        chunks[end >> slabChunkBits] = static_cast<char*>(detail::allocate(sizeof(T) << slabChunkBits));
+                    live.push_back(true);
+                    return end++;
+                }
+
+                /// Returns slot, whose object must have been destroyed by the caller.
+                void release(std::uint32_t slot) noexcept
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    assert(live[slot]);
+                    live[slot] = false;
+                    free.push_back(slot);
+                }
+
+                T* data(std::uint32_t slot) noexcept
+                {
+                    return reinterpret_cast<T*>(chunks[slot >> slabChunkBits]) + (slot & slabChunkMask);
+                }
+
+                /// Calls f for all stored objects in the order of their slots. Must not run
+                /// concurrently with the construction or destruction of objects of type T.
+                template <class F>
+                void for_each(F&& f)
+                {
+                    for(std::uint32_t first = 0; first < end; first += slabChunkMask + 1)
+                    {
+                        const auto objects = reinterpret_cast<T*>(chunks[first >> slabChunkBits]);
+                        const auto last = std::min(end - first, slabChunkMask + 1);
+                        for(std::uint32_t slot = 0; slot < last; ++slot)
+                            if(live[first + slot])
+                                f(objects[slot]);
+                    }
+                }
+
+                // the chunks are never written after they have been handed out by allocate
+                char* chunks[maxSlabChunks] = {};
+
+            private:
+                Slab() = default;
+
+                std::mutex mutex;
+                std::vector<std::uint32_t> free;
+                std::vector<bool> live;
+                std::uint32_t end = 0;
+            };
+
+            /// Identifies the type of the objects in a slab and how to resolve their slots.
+            /// Followed by the function table of the interface, see HandleDescriptor.
+            struct HandleDescriptorBase
+            {
+                using allocate_fn = std::uint32_t(*)();
+                using release_fn = void(*)(std::uint32_t);
+
+                const ObjectTable* object;
+                char* const* chunks;
+                std::size_t size;
+                allocate_fn allocate;
+                release_fn release;
+
+                void* data(std::uint32_t slot) const noexcept
+                {
+                    return chunks[slot >> slabChunkBits] + (slot & slabChunkMask) * size;
+                }
+            };
+
+            template <class Functions>
+            struct HandleDescriptor : HandleDescriptorBase
+            {
+                HandleDescriptor(const HandleDescriptorBase& base, const Functions& functions) noexcept
+                    : HandleDescriptorBase(base),
+                      functions(functions)
+                {}
+
+                Functions functions;
+            };
+
+            template <class Tag, class T>
+            std::uint32_t allocateSlot()
+            {
+                return Slab<Tag, T>::instance().allocate();
+            }
+
+            template <class Tag, class T>
+            void releaseSlot(std::uint32_t slot) noexcept
+            {
+                Slab<Tag, T>::instance().release(slot);
+            }
+
+            /// Descriptors of the types that are stored in the handle storages with Tag.
+            ///
+            /// Entries are written once, before the first handle that refers to them is created.
+            template <class Tag>
+            struct HandleRegistry
+            {
+                static std::uint32_t add(const HandleDescriptorBase* descriptor)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(size == maxHandleTypes)
+                        fail<std::length_error>("too many types in handle storages");
+                    descriptors[size] = descriptor;
+                    return static_cast<std::uint32_t>(size++);
+                }
+
+                static const HandleDescriptorBase* descriptors[maxHandleTypes];
+                static std::mutex mutex;
+                static std::size_t size;
+            };
+
+            template <class Tag>
+            const HandleDescriptorBase* HandleRegistry<Tag>::descriptors[maxHandleTypes] = {};
+
+            template <class Tag>
+            std::mutex HandleRegistry<Tag>::mutex;
+
+            template <class Tag>
+            std::size_t HandleRegistry<Tag>::size = 1;
+
+            /// Index of T in the registry of Tag, shifted to the type bits of the handles.
+            template <class Tag, class T, class Functions>
+            std::uint32_t handleType(const Functions& functions)
+            {
+                static const HandleDescriptor<Functions> descriptor(
+                    { objectTable<T>(), Slab<Tag, T>::instance().chunks, sizeof(T),
+                      &allocateSlot<Tag, T>, &releaseSlot<Tag, T> },
+                    functions);
+                static const auto type = HandleRegistry<Tag>::add(&descriptor) << handleSlotBits;
+                return type;
+            }
+
+
+            /// Common part of the handle storages, see HandleStorage.
+            template <class Tag>
+            class HandleStorageBase : private StatsRecorder<Tag>,
+                                      private StorageBase
+            {
+            public:
+                /// The function table that has been passed to the constructor.
+                ///
+                /// Functions must be the type of that table, which the generated interfaces
+                /// guarantee by always passing their own table.
+                template <class Functions>
+                const Functions& functions() const noexcept
+                {
+                    return static_cast<const HandleDescriptor<Functions>&>(descriptor()).functions;
+                }
+
+                /// Pointer to the stored object, as passed to the function table.
+                void* object() noexcept
+                {
+                    return read();
+                }
+
+                /// Pointer to the stored object, as passed to the function table.
+                const void* object() const noexcept
+                {
+                    return read();
+                }
+
+                explicit operator bool() const noexcept
+                {
+                    return handle != 0;
+                }
+
+                template <class T>
+                T& get() noexcept
+                {
+                    const auto result = target<T>();
+                    assert(result);
+                    return *result;
+                }
+
+                template <class T>
+                const T& get() const noexcept
+                {
+                    const auto result = target<T>();
+                    assert(result);
+                    return *result;
+                }
+
+                /// Pointer to the stored object if it is of type T or refers to an object of type
+                /// T, else nullptr.
+                template <class T>
+                T* target() noexcept
+                {
+                    return const_cast<T*>(static_cast<const HandleStorageBase&>(*this).target<T>());
+                }
+
+                template <class T>
+                const T* target() const noexcept
+                {
+                    if(holds<T>())
+                        return static_cast<const T*>(read());
+                    if(holds< std::reference_wrapper<T> >())
+                        return &static_cast<const std::reference_wrapper<T>*>(read())->get();
+                    return nullptr;
+                }
+
+                /// True if target<T>() does not return nullptr.
+                template <class T>
+                bool is() const noexcept
+                {
+                    return holds<T>() || holds< std::reference_wrapper<T> >();
+                }
+
+                /// Identifies the type of the stored object, nullptr if the storage is empty.
+                const void* type() const noexcept
+                {
+                    return handle ? descriptor().object : nullptr;
+                }
+
+            protected:
+                using Recorder = StatsRecorder<Tag>;
+
+                constexpr HandleStorageBase() noexcept = default;
+
+                template <class T, class Functions, class... Args>
+                HandleStorageBase(in_place_type_t<T>, const Functions& functions, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+                {
+                    static_assert(alignof(T) <= alignof(std::max_align_t),
+                                  "over-aligned types can not be stored in handle storages");
+                    const auto type = handleType<Tag, T>(functions);
+                    auto& slab = Slab<Tag, T>::instance();
+                    const auto slot = slab.allocate();
+                    CLANG_TYPE_ERASE_TRY
+                    {
+                        new (slab.data(slot)) T(std::forward<Args>(args)...);
+                    }
+                    CLANG_TYPE_ERASE_CATCH_ALL
+                    {
+                        slab.release(slot);
+                        CLANG_TYPE_ERASE_RETHROW;
+                    }
+                    handle = type | slot;
+                    // slots are not allocated individually
+                    Recorder::template recordConstruction<T>(true);
+                }
+
+                HandleStorageBase(HandleStorageBase&& other) noexcept
+                    : Recorder(other),
+                      handle(other.handle)
+                {
+                    other.handle = 0;
+                }
+
+                ~HandleStorageBase()
+                {
+                    reset();
+                }
+
+                /// Copies the object of other to a new slot in the same slab.
+                void copy(const HandleStorageBase& other) CLANG_TYPE_ERASE_NOTHROW
+                {
+                    assert(!handle);
+                    if(!other.handle)
+                        return;
+                    const auto& descriptor = other.descriptor();
+                    assert(descriptor.object->copy_into);
+                    const auto slot = descriptor.allocate();
+                    CLANG_TYPE_ERASE_TRY
+                    {
+                        descriptor.object->copy_into(other.read(), descriptor.data(slot));
+                    }
+                    CLANG_TYPE_ERASE_CATCH_ALL
+                    {
+                        descriptor.release(slot);
+                        CLANG_TYPE_ERASE_RETHROW;
+                    }
+                    Recorder::operator=(other);
+                    handle = (other.handle & ~handleSlotMask) | slot;
+                    Recorder::recordClone();
+                }
+
+                void move(HandleStorageBase& other) noexcept
+                {
+                    if(this == &other)
+                        return;
+                    reset();
+                    Recorder::operator=(other);
+                    handle = other.handle;
+                    other.handle = 0;
+                }
+
+                void reset() noexcept
+                {
+                    if(!handle)
+                        return;
+                    Recorder::recordDestruction();
+                    const auto& descriptor = this->descriptor();
+                    const auto slot = handle & handleSlotMask;
+                    descriptor.object->destruct(descriptor.data(slot));
+                    descriptor.release(slot);
+                    handle = 0;
+                }
+
+            private:
+                const HandleDescriptorBase& descriptor() const noexcept
+                {
+                    assert(handle);
+                    return *HandleRegistry<Tag>::descriptors[handle >> handleSlotBits];
+                }
+
+                void* read() const noexcept
+                {
+                    return handle ? descriptor().data(handle & handleSlotMask) : nullptr;
+                }
+
+                template <class T>
+                bool holds() const noexcept
+                {
+                    return type() == objectTable< std::decay_t<T> >();
+                }
+
+                std::uint32_t handle = 0;
+            };
+        }
+
+
+        /// Storage that only holds a 32-bit handle.
+        ///
+        /// The objects of each type are stored in a dense slab that is shared by all handle
+        /// storages with the same Tag, the handle consists of the index of the type in the
+        /// registry of Tag and the slot of the object. Up to 255 types per Tag and 2^24 objects
+        /// per type are supported. Calls resolve the handle through the registry, whose
+        /// descriptors also hold the function table of the interface.
+        template <bool rttiEnabled, class Tag = void>
+        class HandleStorage : public detail::HandleStorageBase<Tag>
+        {
+            using Base = detail::HandleStorageBase<Tag>;
+        public:
+            constexpr HandleStorage() noexcept = default;
+
+            /// Constructs the stored object in the slab of T.
+            template <class T, class Functions, class... Args>
+            explicit HandleStorage(in_place_type_t<T>, const Functions& functions, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+                : Base(in_place_type<T>, functions, std::forward<Args>(args)...)
+            {
+                static_assert(std::is_copy_constructible<T>::value, "stored objects must be copyable");
+            }
+
+            HandleStorage(const HandleStorage& other) CLANG_TYPE_ERASE_NOTHROW
+                : Base()
+            {
+                this->copy(other);
+            }
+
+            HandleStorage(HandleStorage&&) noexcept = default;
+
+            HandleStorage& operator=(const HandleStorage& other) CLANG_TYPE_ERASE_NOTHROW
+            {
+                if(this != &other)
+                    *this = HandleStorage(other);
+                return *this;
+            }
+
+            HandleStorage& operator=(HandleStorage&& other) noexcept
+            {
+                this->move(other);
+                return *this;
+            }
+        };
+
+
+        /// Move-only variant of HandleStorage.
+        template <bool rttiEnabled, class Tag = void>
+        class NonCopyableHandleStorage : public detail::HandleStorageBase<Tag>
+        {
+            using Base = detail::HandleStorageBase<Tag>;
+        public:
+            constexpr NonCopyableHandleStorage() noexcept = default;
+
+            template <class T, class Functions, class... Args>
+            explicit NonCopyableHandleStorage(in_place_type_t<T>, const Functions& functions, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+                : Base(in_place_type<T>, functions, std::forward<Args>(args)...)
+            {}
+
+            NonCopyableHandleStorage(NonCopyableHandleStorage&&) noexcept = default;
+
+            NonCopyableHandleStorage& operator=(NonCopyableHandleStorage&& other) noexcept
+            {
+                this->move(other);
+                return *this;
+            }
+        };
+
+
+        /// Calls f for all objects of type T in handle storages with Tag, which are stored
+        /// contiguously in chunks of 4096 objects. Must not run concurrently with the
+        /// construction or destruction of objects of type T.
+        template <class Tag, class T, class F>
+        void forEachInSlab(F&& f)
+        {
+            detail::Slab<Tag, T>::instance().for_each(std::forward<F>(f));
+        }
+    }
+}
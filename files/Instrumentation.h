@@ -0,0 +1,235 @@
+#pragma once
+
+#include "StorageStats.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef CLANG_TYPE_ERASE_USDT
+#include <sys/sdt.h>
+#endif
+
+/// Measure the latency of every n-th call on each thread, 0 disables latency sampling.
+#ifndef CLANG_TYPE_ERASE_LATENCY_SAMPLE_RATE
+#define CLANG_TYPE_ERASE_LATENCY_SAMPLE_RATE 0
+#endif
+
+namespace clang
+{
+    namespace type_erasure
+    {
+        /// Metrics of one method of one implementation of a type-erased interface.
+        struct MethodMetrics
+        {
+            std::string interface;
+            std::string method;
+            std::string implementation;
+            std::uint64_t calls = 0;
+            std::uint64_t sampled_calls = 0;
+            /// latency_histogram[i] counts the sampled calls with a latency in [2^i, 2^(i+1)) ns,
+            /// the first bucket includes 0ns
+            std::vector<std::uint64_t> latency_histogram;
+        };
+
+        namespace detail
+        {
+            constexpr std::size_t n_call_counter_shards = 16;
+            constexpr std::size_t n_latency_buckets = 40;
+
+            /// Distributes the threads to the shards of the call counters.
+            inline std::size_t threadShard() noexcept
+            {
+                static std::atomic<std::size_t> n_threads{0};
+                static thread_local const auto shard = n_threads.fetch_add(1, std::memory_order_relaxed) % n_call_counter_shards;
+                return shard;
+            }
+
+            /// Padded to a cache line, over-aligned allocation requires C++17.
+            struct CallCounter
+            {
+                std::atomic<std::uint64_t> value{0};
+                char padding[64 - sizeof(std::atomic<std::uint64_t>)];
+            };
+
+            /// Counters of one method of one implementation.
+            class MethodCounters
+            {
+            public:
+                MethodCounters(const char* interface, const char* method, std::string implementation)
+                    : interface(interface),
+                      method(method),
+                      implementation(std::move(implementation))
+                {}
+
+                void count() noexcept
+                {
+                    calls[threadShard()].value.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                void record(std::chrono::nanoseconds latency) noexcept
+                {
+                    auto ns = static_cast<std::uint64_t>(latency.count());
+                    std::size_t bucket = 0;
+                    while((ns >>= 1) && bucket + 1 < n_latency_buckets)
+                        ++bucket;
+                    latency_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+                }
+
+                MethodMetrics collect() const
+                {
+                    MethodMetrics metrics;
+                    metrics.interface = interface;
+                    metrics.method = method;
+                    metrics.implementation = implementation;
+                    for(const auto& counter : calls)
+                        metrics.calls += counter.value.load(std::memory_order_relaxed);
+                    for(const auto& counter : latency_histogram)
+                    {
+                        metrics.latency_histogram.push_back(counter.load(std::memory_order_relaxed));
+                        metrics.sampled_calls += metrics.latency_histogram.back();
+                    }
+                    return metrics;
+                }
+
+                const char* const interface;
+                const char* const method;
+                const std::string implementation;
+
+            private:
+                std::array<CallCounter, n_call_counter_shards> calls{};
+                std::array<std::atomic<std::uint64_t>, n_latency_buckets> latency_histogram{};
+            };
+
+            class InstrumentationRegistry
+            {
+            public:
+                static InstrumentationRegistry& instance()
+                {
+                    static InstrumentationRegistry registry;
+                    return registry;
+                }
+
+                /// Thunks of the same implementation, e.g. stored by value and by std::reference_wrapper,
+                /// share their counters.
+                MethodCounters& add(const char* interface, const char* method, std::string implementation)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    for(const auto& entry : counters)
+                        if(std::strcmp(entry->interface, interface) == 0 && std::strcmp(entry->method, method) == 0 &&
+                           entry->implementation == implementation)
+                            return *entry;
+                    counters.emplace_back(new MethodCounters(interface, method, std::move(implementation)));
+                    return *counters.back();
+                }
+
+                std::vector<MethodMetrics> collect() const
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    std::vector<MethodMetrics> metrics;
+                    for(const auto& entry : counters)
+                        metrics.push_back(entry->collect());
+                    return metrics;
+                }
+
+            private:
+                mutable std::mutex mutex;
+                std::vector<std::unique_ptr<MethodCounters>> counters;
+            };
+
+            /// Called once for each method and implementation by the generated code.
+            inline MethodCounters& registerMethod(const char* interface, const char* method, std::string implementation)
+            {
+                return InstrumentationRegistry::instance().add(interface, method, std::move(implementation));
+            }
+        }
+
+
+        /// Instruments one call of a method of a type-erased interface.
+        ///
+        /// Counts the call, samples its latency if CLANG_TYPE_ERASE_LATENCY_SAMPLE_RATE is positive
+        /// and fires the USDT probes clang_type_erase:method_entry and clang_type_erase:method_return
+        /// with the interface, method and implementation as arguments if CLANG_TYPE_ERASE_USDT is defined.
+        class MethodCall
+        {
+        public:
+            explicit MethodCall(detail::MethodCounters& counters) noexcept
+                : counters(counters)
+            {
+                counters.count();
+#ifdef CLANG_TYPE_ERASE_USDT
+                DTRACE_PROBE3(clang_type_erase, method_entry,
+                              counters.interface, counters.method, counters.implementation.c_str());
+#endif
+#if CLANG_TYPE_ERASE_LATENCY_SAMPLE_RATE > 0
+                static thread_local unsigned n_calls = 0;
+                if(++n_calls % CLANG_TYPE_ERASE_LATENCY_SAMPLE_RATE == 0)
+                {
+                    sampled = true;
+                    start = std::chrono::steady_clock::now();
+                }
+#endif
+            }
+
+            MethodCall(const MethodCall&) = delete;
+            MethodCall& operator=(const MethodCall&) = delete;
+
+            ~MethodCall()
+            {
+#if CLANG_TYPE_ERASE_LATENCY_SAMPLE_RATE > 0
+                if(sampled)
+                    counters.record(std::chrono::steady_clock::now() - start);
+#endif
+#ifdef CLANG_TYPE_ERASE_USDT
+                DTRACE_PROBE3(clang_type_erase, method_return,
+                              counters.interface, counters.method, counters.implementation.c_str());
+#endif
+            }
+
+        private:
+            detail::MethodCounters& counters;
+#if CLANG_TYPE_ERASE_LATENCY_SAMPLE_RATE > 0
+            bool sampled = false;
+            std::chrono::steady_clock::time_point start;
+#endif
+        };
+
+
+        /// Metrics of all instrumented methods, see '-instrument' of clang-type-erase.
+        inline std::vector<MethodMetrics> collectMethodMetrics()
+        {
+            return detail::InstrumentationRegistry::instance().collect();
+        }
+
+        /// Writes metrics as JSON object.
+        inline std::ostream& operator<<(std::ostream& OS, const MethodMetrics& metrics)
+        {
+            OS << "{\"interface\": \"" << metrics.interface << "\", "
+               << "\"method\": \"" << metrics.method << "\", "
+               << "\"implementation\": \"" << metrics.implementation << "\", "
+               << "\"calls\": " << metrics.calls << ", "
+               << "\"sampled_calls\": " << metrics.sampled_calls << ", "
+               << "\"latency_histogram_ns\": [";
+            for(std::size_t i = 0; i < metrics.latency_histogram.size(); ++i)
+                OS << (i == 0 ? "" : ", ") << metrics.latency_histogram[i];
+            return OS << "]}";
+        }
+
+        /// Writes the metrics of all instrumented methods as JSON array.
+        inline void writeMethodMetrics(std::ostream& OS)
+        {
+            const auto metrics = collectMethodMetrics();
+            OS << "[";
+            for(const auto& entry : metrics)
+                OS << (&entry == &metrics.front() ? "\n" : ",\n") << entry;
+            OS << "\n]\n";
+        }
+    }
+}
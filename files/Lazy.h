@@ -0,0 +1,238 @@
+#pragma once
+
+#include <atomic>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "ErrorHandling.h"
+#include "TypeErasureUtil.h"
+
+namespace clang
+{
+    namespace type_erasure
+    {
+        namespace detail
+        {
+            /// Factory of a lazy implementation, which is replaced by the implementation in the first
+            /// call. The state is claimed while the factory is called or copied.
+            template <class Impl, class Factory>
+            class LazyState
+            {
+                static_assert(std::is_nothrow_move_constructible<Factory>::value,
+                              "the factories of lazy implementations are not nothrow move constructible");
+
+                enum : unsigned char { unbuilt, busy, ready };
+
+                /// Resets the claimed state on destruction.
+                struct Release
+                {
+                    ~Release()
+                    {
+                        state.store(value, std::memory_order_release);
+                    }
+
+                    std::atomic<unsigned char>& state;
+                    unsigned char value;
+                };
+
+            public:
+                explicit LazyState(Factory factory) noexcept
+                {
+                    new(&storage_) Factory(std::move(factory));
+                }
+
+                LazyState(const LazyState& other)
+                {
+                    if(other.claim() == ready)
+                    {
+                        new(&storage_) Impl(other.object());
+                        state_.store(ready, std::memory_order_relaxed);
+                        return;
+                    }
+                    // the factory of other is not replaced while it is copied
+                    Release release{other.state_, unbuilt};
+                    new(&storage_) Factory(other.factory());
+                }
+
+                LazyState(LazyState&& other) noexcept(std::is_nothrow_move_constructible<Impl>::value)
+                {
+                    if(other.state_.load(std::memory_order_relaxed) == ready)
+                    {
+                        new(&storage_) Impl(std::move(other.object()));
+                        state_.store(ready, std::memory_order_relaxed);
+                    }
+                    else
+                        new(&storage_) Factory(std::move(other.factory()));
+                }
+
+                LazyState& operator=(const LazyState&) = delete;
+                LazyState& operator=(LazyState&&) = delete;
+
+                ~LazyState()
+                {
+                    if(state_.load(std::memory_order_relaxed) == ready)
+                        object().~Impl();
+                    else
+                        factory().~Factory();
+                }
+
+                Impl& get() const
+                {
+                    if(state_.load(std::memory_order_acquire) != ready)
+                        build();
+                    return object();
+                }
+
+                bool built() const noexcept
+                {
+                    return state_.load(std::memory_order_acquire) == ready;
+                }
+
+            private:
+                /// Returns ready, or unbuilt after setting the state to busy, which the caller resets.
+                unsigned char claim() const noexcept
+                {
+                    while(true)
+                    {
+                        auto state = state_.load(std::memory_order_acquire);
+                        if(state == ready)
+                            return ready;
+                        if(state == unbuilt &&
+                           state_.compare_exchange_weak(state, busy, std::memory_order_acquire, std::memory_order_relaxed))
+                            return unbuilt;
+                        std::this_thread::yield();
+                    }
+                }
+
+                /// Replaces the factory by the implementation that it returns. Concurrent first calls
+                /// wait for it, if the factory throws, the next call retries.
+                void build() const
+                {
+                    if(claim() == ready)
+                        return;
+                    Release release{state_, unbuilt};
+                    Factory factory(std::move(this->factory()));
+                    this->factory().~Factory();
+                    CLANG_TYPE_ERASE_TRY
+                    {
+                        new(&storage_) Impl(factory());
+                    }
+                    CLANG_TYPE_ERASE_CATCH_ALL
+                    {
+                        new(&storage_) Factory(std::move(factory));
+                        CLANG_TYPE_ERASE_RETHROW;
+                    }
+                    release.value = ready;
+                }
+
+                Impl& object() const noexcept
+                {
+                    return *static_cast<Impl*>(static_cast<void*>(&storage_));
+                }
+
+                Factory& factory() const noexcept
+                {
+                    return *static_cast<Factory*>(static_cast<void*>(&storage_));
+                }
+
+                mutable std::atomic<unsigned char> state_{unbuilt};
+                mutable std::aligned_union_t<0, Factory, Impl> storage_;
+            };
+
+            /// Deletes the copy constructor of lazy implementations whose factory or implementation
+            /// can not be copied, such that they are stored in non-copyable interfaces.
+            template <bool copyable>
+            struct LazyCopy
+            {};
+
+            template <>
+            struct LazyCopy<false>
+            {
+                LazyCopy() = default;
+                LazyCopy(const LazyCopy&) = delete;
+                LazyCopy(LazyCopy&&) = default;
+                LazyCopy& operator=(const LazyCopy&) = delete;
+                LazyCopy& operator=(LazyCopy&&) = default;
+            };
+        }
+
+        /// Implementation of type Impl that is built by a factory on its first use.
+        ///
+        /// Interfaces store the factory, i.e. in the buffer of small buffer storages if it and Impl
+        /// fit, and call it in the first call of a method, which replaces the factory by Impl. A lazy
+        /// implementation thus takes the larger of both sizes and a state byte, and resources that
+        /// Impl acquires in its constructor are only acquired for objects that are used. Concurrent
+        /// first calls build the implementation once, later calls only check that it has been built
+        /// and neither allocate nor call through another pointer. Copies of lazy implementations
+        /// that have not been built yet stay lazy. Move-only factories are stored in non-copyable
+        /// interfaces, factories must not throw when they are moved.
+        ///
+        /// The interfaces check and call Impl, but store Lazy<Impl, Factory>, to which 'target' and
+        /// 'is' refer. Methods that take another interface as argument are not supported.
+        template <class Impl, class Factory>
+        class Lazy
+            : detail::LazyCopy<std::is_copy_constructible<Factory>::value && std::is_copy_constructible<Impl>::value>
+        {
+        public:
+            explicit Lazy(Factory factory)
+                : state_(std::move(factory))
+            {}
+
+            Lazy(const Lazy&) = default;
+            Lazy(Lazy&&) = default;
+            Lazy& operator=(const Lazy&) = delete;
+            Lazy& operator=(Lazy&&) = delete;
+
+            /// Builds the implementation with the factory if this is the first call.
+            Impl& get() const
+            {
+                return state_.get();
+            }
+
+            bool built() const noexcept
+            {
+                return state_.built();
+            }
+
+        private:
+            detail::LazyState<Impl, Factory> state_;
+        };
+
+        /// Stores factory in an interface, e.g. 'Fooable fooable = lazy<Foo>([&config] { return Foo(config); });'.
+        template <class Impl, class Factory>
+        Lazy<Impl, std::decay_t<Factory>> lazy(Factory&& factory)
+        {
+            return Lazy<Impl, std::decay_t<Factory>>(std::forward<Factory>(factory));
+        }
+    }
+}
+
+// @cond TYPE_ERASURE_DETAIL
+
+namespace type_erasure_table_detail
+{
+    /// Lazy implementations are checked against and called as Impl.
+    template < class Impl, class Factory >
+    struct remove_reference_wrapper< clang::type_erasure::Lazy< Impl, Factory > >
+    {
+        using type = Impl;
+    };
+
+    template < class Impl, class Factory >
+    struct object_access< clang::type_erasure::Lazy< Impl, Factory > >
+    {
+        static Impl& get( void* data )
+        {
+            return static_cast< const clang::type_erasure::Lazy< Impl, Factory >* >( data )->get( );
+        }
+
+        static const Impl& get( const void* data )
+        {
+            return static_cast< const clang::type_erasure::Lazy< Impl, Factory >* >( data )->get( );
+        }
+    };
+}
+
+// @endcond
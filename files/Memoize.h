@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace clang
+{
+    namespace type_erasure
+    {
+        /// Replacement policies of MemoCache. Both evict the oldest entry if the cache is full, with
+        /// LruPolicy hits renew their entry.
+        struct LruPolicy
+        {
+            template <class Entries>
+            static void hit(Entries& entries, std::size_t index)
+            {
+                std::rotate(begin(entries), begin(entries) + static_cast<std::ptrdiff_t>(index),
+                            begin(entries) + static_cast<std::ptrdiff_t>(index + 1));
+            }
+        };
+
+        struct FifoPolicy
+        {
+            template <class Entries>
+            static void hit(Entries&, std::size_t)
+            {}
+        };
+
+        namespace detail
+        {
+            inline std::size_t combineHashes(std::size_t seed, std::size_t hash) noexcept
+            {
+                return seed ^ (hash + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+            }
+
+            inline std::size_t hashArguments() noexcept
+            {
+                return 0;
+            }
+
+            template <class Arg, class... Args>
+            std::size_t hashArguments(const Arg& arg, const Args&... args)
+            {
+                return combineHashes(std::hash<Arg>()(arg), hashArguments(args...));
+            }
+        }
+
+        /// Results of a const method of an interface for the last Size distinct arguments, see
+        /// '[[clang::annotate("te_memoize")]]'. The entries are keyed on the hash of the arguments,
+        /// which are compared on hash collisions, and cleared when a non-const method of the
+        /// interface is called. The method is called without holding the lock of the cache, such
+        /// that concurrent calls of the interface may compute the same result twice.
+        template <class Policy, std::size_t Size, class R, class... Args>
+        class MemoCache
+        {
+            static_assert(Size > 0, "memoization requires a cache size greater than zero");
+
+            using Key = std::tuple<std::decay_t<Args>...>;
+
+            struct Entry
+            {
+                std::size_t hash;
+                Key arguments;
+                R result;
+            };
+
+        public:
+            MemoCache() = default;
+
+            MemoCache(const MemoCache& other)
+                : entries_(other.entries())
+            {}
+
+            MemoCache(MemoCache&& other) noexcept
+                : entries_(std::move(other.entries_))
+            {}
+
+            MemoCache& operator=(const MemoCache& other)
+            {
+                if(this != &other)
+                {
+                    auto entries = other.entries();
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    entries_.swap(entries);
+                }
+                return *this;
+            }
+
+            MemoCache& operator=(MemoCache&& other) noexcept
+            {
+                entries_ = std::move(other.entries_);
+                other.entries_.clear();
+                return *this;
+            }
+
+            /// Returns the cached result for args or stores and returns compute().
+            template <class Compute>
+            R get(Compute compute, const std::decay_t<Args>&... args) const
+            {
+                const auto hash = detail::hashArguments(args...);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    for(std::size_t i = 0; i < entries_.size(); ++i)
+                        if(entries_[i].hash == hash && entries_[i].arguments == std::tie(args...))
+                        {
+                            auto result = entries_[i].result;
+                            Policy::hit(entries_, i);
+                            return result;
+                        }
+                }
+
+                // compute may move the arguments to the implementation
+                Key arguments(args...);
+                auto result = compute();
+                std::lock_guard<std::mutex> lock(mutex_);
+                if(entries_.size() == Size)
+                    entries_.pop_back();
+                entries_.insert(begin(entries_), Entry{hash, std::move(arguments), result});
+                return result;
+            }
+
+            void clear() noexcept
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                entries_.clear();
+            }
+
+            std::size_t size() const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return entries_.size();
+            }
+
+        private:
+            std::vector<Entry> entries() const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return entries_;
+            }
+
+            mutable std::mutex mutex_;
+            mutable std::vector<Entry> entries_;
+        };
+    }
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "ErrorHandling.h"
+
+namespace clang
+{
+    namespace type_erasure
+    {
+        namespace detail
+        {
+            /// Avoids false sharing between the slots and between producers and consumers.
+            constexpr std::size_t cache_line_size = 64;
+        }
+
+
+        /// Bounded lock-free queue of type-erased objects, e.g. of interfaces generated with
+        /// '-custom -sbo -non-copyable'.
+        ///
+        /// The objects are constructed in their slot by the producer and used in their slot by the
+        /// consumer, thus handing over an object neither moves the interface nor allocates if
+        /// the implementation fits into the buffer of the storage. Every slot carries a sequence
+        /// number that tells producers and consumers whether it is free or occupied in the
+        /// current round. With a single producer or a single consumer, positions are claimed
+        /// without compare-and-swap.
+        template <class Erased,
+                  std::size_t capacity,
+                  bool multipleProducers = true,
+                  bool multipleConsumers = true>
+        class Queue
+        {
+            static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+            struct alignas(detail::cache_line_size) Slot
+            {
+                std::atomic<std::size_t> sequence;
+                // false if the construction of the object failed
+                bool constructed = false;
+                std::aligned_storage_t<sizeof(Erased), alignof(Erased)> object;
+
+                Erased& get() noexcept
+                {
+                    return *reinterpret_cast<Erased*>(&object);
+                }
+            };
+
+            using Position = std::atomic<std::size_t>;
+
+        public:
+            Queue() noexcept
+            {
+                for(std::size_t i = 0; i < capacity; ++i)
+                    slots_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+
+            Queue(const Queue&) = delete;
+            Queue& operator=(const Queue&) = delete;
+
+            ~Queue()
+            {
+                while(try_consume([](Erased&) {}))
+                {}
+            }
+
+            /// Constructs an object from args in the next free slot, e.g. with
+            /// try_emplace(in_place_type<Impl>, args...) for interfaces generated with '-custom'.
+            /// Returns false if the queue is full.
+            template <class... Args>
+            bool try_emplace(Args&&... args)
+            {
+                Slot* slot = nullptr;
+                std::size_t position = 0;
+                if(!claim<multipleProducers>(tail_, 0, position, slot))
+                    return false;
+
+                CLANG_TYPE_ERASE_TRY
+                {
+                    new(&slot->object) Erased(std::forward<Args>(args)...);
+                    slot->constructed = true;
+                }
+                CLANG_TYPE_ERASE_CATCH_ALL
+                {
+                    // publish the slot such that consumers can skip it
+                    slot->constructed = false;
+                    slot->sequence.store(position + 1, std::memory_order_release);
+                    CLANG_TYPE_ERASE_RETHROW;
+                }
+                slot->sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+
+            bool try_push(Erased&& value)
+            {
+                return try_emplace(std::move(value));
+            }
+
+            /// Calls f(Erased&) for the oldest object in its slot and destroys it afterwards.
+            /// Returns false if the queue is empty.
+            template <class F>
+            bool try_consume(F&& f)
+            {
+                while(true)
+                {
+                    Slot* slot = nullptr;
+                    std::size_t position = 0;
+                    if(!claim<multipleConsumers>(head_, 1, position, slot))
+                        return false;
+
+                    if(!slot->constructed)
+                    {
+                        release(*slot, position);
+                        continue;
+                    }
+
+                    struct Release
+                    {
+                        ~Release()
+                        {
+                            slot.get().~Erased();
+                            queue.release(slot, position);
+                        }
+
+                        Queue& queue;
+                        Slot& slot;
+                        std::size_t position;
+                    } guard{*this, *slot, position};
+                    f(slot->get());
+                    return true;
+                }
+            }
+
+            /// Moves the oldest object to value. Returns false if the queue is empty.
+            bool try_pop(Erased& value)
+            {
+                return try_consume([&value](Erased& object) { value = std::move(object); });
+            }
+
+            /// Approximate number of objects, for monitoring.
+            std::size_t size() const noexcept
+            {
+                const auto tail = tail_.load(std::memory_order_relaxed);
+                const auto head = head_.load(std::memory_order_relaxed);
+                return tail > head ? tail - head : 0;
+            }
+
+        private:
+            /// Claims the slot at position for producers (offset 0) or consumers (offset 1), if its
+            /// sequence number shows that it is free resp. occupied in the current round.
+            template <bool concurrent>
+            bool claim(Position& next, std::size_t offset, std::size_t& position, Slot*& slot) noexcept
+            {
+                position = next.load(std::memory_order_relaxed);
+                while(true)
+                {
+                    slot = &slots_[position & (capacity - 1)];
+                    const auto sequence = slot->sequence.load(std::memory_order_acquire);
+                    const auto difference = static_cast<std::ptrdiff_t>(sequence) -
+                                            static_cast<std::ptrdiff_t>(position + offset);
+                    if(difference < 0)
+                        return false;
+                    if(difference > 0)
+                    {
+                        position = next.load(std::memory_order_relaxed);
+                        continue;
+                    }
+                    if(!concurrent)
+                    {
+                        next.store(position + 1, std::memory_order_relaxed);
+                        return true;
+                    }
+                    if(next.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                        return true;
+                }
+            }
+
+            /// Frees the slot for the producers of the next round.
+            void release(Slot& slot, std::size_t position) noexcept
+            {
+                slot.sequence.store(position + capacity, std::memory_order_release);
+            }
+
+            Slot slots_[capacity];
+            alignas(detail::cache_line_size) Position tail_{0};
+            alignas(detail::cache_line_size) Position head_{0};
+        };
+    }
+}
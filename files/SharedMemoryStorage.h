@@ -0,0 +1,473 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "Storage.h"
+
+namespace clang
+{
+    namespace type_erasure
+    {
+        /// Name of T that is the same in all processes that share objects of type T. Specialize
+        /// for compilers without __PRETTY_FUNCTION__ or if the processes are built differently.
+        template <class T>
+        struct SharedTypeName
+        {
+            static const char* name() noexcept
+            {
+#if defined(__GNUC__) || defined(__clang__)
+                return __PRETTY_FUNCTION__;
+#else
+                static_assert(sizeof(T) == 0, "specialize SharedTypeName for types in shared memory storages");
+                return nullptr;
+#endif
+            }
+        };
+
+
+        /// Allocator for a memory region that is mapped into several processes, possibly at
+        /// different addresses. All bookkeeping is stored in the region, the blocks are
+        /// identified by their offsets.
+        class SharedArena
+        {
+            static constexpr std::uint64_t magic = 0x61726e6541455443;
+            static constexpr std::size_t sizeClasses = 40;
+            static constexpr std::uint64_t minBlock = 16;
+
+            struct Header
+            {
+                std::uint64_t magic;
+                std::uint64_t size;
+                std::atomic<std::uint32_t> lock;
+                std::uint64_t top;
+                // offsets of the first free block per size class, 0 if empty
+                std::uint64_t free[sizeClasses];
+            };
+
+            static_assert(ATOMIC_INT_LOCK_FREE == 2, "locks in shared memory must be lock-free");
+
+            // size class of the block, stored in front of the payload
+            struct BlockHeader
+            {
+                std::uint64_t sizeClass;
+                std::uint64_t padding;
+            };
+
+        public:
+            constexpr SharedArena() noexcept = default;
+
+            /// Initializes an arena in region, which must be aligned to 16 bytes.
+            static SharedArena create(void* region, std::size_t size)
+            {
+                assert(reinterpret_cast<std::uintptr_t>(region) % minBlock == 0);
+                if(size < sizeof(Header) + minBlock)
+                    detail::fail<std::length_error>("region too small for a shared arena");
+                const auto header = new (region) Header();
+                header->size = size;
+                header->top = (sizeof(Header) + minBlock - 1) / minBlock * minBlock;
+                header->lock.store(0, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                header->magic = magic;
+                return SharedArena(static_cast<char*>(region));
+            }
+
+            /// Attaches to an arena that has been created in another mapping of region.
+            static SharedArena attach(void* region)
+            {
+                const auto arena = SharedArena(static_cast<char*>(region));
+                if(arena.header().magic != magic)
+                    detail::fail<std::invalid_argument>("no shared arena in region");
+                return arena;
+            }
+
+            /// Offset of a new block of at least size bytes, aligned to 16 bytes.
+            std::uint64_t allocate(std::size_t size)
+            {
+                std::uint64_t sizeClass = 0;
+                while((minBlock << sizeClass) < size + sizeof(BlockHeader))
+                    if(++sizeClass == sizeClasses)
+                        detail::failAllocation();
+
+                auto& header = this->header();
+                Lock lock(header);
+                auto block = header.free[sizeClass];
+                if(block)
+                    header.free[sizeClass] = *static_cast<std::uint64_t*>(data(block));
+                else
+                {
+                    const auto blockSize = minBlock << sizeClass;
+                    if(header.top + blockSize > header.size)
+                        detail::failAllocation();
+                    block = header.top + sizeof(BlockHeader);
+                    header.top += blockSize;
+                }
+                static_cast<BlockHeader*>(data(block - sizeof(BlockHeader)))->sizeClass = sizeClass;
+                return block;
+            }
+
+            void deallocate(std::uint64_t block) noexcept
+            {
+                assert(block);
+                auto& header = this->header();
+                const auto sizeClass = static_cast<BlockHeader*>(data(block - sizeof(BlockHeader)))->sizeClass;
+                Lock lock(header);
+                *static_cast<std::uint64_t*>(data(block)) = header.free[sizeClass];
+                header.free[sizeClass] = block;
+            }
+
+            void* data(std::uint64_t offset) const noexcept
+            {
+                assert(base);
+                return base + offset;
+            }
+
+            explicit operator bool() const noexcept
+            {
+                return base != nullptr;
+            }
+
+        private:
+            // spin lock, which can be shared between processes
+            class Lock
+            {
+            public:
+                explicit Lock(Header& header) noexcept
+                    : header(header)
+                {
+                    while(header.lock.exchange(1, std::memory_order_acquire))
+                        std::this_thread::yield();
+                }
+
+                ~Lock()
+                {
+                    header.lock.store(0, std::memory_order_release);
+                }
+
+            private:
+                Header& header;
+            };
+
+            explicit SharedArena(char* base) noexcept
+                : base(base)
+            {}
+
+            Header& header() const noexcept
+            {
+                assert(base);
+                return *reinterpret_cast<Header*>(base);
+            }
+
+            char* base = nullptr;
+        };
+
+
+        namespace detail
+        {
+            template <class T>
+            std::uint64_t sharedTypeId() noexcept
+            {
+                static const std::uint64_t id = []
+                {
+                    // FNV-1a
+                    std::uint64_t hash = 0xcbf29ce484222325;
+                    for(auto name = SharedTypeName<T>::name(); *name; ++name)
+                        hash = (hash ^ static_cast<unsigned char>(*name)) * 0x100000001b3;
+                    // 0 identifies empty storages
+                    return hash ? hash : 1;
+                }();
+                return id;
+            }
+
+            /// Per-process part of a shared memory storage, see SharedDescriptor.
+            struct SharedDescriptorBase
+            {
+                const ObjectTable* object;
+            };
+
+            template <class Functions>
+            struct SharedDescriptor : SharedDescriptorBase
+            {
+                SharedDescriptor(const ObjectTable* object, const Functions& functions) noexcept
+                    : SharedDescriptorBase{object},
+                      functions(functions)
+                {}
+
+                Functions functions;
+            };
+
+            /// Per-process arena and descriptors of the shared memory storages with Tag. The
+            /// descriptors are found by the stable ids of the types, with linear probing.
+            template <class Tag>
+            struct SharedRegistry
+            {
+                static constexpr std::size_t capacity = 256;
+
+                static void add(std::uint64_t id, const SharedDescriptorBase* descriptor)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    for(std::size_t i = 0; i < capacity; ++i)
+                    {
+                        auto& entry = entries[(id + i) % capacity];
+                        const auto key = entry.id.load(std::memory_order_relaxed);
+                        if(key == id)
+                        {
+                            if(entry.descriptor.load(std::memory_order_relaxed)->object != descriptor->object)
+                                fail<std::logic_error>("types in shared memory storages with the same id");
+                            return;
+                        }
+                        if(key == 0)
+                        {
+                            entry.descriptor.store(descriptor, std::memory_order_relaxed);
+                            entry.id.store(id, std::memory_order_release);
+                            return;
+                        }
+                    }
+                    fail<std::length_error>("too many types in shared memory storages");
+                }
+
+                static const SharedDescriptorBase* find(std::uint64_t id) noexcept
+                {
+                    for(std::size_t i = 0; i < capacity; ++i)
+                    {
+                        const auto& entry = entries[(id + i) % capacity];
+                        const auto key = entry.id.load(std::memory_order_acquire);
+                        if(key == id)
+                            return entry.descriptor.load(std::memory_order_relaxed);
+                        if(key == 0)
+                            break;
+                    }
+                    return nullptr;
+                }
+
+                struct Entry
+                {
+                    std::atomic<std::uint64_t> id{0};
+                    std::atomic<const SharedDescriptorBase*> descriptor{nullptr};
+                };
+
+                static Entry entries[capacity];
+                static std::mutex mutex;
+                static SharedArena arena;
+            };
+
+            template <class Tag>
+            typename SharedRegistry<Tag>::Entry SharedRegistry<Tag>::entries[SharedRegistry<Tag>::capacity];
+
+            template <class Tag>
+            std::mutex SharedRegistry<Tag>::mutex;
+
+            template <class Tag>
+            SharedArena SharedRegistry<Tag>::arena;
+        }
+
+
+        /// Sets the arena of the shared memory storages with Tag in this process.
+        template <class Tag>
+        void useSharedArena(SharedArena arena) noexcept
+        {
+            detail::SharedRegistry<Tag>::arena = arena;
+        }
+
+
+        /// Position-independent storage for objects in memory that is shared between processes.
+        ///
+        /// The object is allocated in the arena of Tag, see useSharedArena, and identified by
+        /// its offset. Its type is identified by a hash of SharedTypeName<T>, which is resolved
+        /// through a per-process registry that also holds the function table. Thus storages may
+        /// themselves be placed in shared memory and be used by all processes that have
+        /// registered the type, see registerType. Only trivially copyable objects can be stored.
+        template <bool rttiEnabled, class Tag = void>
+        class SharedMemoryStorage : private detail::StatsRecorder<Tag>,
+                                    private detail::StorageBase
+        {
+            using Recorder = detail::StatsRecorder<Tag>;
+            using Registry = detail::SharedRegistry<Tag>;
+        public:
+            constexpr SharedMemoryStorage() noexcept = default;
+
+            /// Constructs the stored object in the arena and registers T in this process.
+            template <class T, class Functions, class... Args>
+            explicit SharedMemoryStorage(in_place_type_t<T>, const Functions& functions, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+            {
+                static_assert(std::is_trivially_copyable<T>::value && !detail::IsReferenceWrapper<T>::value,
+                              "objects in shared memory must be trivially copyable and must not refer to other objects");
+                registerType<T>(functions);
+                offset = Registry::arena.allocate(sizeof(T));
+                CLANG_TYPE_ERASE_TRY
+                {
+                    new (Registry::arena.data(offset)) T(std::forward<Args>(args)...);
+                }
+                CLANG_TYPE_ERASE_CATCH_ALL
+                {
+                    Registry::arena.deallocate(offset);
+                    CLANG_TYPE_ERASE_RETHROW;
+                }
+                id = detail::sharedTypeId<T>();
+                Recorder::template recordConstruction<T>(false);
+            }
+
+            /// Makes objects of type T that have been stored by other processes usable in this
+            /// process.
+            template <class T, class Functions>
+            static void registerType(const Functions& functions)
+            {
+                static const detail::SharedDescriptor<Functions> descriptor(detail::objectTable<T>(), functions);
+                Registry::add(detail::sharedTypeId<T>(), &descriptor);
+            }
+
+            ~SharedMemoryStorage()
+            {
+                reset();
+            }
+
+            SharedMemoryStorage(const SharedMemoryStorage& other) CLANG_TYPE_ERASE_NOTHROW
+                : Recorder(other)
+            {
+                copy(other);
+            }
+
+            SharedMemoryStorage(SharedMemoryStorage&& other) noexcept
+                : Recorder(other),
+                  id(other.id),
+                  offset(other.offset)
+            {
+                other.id = 0;
+                other.offset = 0;
+            }
+
+            SharedMemoryStorage& operator=(const SharedMemoryStorage& other) CLANG_TYPE_ERASE_NOTHROW
+            {
+                if(this != &other)
+                    *this = SharedMemoryStorage(other);
+                return *this;
+            }
+
+            SharedMemoryStorage& operator=(SharedMemoryStorage&& other) noexcept
+            {
+                if(this == &other)
+                    return *this;
+                reset();
+                Recorder::operator=(other);
+                id = other.id;
+                offset = other.offset;
+                other.id = 0;
+                other.offset = 0;
+                return *this;
+            }
+
+            /// The function table that has been registered for the type of the stored object.
+            ///
+            /// Functions must be the type of that table, which the generated interfaces
+            /// guarantee by always passing their own table.
+            template <class Functions>
+            const Functions& functions() const noexcept
+            {
+                return static_cast<const detail::SharedDescriptor<Functions>&>(descriptor()).functions;
+            }
+
+            /// Pointer to the stored object, as passed to the function table.
+            void* object() noexcept
+            {
+                return read();
+            }
+
+            /// Pointer to the stored object, as passed to the function table.
+            const void* object() const noexcept
+            {
+                return read();
+            }
+
+            explicit operator bool() const noexcept
+            {
+                return id != 0;
+            }
+
+            template <class T>
+            T& get() noexcept
+            {
+                assert(is<T>());
+                return *static_cast<T*>(read());
+            }
+
+            template <class T>
+            const T& get() const noexcept
+            {
+                assert(is<T>());
+                return *static_cast<const T*>(read());
+            }
+
+            template <class T>
+            T* target() noexcept
+            {
+                return is<T>() ? static_cast<T*>(read()) : nullptr;
+            }
+
+            template <class T>
+            const T* target() const noexcept
+            {
+                return is<T>() ? static_cast<const T*>(read()) : nullptr;
+            }
+
+            template <class T>
+            bool is() const noexcept
+            {
+                return id != 0 && id == detail::sharedTypeId< std::decay_t<T> >();
+            }
+
+            /// Identifies the type of the stored object in this process, nullptr if the storage
+            /// is empty.
+            const void* type() const noexcept
+            {
+                return id ? descriptor().object : nullptr;
+            }
+
+        private:
+            void copy(const SharedMemoryStorage& other) CLANG_TYPE_ERASE_NOTHROW
+            {
+                if(!other.id)
+                    return;
+                const auto size = other.descriptor().object->size;
+                offset = Registry::arena.allocate(size);
+                std::memcpy(Registry::arena.data(offset), other.read(), size);
+                id = other.id;
+                Recorder::recordClone();
+            }
+
+            void reset() noexcept
+            {
+                if(!id)
+                    return;
+                Recorder::recordDestruction();
+                // trivially copyable objects are trivially destructible
+                Registry::arena.deallocate(offset);
+                id = 0;
+                offset = 0;
+            }
+
+            const detail::SharedDescriptorBase& descriptor() const noexcept
+            {
+                const auto descriptor = Registry::find(id);
+                assert(descriptor && "the type of the stored object has not been registered in this process");
+                return *descriptor;
+            }
+
+            void* read() const noexcept
+            {
+                return id ? Registry::arena.data(offset) : nullptr;
+            }
+
+            std::uint64_t id = 0;
+            std::uint64_t offset = 0;
+        };
+    }
+}
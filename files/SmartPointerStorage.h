@@ -4,19 +4,25 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <functional>
 #include <memory>
 #include <type_traits>
 
-#ifdef CLANG_TYPE_ERASE_CAST
-#undef CLANG_TYPE_ERASE_CAST
-#endif
+#include "StorageStats.h"
+#include "Visit.h"
 
-#ifdef CLANG_TYPE_ERASE_NO_RTTI
-#define CLANG_TYPE_ERASE_CAST static_cast
+/// Hidden LTO visibility of the generated interfaces, such that Clang's -fwhole-program-vtables
+/// may devirtualize their calls. Define it empty if the interfaces are derived from in other
+/// shared libraries. GCC warns about classes that are more visible than their members, thus
+/// it is only used with Clang.
+#ifndef CLANG_TYPE_ERASE_HIDDEN
+#if defined(__clang__)
+#define CLANG_TYPE_ERASE_HIDDEN __attribute__((visibility("hidden")))
 #else
-#define CLANG_TYPE_ERASE_CAST dynamic_cast
+#define CLANG_TYPE_ERASE_HIDDEN
+#endif
 #endif
 
 namespace clang
@@ -31,6 +37,87 @@ namespace clang
                 return static_cast<const char*>( ptr );
             }
 
+            /// Identifies the type of the object in a wrapper, without RTTI.
+            using TypeTag = const void*;
+
+            template <class T>
+            struct TypeTagOf
+            {
+                static constexpr char tag = 0;
+            };
+
+            template <class T>
+            constexpr char TypeTagOf<T>::tag;
+
+            /// The address of a static variable per type, returned by the virtual function
+            /// type_tag() of the generated wrappers.
+            template <class T>
+            TypeTag typeTag() noexcept
+            {
+                return &TypeTagOf<T>::tag;
+            }
+
+            /// Reference count of a heap block that is shared between copy-on-write storages.
+            struct SharedCount
+            {
+                std::atomic<std::size_t> count{1};
+            };
+
+            template <class T>
+            struct SharedBlock : SharedCount
+            {
+                template <class... Args>
+                explicit SharedBlock(Args&&... args)
+                    : value(std::forward<Args>(args)...)
+                {}
+
+                T value;
+            };
+
+            inline void acquireShared(SharedCount* block) noexcept
+            {
+                if(block)
+                    block->count.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            /// Returns true if the last reference to block has been released.
+            inline bool releaseShared(SharedCount* block) noexcept
+            {
+                return block && block->count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+            }
+
+            /// The acquire load pairs with the release in releaseShared, such that all accesses
+            /// through copies that have been released on other threads happen before the
+            /// subsequent in-place modification.
+            inline bool isUniquelyShared(const SharedCount* block) noexcept
+            {
+                assert(block);
+                return block->count.load(std::memory_order_acquire) == 1;
+            }
+
+            template <class Wrapped>
+            void deleteSharedBlock(SharedCount* block) noexcept
+            {
+                assert(block);
+                delete static_cast<SharedBlock<Wrapped>*>(block);
+            }
+
+            template <class Wrapped, class Interface>
+            SharedCount* copySharedBlock(const Interface& interface, Interface*& copy)
+            {
+                auto block = new SharedBlock<Wrapped>(static_cast<const Wrapped&>(interface));
+                copy = &block->value;
+                return block;
+            }
+
+            template <class Wrapped, class Interface, class... Args>
+            SharedCount* makeSharedBlock(Interface*& interface, Args&&... args)
+            {
+                auto block = new SharedBlock<Wrapped>(std::forward<Args>(args)...);
+                interface = &block->value;
+                return block;
+            }
+
             template < class Buffer >
             bool isHeapAllocated (void* data, const Buffer& buffer) noexcept
             {
@@ -79,30 +166,42 @@ namespace clang
                     return *static_cast<const T*>(data);
                 }
 
+                /// Compares the type tags, works with and without RTTI.
                 template < class T >
                 T* target() noexcept
                 {
                     auto interface = static_cast<Storage*>(this)->getInterfacePtr();
-                    if(containsReferenceWrapper)
-                    {
-                        auto wrappedResult = CLANG_TYPE_ERASE_CAST<Wrapper<std::reference_wrapper<T>>*>(interface);
-                        return wrappedResult ? &wrappedResult->impl : nullptr;
-                    }
-                    auto wrappedResult = CLANG_TYPE_ERASE_CAST<Wrapper<T>*>(interface);
-                    return wrappedResult ? &wrappedResult->impl : nullptr;
+                    if(isStored<T>(interface))
+                        return &static_cast<Wrapper<T>*>(interface)->impl;
+                    if(isStored<std::reference_wrapper<T>>(interface))
+                        return &static_cast<T&>(static_cast<Wrapper<std::reference_wrapper<T>>*>(interface)->impl);
+                    return nullptr;
                 }
 
                 template < class T >
                 const T* target() const noexcept
                 {
                     auto interface = static_cast<const Storage*>(this)->getInterfacePtr();
-                    if(containsReferenceWrapper)
-                    {
-                        auto wrappedResult = CLANG_TYPE_ERASE_CAST<const Wrapper<std::reference_wrapper<T>>*>(interface);
-                        return wrappedResult ? &wrappedResult->impl : nullptr;
-                    }
-                    auto wrappedResult = CLANG_TYPE_ERASE_CAST<const Wrapper<T>*>(interface);
-                    return wrappedResult ? &wrappedResult->impl : nullptr;
+                    if(isStored<T>(interface))
+                        return &static_cast<const Wrapper<T>*>(interface)->impl;
+                    if(isStored<std::reference_wrapper<T>>(interface))
+                        return &static_cast<const T&>(static_cast<const Wrapper<std::reference_wrapper<T>>*>(interface)->impl);
+                    return nullptr;
+                }
+
+                /// True if target<T>() does not return nullptr.
+                template <class T>
+                bool is() const noexcept
+                {
+                    const auto interface = static_cast<const Storage*>(this)->getInterfacePtr();
+                    return isStored<T>(interface) || isStored<std::reference_wrapper<T>>(interface);
+                }
+
+                /// Identifies the type of the stored object, nullptr if the storage is empty.
+                TypeTag type() const noexcept
+                {
+                    const auto interface = static_cast<const Storage*>(this)->getInterfacePtr();
+                    return interface ? interface->type_tag() : nullptr;
                 }
 
                 explicit operator bool() const noexcept
@@ -111,13 +210,21 @@ namespace clang
                 }
 
             private:
+                template <class T>
+                static bool isStored(const Interface* interface) noexcept
+                {
+                    return interface && interface->type_tag() == typeTag<T>();
+                }
+
                 bool containsReferenceWrapper;
             };
 
             template <class Interface, template <class> class Wrapper>
-            struct Storage : Accessor<Storage<Interface,Wrapper>, Interface, Wrapper>
+            struct Storage : Accessor<Storage<Interface,Wrapper>, Interface, Wrapper>,
+                             private detail::StatsRecorder<Interface>
             {
                 using Base = Accessor<Storage, Interface, Wrapper>;
+                using Recorder = detail::StatsRecorder<Interface>;
 
                 Storage() = default;
 
@@ -127,19 +234,47 @@ namespace clang
                 explicit Storage(T&& t)
                     : Base()
                     ,interface_(std::make_unique<Wrapper<std::decay_t<T>>>(std::forward<T>(t)))
+                {
+                    Recorder::template recordConstruction< Wrapper<std::decay_t<T>> >(false);
+                }
+
+                ~Storage()
+                {
+                    reset();
+                }
+
+                Storage(Storage&& other) noexcept
+                    : Base()
+                    , Recorder(other)
+                    , interface_(std::move(other.interface_))
                 {}
 
-                Storage(Storage&&) = default;
-                Storage& operator=(Storage&&) = default;
+                Storage& operator=(Storage&& other) noexcept
+                {
+                    reset();
+                    Recorder::operator=(other);
+                    interface_ = std::move(other.interface_);
+                    return *this;
+                }
 
                 Storage(const Storage& other)
                     : Base()
+                    , Recorder(other)
                     , interface_(other.interface_ ? other.interface_->clone() : nullptr)
-                {}
+                {
+                    if(interface_)
+                        Recorder::recordClone();
+                }
 
                 Storage& operator=(const Storage& other)
                 {
+                    if(this == &other)
+                        return *this;
+                    reset();
+                    Recorder::operator=(other);
                     interface_ = other.interface_ ? other.interface_->clone() : nullptr;
+                    if(interface_)
+                        Recorder::recordClone();
                     return *this;
                 }
 
@@ -156,13 +291,29 @@ namespace clang
                     return interface_.get();
                 }
 
+                void reset() noexcept
+                {
+                    if(!interface_)
+                        return;
+                    Recorder::recordDestruction();
+                    interface_.reset();
+                }
+
                 std::unique_ptr<Interface> interface_;
             };
 
+            /// Copy-on-write storage.
+            ///
+            /// Copies share the heap-allocated object. Distinct copies may be read and modified
+            /// concurrently on different threads, the object is unshared before the first
+            /// modification. As for std::shared_ptr, concurrent access to the same storage object
+            /// requires external synchronization.
             template <class Interface, template <class> class Wrapper>
-            struct COWStorage : Accessor<COWStorage<Interface,Wrapper>, Interface, Wrapper>
+            struct COWStorage : Accessor<COWStorage<Interface,Wrapper>, Interface, Wrapper>,
+                                private detail::StatsRecorder<Interface>
             {
                 using Base = Accessor<COWStorage, Interface, Wrapper>;
+                using Recorder = detail::StatsRecorder<Interface>;
 
                 COWStorage() = default;
 
@@ -171,32 +322,111 @@ namespace clang
                           std::enable_if_t<std::is_base_of<Interface, Wrapper<T>>::value>* = nullptr>
                 explicit COWStorage(T&& t)
                     : Base()
-                    , interface_(std::make_shared<Wrapper<std::decay_t<T>>>(std::forward<T>(t)))
-                {}
+                    , del(&deleteSharedBlock<Wrapper<std::decay_t<T>>>)
+                    , copy_data(&copySharedBlock<Wrapper<std::decay_t<T>>, Interface>)
+                {
+                    block_ = makeSharedBlock<Wrapper<std::decay_t<T>>>(interface_, std::forward<T>(t));
+                    Recorder::template recordConstruction< Wrapper<std::decay_t<T>> >(false);
+                }
+
+                ~COWStorage()
+                {
+                    reset();
+                }
+
+                COWStorage(const COWStorage& other) noexcept
+                    : Base()
+                    , Recorder(other)
+                    , del(other.del)
+                    , copy_data(other.copy_data)
+                    , block_(other.block_)
+                    , interface_(other.interface_)
+                {
+                    acquireShared(block_);
+                }
+
+                COWStorage(COWStorage&& other) noexcept
+                    : Base()
+                    , Recorder(other)
+                    , del(other.del)
+                    , copy_data(other.copy_data)
+                    , block_(other.block_)
+                    , interface_(other.interface_)
+                {
+                    other.block_ = nullptr;
+                    other.interface_ = nullptr;
+                }
+
+                COWStorage& operator=(const COWStorage& other) noexcept
+                {
+                    acquireShared(other.block_);
+                    reset();
+                    Recorder::operator=(other);
+                    del = other.del;
+                    copy_data = other.copy_data;
+                    block_ = other.block_;
+                    interface_ = other.interface_;
+                    return *this;
+                }
+
+                COWStorage& operator=(COWStorage&& other) noexcept
+                {
+                    reset();
+                    Recorder::operator=(other);
+                    del = other.del;
+                    copy_data = other.copy_data;
+                    block_ = other.block_;
+                    interface_ = other.interface_;
+                    other.block_ = nullptr;
+                    other.interface_ = nullptr;
+                    return *this;
+                }
 
             private:
                 friend class Accessor<COWStorage, Interface, Wrapper>;
 
                 Interface* getInterfacePtr()
                 {
-                    if(!interface_.unique())
-                        interface_ = interface_->clone();
-                    return interface_.get();
+                    if(block_ && !isUniquelyShared(block_))
+                    {
+                        Interface* copy = nullptr;
+                        const auto copied_block = copy_data(*interface_, copy);
+                        reset();
+                        block_ = copied_block;
+                        interface_ = copy;
+                        Recorder::recordUnshare();
+                    }
+                    return interface_;
                 }
 
                 const Interface* getInterfacePtr() const
                 {
-                    return interface_.get();
+                    return interface_;
                 }
 
-                std::shared_ptr<Interface> interface_;
+                void reset() noexcept
+                {
+                    if(!releaseShared(block_))
+                        return;
+                    Recorder::recordDestruction();
+                    del(block_);
+                }
+
+                using delete_fn = void(*)(SharedCount*);
+                using copy_fn = SharedCount*(*)(const Interface&, Interface*&);
+                delete_fn del = nullptr;
+                copy_fn copy_data = nullptr;
+                SharedCount* block_ = nullptr;
+                Interface* interface_ = nullptr;
             };
 
 
             template <class Interface, template <class> class Wrapper, int Size>
-            struct SBOStorage : Accessor<SBOStorage<Interface,Wrapper,Size>, Interface, Wrapper>
+            struct SBOStorage : Accessor<SBOStorage<Interface,Wrapper,Size>, Interface, Wrapper>,
+                                private detail::StatsRecorder<Interface>
             {
                 using Base = Accessor<SBOStorage, Interface, Wrapper>;
+                using Recorder = detail::StatsRecorder<Interface>;
 
                 SBOStorage() = default;
 
@@ -213,6 +443,7 @@ namespace clang
                     : Base()
                     , interface_(std::make_shared<Wrapper<std::decay_t<T>>>(std::forward<T>(t)))
                 {
+                    Recorder::template recordConstruction< Wrapper<std::decay_t<T>> >(false);
                 }
 
                 template <class T,
@@ -222,56 +453,55 @@ namespace clang
                 explicit SBOStorage(T&& t)
                     : Base()
                 {
-                    new(&buffer_) Wrapper<std::decay_t<T>>(std::forward<T>(t));
-                    interface_ = makeAlias();
+                    interface_ = makeAlias(new(&buffer_) Wrapper<std::decay_t<T>>(std::forward<T>(t)));
+                    Recorder::template recordConstruction< Wrapper<std::decay_t<T>> >(true);
                 }
 
                 SBOStorage(const SBOStorage& other)
                     : Base()
+                    , Recorder(other)
                 {
                     if(!other.interface_)
                         return;
                     if(isHeapAllocated(other.interface_.get(), other.buffer_)) {
                         interface_ = other.interface_->clone();
                     } else {
-                        buffer_ = other.buffer_;
-                        interface_ = makeAlias();
+                        interface_ = makeAlias(other.interface_->clone_into(&buffer_));
                     }
+                    Recorder::recordClone();
                 }
 
                 SBOStorage& operator=(const SBOStorage& other)
                 {
+                    if(this == &other)
+                        return *this;
                     reset();
+                    Recorder::operator=(other);
                     if(isHeapAllocated(other.interface_.get(), other.buffer_)) {
                         interface_ = other.interface_ ? other.interface_->clone() : nullptr;
                     } else {
-                        buffer_ = other.buffer_;
-                        interface_ = makeAlias();
+                        interface_ = nullptr;
+                        interface_ = makeAlias(other.interface_->clone_into(&buffer_));
                     }
+                    if(interface_)
+                        Recorder::recordClone();
                     return *this;
                 }
 
                 SBOStorage(SBOStorage&& other)
+                    : Recorder(other)
                 {
-                    if(isHeapAllocated(other.interface_.get(), other.buffer_)) {
-                        interface_ = std::move(other.interface_);
-                    } else {
-                        buffer_ = other.buffer_;
-                        interface_ = makeAlias();
-                    }
-                    other.interface_ = nullptr;
+                    move(std::move(other));
                 }
 
                 SBOStorage& operator=(SBOStorage&& other)
                 {
+                    if(this == &other)
+                        return *this;
                     reset();
-                    if(isHeapAllocated(other.interface_.get(), other.buffer_)) {
-                        interface_ = std::move(other.interface_);
-                    } else {
-                        buffer_ = other.buffer_;
-                        interface_ = makeAlias();
-                    }
-                    other.interface_ = nullptr;
+                    Recorder::operator=(other);
+                    interface_ = nullptr;
+                    move(std::move(other));
                     return *this;
                 }
 
@@ -290,25 +520,46 @@ namespace clang
 
                 void reset()
                 {
+                    if(interface_)
+                        Recorder::recordDestruction();
                     if(!isHeapAllocated(interface_.get(), buffer_))
                         interface_->~Interface();
                 }
 
-                std::shared_ptr<Interface> makeAlias()
+                /// Objects in the buffer are moved with move_into and destroyed in other,
+                /// such that moves never allocate.
+                void move(SBOStorage&& other)
                 {
-                    const auto tmp = static_cast<Interface*>(static_cast<void*>(&buffer_[0]));
-                    return std::shared_ptr<Interface>(std::shared_ptr<Interface>(), tmp);
+                    if(isHeapAllocated(other.interface_.get(), other.buffer_)) {
+                        interface_ = std::move(other.interface_);
+                    } else {
+                        interface_ = makeAlias(other.interface_->move_into(&buffer_));
+                        other.interface_->~Interface();
+                    }
+                    other.interface_ = nullptr;
                 }
 
-                std::array<char,Size> buffer_;
+                /// Non-owning pointer to the object in the buffer, as returned by placement new.
+                static std::shared_ptr<Interface> makeAlias(Interface* interface) noexcept
+                {
+                    return std::shared_ptr<Interface>(std::shared_ptr<Interface>(), interface);
+                }
+
+                std::aligned_storage_t<Size> buffer_;
                 std::shared_ptr<Interface> interface_ = nullptr;
             };
 
 
+            /// Copy-on-write storage with small buffer optimization.
+            ///
+            /// Objects that fit into the buffer are copied eagerly, larger objects are shared.
+            /// The thread-safety guarantees are the same as for COWStorage.
             template <class Interface, template <class> class Wrapper, int Size>
-            struct SBOCOWStorage : Accessor<SBOCOWStorage<Interface,Wrapper,Size>, Interface, Wrapper>
+            struct SBOCOWStorage : Accessor<SBOCOWStorage<Interface,Wrapper,Size>, Interface, Wrapper>,
+                                   private detail::StatsRecorder<Interface>
             {
                 using Base = Accessor<SBOCOWStorage, Interface, Wrapper>;
+                using Recorder = detail::StatsRecorder<Interface>;
 
                 SBOCOWStorage() = default;
 
@@ -323,8 +574,11 @@ namespace clang
                           std::enable_if_t<std::greater<>()(sizeof(Wrapper<std::decay_t<T>>), Size)>* = nullptr>
                 explicit SBOCOWStorage(T&& t)
                     : Base()
-                    , interface_(std::make_shared<Wrapper<std::decay_t<T>>>(std::forward<T>(t)))
+                    , del(&deleteSharedBlock<Wrapper<std::decay_t<T>>>)
+                    , copy_data(&copySharedBlock<Wrapper<std::decay_t<T>>, Interface>)
                 {
+                    block_ = makeSharedBlock<Wrapper<std::decay_t<T>>>(interface_, std::forward<T>(t));
+                    Recorder::template recordConstruction< Wrapper<std::decay_t<T>> >(false);
                 }
 
                 template <class T,
@@ -334,55 +588,35 @@ namespace clang
                 explicit SBOCOWStorage(T&& t)
                     : Base()
                 {
-                    new(&buffer_) Wrapper<std::decay_t<T>>(std::forward<T>(t));
-                    interface_ = makeAlias();
+                    interface_ = new(&buffer_) Wrapper<std::decay_t<T>>(std::forward<T>(t));
+                    Recorder::template recordConstruction< Wrapper<std::decay_t<T>> >(true);
                 }
 
                 SBOCOWStorage(const SBOCOWStorage& other)
                     : Base()
                 {
-                    if(isHeapAllocated(other.interface_.get(), other.buffer_)) {
-                        interface_ = other.interface_;
-                    } else {
-                        buffer_ = other.buffer_;
-                        interface_ = makeAlias();
-                    }
+                    copy(other);
                 }
 
                 SBOCOWStorage& operator=(const SBOCOWStorage& other)
                 {
+                    if(this == &other)
+                        return *this;
                     reset();
-                    if(isHeapAllocated(other.interface_.get(), other.buffer_)) {
-                        interface_ = other.interface_;
-                    } else {
-                        buffer_ = other.buffer_;
-                        interface_ = makeAlias();
-                    }
+                    copy(other);
                     return *this;
                 }
 
                 SBOCOWStorage(SBOCOWStorage&& other)
                     : Base()
                 {
-                    if(isHeapAllocated(other.interface_.get(), other.buffer_)) {
-                        interface_ = std::move(other.interface_);
-                    } else {
-                        buffer_ = other.buffer_;
-                        interface_ = makeAlias();
-                    }
-                    other.interface_ = nullptr;
+                    move(std::move(other));
                 }
 
                 SBOCOWStorage& operator=(SBOCOWStorage&& other)
                 {
                     reset();
-                    if(isHeapAllocated(other.interface_.get(), other.buffer_)) {
-                        interface_ = std::move(other.interface_);
-                    } else {
-                        buffer_ = other.buffer_;
-                        interface_ = makeAlias();
-                    }
-                    other.interface_ = nullptr;
+                    move(std::move(other));
                     return *this;
                 }
 
@@ -391,33 +625,89 @@ namespace clang
 
                 Interface* getInterfacePtr()
                 {
-                    if(isHeapAllocated(interface_.get(), buffer_) && !interface_.unique())
-                        interface_ = interface_->clone();
-                    return interface_.get();
+                    if(block_ && !isUniquelyShared(block_))
+                    {
+                        Interface* copy = nullptr;
+                        const auto copied_block = copy_data(*interface_, copy);
+                        reset();
+                        block_ = copied_block;
+                        interface_ = copy;
+                        Recorder::recordUnshare();
+                    }
+                    return interface_;
                 }
 
                 const Interface* getInterfacePtr() const
                 {
-                    return interface_.get();
+                    return interface_;
                 }
 
                 void reset()
                 {
-                    if(!isHeapAllocated(interface_.get(), buffer_))
+                    if(!interface_)
+                        return;
+                    if(block_)
+                    {
+                        if(releaseShared(block_))
+                        {
+                            Recorder::recordDestruction();
+                            del(block_);
+                        }
+                    }
+                    else
+                    {
+                        Recorder::recordDestruction();
                         interface_->~Interface();
+                    }
+                    block_ = nullptr;
+                    interface_ = nullptr;
                 }
 
-                std::shared_ptr<Interface> makeAlias()
+                void copy(const SBOCOWStorage& other)
                 {
-                    const auto tmp = static_cast<Interface*>(static_cast<void*>(&buffer_[0]));
-                    return std::shared_ptr<Interface>(std::shared_ptr<Interface>(), tmp);
+                    Recorder::operator=(other);
+                    del = other.del;
+                    copy_data = other.copy_data;
+                    if(other.block_)
+                    {
+                        acquireShared(other.block_);
+                        block_ = other.block_;
+                        interface_ = other.interface_;
+                    }
+                    else if(other.interface_)
+                    {
+                        interface_ = other.interface_->clone_into(&buffer_);
+                        Recorder::recordClone();
+                    }
                 }
 
-                std::array<char,Size> buffer_;
-                std::shared_ptr<Interface> interface_ = nullptr;
+                void move(SBOCOWStorage&& other)
+                {
+                    Recorder::operator=(other);
+                    del = other.del;
+                    copy_data = other.copy_data;
+                    if(other.block_)
+                    {
+                        block_ = other.block_;
+                        interface_ = other.interface_;
+                    }
+                    else if(other.interface_)
+                    {
+                        interface_ = other.interface_->move_into(&buffer_);
+                        other.interface_->~Interface();
+                    }
+                    other.block_ = nullptr;
+                    other.interface_ = nullptr;
+                }
+
+                using delete_fn = void(*)(SharedCount*);
+                using copy_fn = SharedCount*(*)(const Interface&, Interface*&);
+                delete_fn del = nullptr;
+                copy_fn copy_data = nullptr;
+                std::aligned_storage_t<Size> buffer_;
+                SharedCount* block_ = nullptr;
+                Interface* interface_ = nullptr;
             };
         }
     }
 }
-
-#undef CLANG_TYPE_ERASE_CAST
@@ -1,22 +1,76 @@
 #pragma once
 
-#include <array>
+#include <atomic>
 #include <cassert>
 #include <functional>
 #include <memory>
 #include <type_traits>
 
+#include "ErrorHandling.h"
+#include "StorageStats.h"
+#include "Visit.h"
+
 namespace clang
 {
     namespace type_erasure
     {
+        /// Selects the constructors of the storages that construct the stored object of type T
+        /// from the remaining arguments.
+        template <class T>
+        struct in_place_type_t
+        {
+            explicit in_place_type_t() = default;
+        };
+
+        template <class T>
+        constexpr in_place_type_t<T> in_place_type{};
+
         namespace detail
         {
+            /// Reference count of a heap block. Only copy-on-write storages share blocks, all
+            /// other storages hold the only reference.
+            struct SharedCount
+            {
+                std::atomic<std::size_t> count{1};
+            };
+
             template <class T>
-            void deleteData(void* data) noexcept
+            struct SharedBlock : SharedCount
             {
-                assert(data);
-                delete static_cast<T*>(data);
+                template <class... Args>
+                explicit SharedBlock(Args&&... args)
+                    : value(std::forward<Args>(args)...)
+                {}
+
+                T value;
+            };
+
+            inline void acquireShared(SharedCount* block) noexcept
+            {
+                if(block)
+                    block->count.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            /// Returns true if the last reference to block has been released.
+            inline bool releaseShared(SharedCount* block) noexcept
+            {
+                return block && block->count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+            }
+
+            /// The acquire load pairs with the release in releaseShared, such that all accesses
+            /// through copies that have been released on other threads happen before the
+            /// subsequent in-place modification.
+            inline bool isUniquelyShared(const SharedCount* block) noexcept
+            {
+                assert(block);
+                return block->count.load(std::memory_order_acquire) == 1;
+            }
+
+            template <class T>
+            void deleteSharedBlock(SharedCount* block) noexcept
+            {
+                assert(block);
+                delete static_cast<SharedBlock<T>*>(block);
             }
 
             template <class T>
@@ -27,49 +81,290 @@ namespace clang
             }
 
             template <class T>
-            void* copyData(void* data)
+            SharedCount* copySharedBlock(const void* data, void*& copy) CLANG_TYPE_ERASE_NOTHROW
             {
-                return data ? new T( *static_cast<T*>(data) ) : nullptr;
+                assert(data);
+                auto block = allocateObject<SharedBlock<T>>(*static_cast<const T*>(data));
+                copy = &block->value;
+                return block;
             }
 
             template <class T>
-            std::shared_ptr<void> copyData(const std::shared_ptr<void>& data)
+            void* copyIntoBuffer(const void* data, void* buffer) CLANG_TYPE_ERASE_NOTHROW
+            {
+                assert(data);
+                return new (buffer) T( *static_cast<const T*>( data ) );
+            }
+
+            template <class T, class... Args>
+            SharedCount* makeSharedBlock(void*& data, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
             {
-                return data ? std::make_shared<T>(*static_cast<T*>(data.get())) : nullptr;
+                auto block = allocateObject<SharedBlock<T>>(std::forward<Args>(args)...);
+                data = &block->value;
+                return block;
             }
 
-            template< class T, class Buffer >
-            void* copyIntoBuffer( void* data, Buffer& buffer ) noexcept( std::is_nothrow_copy_constructible<T>::value )
+            /// Moves the object at data to a new heap block and destroys it.
+            template <class T>
+            SharedCount* moveSharedBlock(void* data, void*& moved) CLANG_TYPE_ERASE_NOTHROW
             {
                 assert(data);
-                new (&buffer) T( *static_cast<T*>( data ) );
-                return &buffer;
+                auto block = makeSharedBlock<T>(moved, std::move(*static_cast<T*>(data)));
+                static_cast<T*>(data)->~T();
+                return block;
             }
 
-            template< class T, class Buffer >
-            std::shared_ptr<void> copyIntoBuffer(const std::shared_ptr<void>& data, Buffer& buffer) noexcept( std::is_nothrow_copy_constructible<T>::value )
+            /// Moves the object at data into buffer and destroys it.
+            template <class T>
+            void* moveIntoBuffer(void* data, void* buffer) noexcept
             {
                 assert(data);
-                new (&buffer) T( *static_cast<T*>( data.get() ) );
-                return std::shared_ptr<T>( std::shared_ptr<T>(), static_cast<T*>( static_cast<void*>( &buffer ) ) );
+                const auto moved = new (buffer) T( std::move(*static_cast<T*>( data )) );
+                static_cast<T*>(data)->~T();
+                return moved;
             }
 
-            inline const char* charPtr( const void* ptr ) noexcept
+            /// Type-specific operations of the stored objects.
+            ///
+            /// There is one table per type that is shared by all storages, such that objects can
+            /// be handed over between storages with different storage policies.
+            struct ObjectTable
             {
-                assert(ptr);
-                return static_cast<const char*>( ptr );
+                using delete_fn = void(*)(SharedCount*);
+                using destruct_fn = void(*)(void*);
+                using copy_fn = SharedCount*(*)(const void*, void*&) CLANG_TYPE_ERASE_NOTHROW_FUNCTION;
+                using buffer_copy_fn = void*(*)(const void*, void*) CLANG_TYPE_ERASE_NOTHROW_FUNCTION;
+                using move_fn = SharedCount*(*)(void*, void*&) CLANG_TYPE_ERASE_NOTHROW_FUNCTION;
+                using buffer_move_fn = void*(*)(void*, void*) CLANG_TYPE_ERASE_NOTHROW_FUNCTION;
+
+                delete_fn del;
+                destruct_fn destruct;
+                // nullptr for non-copyable types
+                copy_fn copy;
+                buffer_copy_fn copy_into;
+                move_fn move;
+                // nullptr for types whose move constructor may throw, which are not buffered
+                buffer_move_fn move_into;
+                std::size_t size;
+                std::size_t alignment;
+            };
+
+            template <class T>
+            constexpr ObjectTable::buffer_move_fn bufferMove() noexcept
+            {
+                return std::is_nothrow_move_constructible<T>::value ? &moveIntoBuffer<T> : nullptr;
             }
 
-            template < class Buffer >
-            bool isHeapAllocated (void* data, const Buffer& buffer) noexcept
+            template <class T,
+                      std::enable_if_t<std::is_copy_constructible<T>::value>* = nullptr>
+            constexpr ObjectTable makeObjectTable() noexcept
             {
-                // treat nullptr as heap-allocated
-                if(!data)
-                    return true;
-                return data < static_cast<const void*>(&buffer) ||
-                        static_cast<const void*>( charPtr(&buffer) + sizeof(buffer) ) <= data;
+                return { &deleteSharedBlock<T>, &destructData<T>, &copySharedBlock<T>, &copyIntoBuffer<T>,
+                         &moveSharedBlock<T>, bufferMove<T>(), sizeof(T), alignof(T) };
+            }
+
+            template <class T,
+                      std::enable_if_t<!std::is_copy_constructible<T>::value>* = nullptr>
+            constexpr ObjectTable makeObjectTable() noexcept
+            {
+                return { &deleteSharedBlock<T>, &destructData<T>, nullptr, nullptr,
+                         &moveSharedBlock<T>, bufferMove<T>(), sizeof(T), alignof(T) };
             }
 
+            template <class T>
+            const ObjectTable* objectTable() noexcept
+            {
+                static constexpr ObjectTable table = makeObjectTable<T>();
+                return &table;
+            }
+
+            inline void deleteNothing(SharedCount*) noexcept
+            {}
+
+            inline void destructNothing(void*) noexcept
+            {}
+
+            inline SharedCount* copyNothing(const void*, void*& copy) noexcept
+            {
+                copy = nullptr;
+                return nullptr;
+            }
+
+            inline void* copyNothingIntoBuffer(const void*, void*) noexcept
+            {
+                return nullptr;
+            }
+
+            inline SharedCount* moveNothing(void*, void*& moved) noexcept
+            {
+                moved = nullptr;
+                return nullptr;
+            }
+
+            inline void* moveNothingIntoBuffer(void*, void*) noexcept
+            {
+                return nullptr;
+            }
+
+            /// Table of empty storages, whose operations do nothing and leave the target storage
+            /// empty. Empty storages refer to this table instead of nullptr, such that their
+            /// lifecycle operations do not need to check for emptiness.
+            template <class = void>
+            struct EmptyObjectTable
+            {
+                static constexpr ObjectTable table = { &deleteNothing, &destructNothing, &copyNothing,
+                                                       &copyNothingIntoBuffer, &moveNothing,
+                                                       &moveNothingIntoBuffer, 0, 1 };
+            };
+
+            template <class T>
+            constexpr ObjectTable EmptyObjectTable<T>::table;
+
+            constexpr const ObjectTable* emptyObjectTable() noexcept
+            {
+                return &EmptyObjectTable<>::table;
+            }
+
+            /// Buffer of the small buffer storages, see '-inline-only'.
+            template <int buffer_size>
+            using SmallBuffer = std::aligned_storage_t<buffer_size>;
+
+            /// Buffered objects are relocated in the noexcept moves of the storages, types whose move
+            /// constructor may throw are stored on the heap.
+            template <class T, class Buffer>
+            struct FitsIntoBuffer
+                : std::integral_constant<bool, sizeof(T) <= sizeof(Buffer) && alignof(Buffer) % alignof(T) == 0 &&
+                                               std::is_nothrow_move_constructible<T>::value>
+            {};
+
+            /// Constructs an object of type T in the buffer.
+            template <class T, class Buffer, class... Args>
+            void* construct(std::true_type, Buffer& buffer, SharedCount*&, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+            {
+                return new(&buffer) T(std::forward<Args>(args)...);
+            }
+
+            /// Constructs an object of type T on the heap, as it does not fit into the buffer.
+            template <class T, class Buffer, class... Args>
+            void* construct(std::false_type, Buffer&, SharedCount*& block, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+            {
+                void* data = nullptr;
+                block = makeSharedBlock<T>(data, std::forward<Args>(args)...);
+                return data;
+            }
+
+            template <class Buffer>
+            bool fitsIntoBuffer(const ObjectTable& table) noexcept
+            {
+                return table.move_into && table.size <= sizeof(Buffer) && alignof(Buffer) % table.alignment == 0;
+            }
+
+            /// Object that is handed over from one storage to another.
+            ///
+            /// Objects on the heap are handed over with their block. Objects in the buffer of the
+            /// releasing storage must be relocated before the releasing storage is modified or
+            /// destroyed.
+            struct Payload
+            {
+                const ObjectTable* table = nullptr;
+                SharedCount* block = nullptr;
+                void* data = nullptr;
+            };
+
+            /// Deletes the heap block that has been released by the last storage that referred to
+            /// it. Specialized in DeferredDestruction.h to move the deletion to a background thread.
+            template <class Tag>
+            struct Reclamation
+            {
+                static void del(const ObjectTable& table, SharedCount* block) noexcept
+                {
+                    table.del(block);
+                }
+            };
+
+            /// Moves an object from the buffer of the releasing storage to the heap.
+            inline void moveToHeap(Payload& payload) CLANG_TYPE_ERASE_NOTHROW
+            {
+                if(!payload.data || payload.block)
+                    return;
+                CLANG_TYPE_ERASE_TRY
+                {
+                    payload.block = payload.table->move(payload.data, payload.data);
+                }
+                CLANG_TYPE_ERASE_CATCH_ALL
+                {
+                    payload.table->destruct(payload.data);
+                    CLANG_TYPE_ERASE_RETHROW;
+                }
+            }
+
+            /// Copies an object that is shared with copy-on-write storages. Returns true if a copy
+            /// has been created.
+            inline bool unshare(Payload& payload) CLANG_TYPE_ERASE_NOTHROW
+            {
+                if(!payload.block || isUniquelyShared(payload.block))
+                    return false;
+                void* copy = nullptr;
+                const auto block = payload.table->copy(payload.data, copy);
+                if(detail::releaseShared(payload.block))
+                {
+                    // all other copies have been released in the meantime
+                    payload.table->del(block);
+                    payload.block->count.store(1, std::memory_order_relaxed);
+                    return false;
+                }
+                payload.block = block;
+                payload.data = copy;
+                return true;
+            }
+
+            /// Identifies storages of objects of type-erased interfaces.
+            struct StorageBase
+            {};
+
+            /// Storages of the same kind can hand over their objects to each other.
+            template <bool rttiEnabled, class Tag, bool copyable>
+            struct StorageKind : StorageBase
+            {};
+
+            template <class T>
+            using IsStorage = std::is_base_of<StorageBase, T>;
+
+            template <class T>
+            struct IsInPlaceType : std::false_type
+            {};
+
+            template <class T>
+            struct IsInPlaceType< in_place_type_t<T> > : std::true_type
+            {};
+
+            /// Arguments of the value constructors of the storages.
+            template <class T>
+            using IsValue = std::integral_constant<bool, !IsStorage<T>::value && !IsInPlaceType<T>::value>;
+
+            /// Storages that are copyable can only take over objects from copyable storages.
+            template <class Other, bool rttiEnabled, class Tag, bool copyable>
+            using CanAdopt = std::integral_constant<bool,
+                                 !std::is_reference<Other>::value && !std::is_const<Other>::value &&
+                                 ( std::is_base_of<StorageKind<rttiEnabled, Tag, true>, Other>::value ||
+                                   ( !copyable && std::is_base_of<StorageKind<rttiEnabled, Tag, false>, Other>::value ) )>;
+
+            /// Access to the object of another storage for converting moves.
+            struct Transfer
+            {
+                template <class Storage>
+                static Payload release(Storage& storage) noexcept
+                {
+                    return storage.release();
+                }
+
+                template <class Storage>
+                static const typename Storage::Recorder& recorder(const Storage& storage) noexcept
+                {
+                    return storage;
+                }
+            };
+
             template <class T>
             struct IsReferenceWrapper : std::false_type
             {};
@@ -96,69 +391,65 @@ namespace clang
         }
 
 
+        /// Type queries compare the object table of the stored object with the table of the
+        /// requested type, thus neither require RTTI nor hashing.
         template <class Derived, bool rttiEnabled>
         class Casts
         {
         public:
-            constexpr Casts(std::size_t typeId = 0) noexcept
-                : id(typeId)
+            constexpr Casts() noexcept = default;
+
+            template <class Other>
+            explicit constexpr Casts(const Casts<Other, rttiEnabled>&) noexcept
             {}
 
+            /// Pointer to the stored object if it is of type T or refers to an object of type T,
+            /// else nullptr.
             template < class T >
             T* target() noexcept
             {
-                auto data = static_cast<Derived*>(this)->write( );
-                assert(data);
-                if( data && id == typeid( T ).hash_code() )
-                    return static_cast<T*>( data );
+                if( holds<T>() )
+                    return static_cast<T*>( static_cast<Derived*>(this)->write( ) );
+                if( holds< std::reference_wrapper<T> >() )
+                    return &static_cast<std::reference_wrapper<T>*>( static_cast<Derived*>(this)->write( ) )->get();
                 return nullptr;
             }
 
             template < class T >
             const T* target( ) const noexcept
             {
-                auto data = static_cast<const Derived*>(this)->read( );
-                assert(data);
-                if( data && id == typeid( T ).hash_code() )
-                    return static_cast<const T*>( data );
+                if( holds<T>() )
+                    return static_cast<const T*>( static_cast<const Derived*>(this)->read( ) );
+                if( holds< std::reference_wrapper<T> >() )
+                    return &static_cast<const std::reference_wrapper<T>*>( static_cast<const Derived*>(this)->read( ) )->get();
                 return nullptr;
             }
 
+            /// True if target<T>() does not return nullptr.
             template <class T>
-            static constexpr Casts create() noexcept
+            bool is() const noexcept
             {
-                return Casts(typeid(std::decay_t<T>).hash_code());
+                return holds<T>() || holds< std::reference_wrapper<T> >();
             }
 
-        private:
-            std::size_t id;
-        };
-
-
-        template <class Derived>
-        class Casts<Derived, false>
-        {
-        public:
-            template < class T >
-            T* target() noexcept
+            /// Identifies the type of the stored object, nullptr if the storage is empty.
+            const void* type() const noexcept
             {
-                auto data = static_cast<Derived*>(this)->write( );
-                assert(data);
-                return static_cast<T*>( static_cast<Derived*>(this)->write( ) );
+                const auto& self = static_cast<const Derived&>(*this);
+                return self.read( ) ? self.table : nullptr;
             }
 
-            template < class T >
-            const T* target( ) const noexcept
+            template <class T>
+            static constexpr Casts create() noexcept
             {
-                auto data = static_cast<const Derived*>(this)->read( );
-                assert(data);
-                return static_cast<const T*>( data );
+                return Casts();
             }
 
+        private:
             template <class T>
-            static constexpr Casts create() noexcept
+            bool holds() const noexcept
             {
-                return Casts();
+                return type() == detail::objectTable< std::decay_t<T> >();
             }
         };
 
@@ -166,34 +457,48 @@ namespace clang
         template <class Derived, bool rttiEnabled>
         class Accessor : public Casts<Derived, rttiEnabled>
         {
+            template <class, bool>
+            friend class Accessor;
+
         public:
             using Base = Casts<Derived, rttiEnabled>;
 
             constexpr Accessor( ) = default;
 
-            explicit Accessor(Base base, bool containsReferenceWrapper) noexcept
-                : Base(base)
-                , containsReferenceWrapper(containsReferenceWrapper)
+            /// Takes over the type information of another storage in converting moves.
+            template <class Other>
+            explicit Accessor(const Accessor<Other, rttiEnabled>& other) noexcept
+                : Base(static_cast<const Casts<Other, rttiEnabled>&>(other))
             {}
 
+            /// The stored object of type T, or the object of type T that it refers to. Only the
+            /// table knows the stored type, the generated calls use object() instead.
             template <class T>
             T& get() noexcept
             {
-                auto data = static_cast<Derived*>(this)->write( );
-                assert(data);
-                if(containsReferenceWrapper)
-                    return static_cast<std::reference_wrapper<T>*>(data)->get();
-                return *static_cast<T*>(data);
+                const auto object = this->template target<T>();
+                assert(object);
+                return *object;
             }
 
             template <class T>
             const T& get() const noexcept
             {
-                const auto data = static_cast<const Derived*>(this)->read( );
-                assert(data);
-                if(containsReferenceWrapper)
-                    return static_cast<const std::reference_wrapper<T>*>(data)->get();
-                return *static_cast<const T*>(data);
+                const auto object = this->template target<T>();
+                assert(object);
+                return *object;
+            }
+
+            /// Pointer to the stored object, as passed to the function table.
+            void* object() CLANG_TYPE_ERASE_NOTHROW
+            {
+                return static_cast<Derived*>(this)->write( );
+            }
+
+            /// Pointer to the stored object, as passed to the function table.
+            const void* object() const noexcept
+            {
+                return static_cast<const Derived*>(this)->read( );
             }
 
             explicit operator bool() const noexcept
@@ -201,39 +506,60 @@ namespace clang
                 return static_cast<const Derived*>(this)->read( ) != nullptr;
             }
 
+            /// The type information is held by the object table of the storage.
             template <class T>
-            static constexpr Accessor create(bool containsReferenceWrapper) noexcept
+            static constexpr Accessor create() noexcept
             {
-                return Accessor(Base::template create<T>(), containsReferenceWrapper);
+                return Accessor();
             }
-
-        private:
-            bool containsReferenceWrapper = false;
         };
 
 
-        template<bool rttiEnabled>
-        class Storage : public Accessor<Storage<rttiEnabled>, rttiEnabled>
+        template<bool rttiEnabled, class Tag = void>
+        class Storage : public Accessor<Storage<rttiEnabled, Tag>, rttiEnabled>,
+                        private detail::StatsRecorder<Tag>,
+                        private detail::StorageKind<rttiEnabled, Tag, true>
         {
             friend class Accessor<Storage, rttiEnabled>;
             friend class Casts<Storage, rttiEnabled>;
+            friend struct detail::Transfer;
 
             using Base = Accessor<Storage, rttiEnabled>;
+            using Recorder = detail::StatsRecorder<Tag>;
         public:
             constexpr Storage() noexcept = default;
 
             template <class T,
-                      std::enable_if_t<!std::is_base_of<Storage, std::decay_t<T> >::value>* = nullptr>
-            explicit Storage(T&& value)
-                : Base(Base::template create<std::decay_t<T>>(detail::IsReferenceWrapper< std::decay_t<T> >::value)),
-                  del(&detail::deleteData< std::decay_t<T> >),
-                  copy_data(&detail::copyData< std::decay_t<T> >),
-                  data(new std::decay_t<T>(std::forward<T>(value)))
+                      std::enable_if_t<detail::IsValue<std::decay_t<T> >::value>* = nullptr>
+            explicit Storage(T&& value) CLANG_TYPE_ERASE_NOTHROW
+                : Storage(in_place_type< std::decay_t<T> >, std::forward<T>(value))
             {}
 
+            /// Constructs the stored object on the heap.
+            template <class T, class... Args>
+            explicit Storage(in_place_type_t<T>, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+                : Base(Base::template create<T>()),
+                  table(detail::objectTable<T>())
+            {
+                static_assert(std::is_copy_constructible<T>::value, "stored objects must be copyable");
+                block = detail::makeSharedBlock<T>(data, std::forward<Args>(args)...);
+                Recorder::template recordConstruction<T>(false);
+            }
+
+            /// Takes over the object of a storage with another storage policy.
+            template <class Other,
+                      std::enable_if_t<detail::CanAdopt<Other, rttiEnabled, Tag, true>::value &&
+                                       !std::is_same<Other, Storage>::value>* = nullptr>
+            explicit Storage(Other&& other) CLANG_TYPE_ERASE_NOTHROW
+                : Base(other),
+                  Recorder(detail::Transfer::recorder(other))
+            {
+                adopt(detail::Transfer::release(other));
+            }
+
             template <class T,
-                      std::enable_if_t<!std::is_base_of<Storage, std::decay_t<T> >::value>* = nullptr>
-            Storage& operator=(T&& value)
+                      std::enable_if_t<detail::IsValue<std::decay_t<T> >::value>* = nullptr>
+            Storage& operator=(T&& value) CLANG_TYPE_ERASE_NOTHROW
             {
                 return *this = Storage(std::forward<T>(value));
             }
@@ -243,39 +569,48 @@ namespace clang
                 reset();
             }
 
-            Storage(const Storage& other)
+            Storage(const Storage& other) CLANG_TYPE_ERASE_NOTHROW
                 : Base(other),
-                  del(other.del),
-                  copy_data(other.copy_data),
-                  data(other.data == nullptr ? nullptr : other.copy())
-            {}
+                  Recorder(other)
+            {
+                copy(other);
+            }
 
             Storage(Storage&& other) noexcept
                 : Base(other),
-                  del(other.del),
-                  copy_data(other.copy_data),
+                  Recorder(other),
+                  table(other.table),
+                  block(other.block),
                   data(other.data)
             {
+                other.table = detail::emptyObjectTable();
+                other.block = nullptr;
                 other.data = nullptr;
             }
 
-            Storage& operator=(const Storage& other)
+            Storage& operator=(const Storage& other) CLANG_TYPE_ERASE_NOTHROW
             {
+                if(this == &other)
+                    return *this;
                 reset();
                 Base::operator=(other);
-                del = other.del;
-                copy_data = other.copy_data;
-                data = (other.data == nullptr ? nullptr : other.copy());
+                Recorder::operator=(other);
+                copy(other);
                 return *this;
             }
 
             Storage& operator=(Storage&& other) noexcept
             {
+                if(this == &other)
+                    return *this;
                 reset();
                 Base::operator=(other);
-                del = other.del;
-                copy_data = other.copy_data;
+                Recorder::operator=(other);
+                table = other.table;
+                block = other.block;
                 data = other.data;
+                other.table = detail::emptyObjectTable();
+                other.block = nullptr;
                 other.data = nullptr;
                 return *this;
             }
@@ -283,8 +618,11 @@ namespace clang
         private:
             void reset() noexcept
             {
-                if(data)
-                    del(data);
+                Recorder::recordDestruction(data);
+                detail::Reclamation<Tag>::del(*table, block);
+                table = detail::emptyObjectTable();
+                block = nullptr;
+                data = nullptr;
             }
 
             void* read() const noexcept
@@ -297,41 +635,82 @@ namespace clang
                 return read();
             }
 
-            void* copy() const
+            void copy(const Storage& other) CLANG_TYPE_ERASE_NOTHROW
             {
-                assert(data);
-                return copy_data(data);
+                block = other.table->copy(other.data, data);
+                table = other.table;
+                Recorder::recordClone(data);
+            }
+
+            detail::Payload release() noexcept
+            {
+                const detail::Payload payload{table, block, data};
+                table = detail::emptyObjectTable();
+                block = nullptr;
+                data = nullptr;
+                return payload;
+            }
+
+            void adopt(detail::Payload payload) CLANG_TYPE_ERASE_NOTHROW
+            {
+                if(detail::unshare(payload))
+                    Recorder::recordClone();
+                detail::moveToHeap(payload);
+                table = payload.table;
+                block = payload.block;
+                data = payload.data;
             }
 
-            using delete_fn = void(*)(void*);
-            using copy_fn = void*(*)(void*);
-            delete_fn del = nullptr;
-            copy_fn copy_data = nullptr;
+            const detail::ObjectTable* table = detail::emptyObjectTable();
+            detail::SharedCount* block = nullptr;
             void* data = nullptr;
         };
 
 
-        template<bool rttiEnabled>
-        class NonCopyableStorage : public Accessor<NonCopyableStorage<rttiEnabled>, rttiEnabled>
+        template<bool rttiEnabled, class Tag = void>
+        class NonCopyableStorage : public Accessor<NonCopyableStorage<rttiEnabled, Tag>, rttiEnabled>,
+                                   private detail::StatsRecorder<Tag>,
+                                   private detail::StorageKind<rttiEnabled, Tag, false>
         {
             friend class Accessor<NonCopyableStorage, rttiEnabled>;
             friend class Casts<NonCopyableStorage, rttiEnabled>;
+            friend struct detail::Transfer;
 
             using Base = Accessor<NonCopyableStorage, rttiEnabled>;
+            using Recorder = detail::StatsRecorder<Tag>;
         public:
             constexpr NonCopyableStorage() noexcept = default;
 
             template <class T,
-                      std::enable_if_t<!std::is_base_of<NonCopyableStorage, std::decay_t<T> >::value>* = nullptr>
-            explicit NonCopyableStorage(T&& value)
-                : Base(Base::template create<std::decay_t<T>>(detail::IsReferenceWrapper< std::decay_t<T> >::value)),
-                  del(&detail::deleteData< std::decay_t<T> >),
-                  data(new std::decay_t<T>(std::forward<T>(value)))
+                      std::enable_if_t<detail::IsValue<std::decay_t<T> >::value>* = nullptr>
+            explicit NonCopyableStorage(T&& value) CLANG_TYPE_ERASE_NOTHROW
+                : NonCopyableStorage(in_place_type< std::decay_t<T> >, std::forward<T>(value))
             {}
 
+            /// Constructs the stored object on the heap.
+            template <class T, class... Args>
+            explicit NonCopyableStorage(in_place_type_t<T>, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+                : Base(Base::template create<T>()),
+                  table(detail::objectTable<T>())
+            {
+                block = detail::makeSharedBlock<T>(data, std::forward<Args>(args)...);
+                Recorder::template recordConstruction<T>(false);
+            }
+
+            /// Takes over the object of a storage with another storage policy.
+            template <class Other,
+                      std::enable_if_t<detail::CanAdopt<Other, rttiEnabled, Tag, false>::value &&
+                                       !std::is_same<Other, NonCopyableStorage>::value>* = nullptr>
+            explicit NonCopyableStorage(Other&& other) CLANG_TYPE_ERASE_NOTHROW
+                : Base(other),
+                  Recorder(detail::Transfer::recorder(other))
+            {
+                adopt(detail::Transfer::release(other));
+            }
+
             template <class T,
-                      std::enable_if_t<!std::is_base_of<NonCopyableStorage, std::decay_t<T> >::value>* = nullptr>
-            NonCopyableStorage& operator=(T&& value)
+                      std::enable_if_t<detail::IsValue<std::decay_t<T> >::value>* = nullptr>
+            NonCopyableStorage& operator=(T&& value) CLANG_TYPE_ERASE_NOTHROW
             {
                 return *this = NonCopyableStorage(std::forward<T>(value));
             }
@@ -343,18 +722,28 @@ namespace clang
 
             NonCopyableStorage(NonCopyableStorage&& other) noexcept
                 : Base(other),
-                  del(other.del),
+                  Recorder(other),
+                  table(other.table),
+                  block(other.block),
                   data(other.data)
             {
+                other.table = detail::emptyObjectTable();
+                other.block = nullptr;
                 other.data = nullptr;
             }
 
             NonCopyableStorage& operator=(NonCopyableStorage&& other) noexcept
             {
+                if(this == &other)
+                    return *this;
                 reset();
                 Base::operator=(other);
-                del = other.del;
+                Recorder::operator=(other);
+                table = other.table;
+                block = other.block;
                 data = other.data;
+                other.table = detail::emptyObjectTable();
+                other.block = nullptr;
                 other.data = nullptr;
                 return *this;
             }
@@ -362,8 +751,11 @@ namespace clang
         private:
             void reset() noexcept
             {
-                if(data)
-                    del(data);
+                Recorder::recordDestruction(data);
+                detail::Reclamation<Tag>::del(*table, block);
+                table = detail::emptyObjectTable();
+                block = nullptr;
+                data = nullptr;
             }
 
             void* read() const noexcept
@@ -376,118 +768,250 @@ namespace clang
                 return read();
             }
 
-            using delete_fn = void(*)(void*);
-            delete_fn del = nullptr;
+            detail::Payload release() noexcept
+            {
+                const detail::Payload payload{table, block, data};
+                table = detail::emptyObjectTable();
+                block = nullptr;
+                data = nullptr;
+                return payload;
+            }
+
+            void adopt(detail::Payload payload) CLANG_TYPE_ERASE_NOTHROW
+            {
+                if(detail::unshare(payload))
+                    Recorder::recordClone();
+                detail::moveToHeap(payload);
+                table = payload.table;
+                block = payload.block;
+                data = payload.data;
+            }
+
+            const detail::ObjectTable* table = detail::emptyObjectTable();
+            detail::SharedCount* block = nullptr;
             void* data = nullptr;
         };
 
 
-        template<bool rttiEnabled>
-        class COWStorage : public Accessor<COWStorage<rttiEnabled>, rttiEnabled>
+        /// Copy-on-write storage.
+        ///
+        /// Copies share the heap-allocated object. Distinct copies may be read and modified
+        /// concurrently on different threads, the object is unshared before the first
+        /// modification. As for std::shared_ptr, concurrent access to the same storage object
+        /// requires external synchronization.
+        template<bool rttiEnabled, class Tag = void>
+        class COWStorage : public Accessor<COWStorage<rttiEnabled, Tag>, rttiEnabled>,
+                           private detail::StatsRecorder<Tag>,
+                           private detail::StorageKind<rttiEnabled, Tag, true>
         {
             friend class Accessor<COWStorage, rttiEnabled>;
             friend class Casts<COWStorage, rttiEnabled>;
+            friend struct detail::Transfer;
 
             using Base = Accessor<COWStorage, rttiEnabled>;
+            using Recorder = detail::StatsRecorder<Tag>;
         public:
             constexpr COWStorage() noexcept = default;
 
             template <class T,
-                      std::enable_if_t<!std::is_base_of<COWStorage, std::decay_t<T> >::value>* = nullptr>
-            explicit COWStorage(T&& value)
-                : Base(Base::template create<std::decay_t<T>>(detail::IsReferenceWrapper< std::decay_t<T> >::value)),
-                  copy_data(&detail::copyData< std::decay_t<T> >),
-                  data(std::make_shared< std::decay_t<T> >(std::forward<T>(value)))
+                      std::enable_if_t<detail::IsValue<std::decay_t<T> >::value>* = nullptr>
+            explicit COWStorage(T&& value) CLANG_TYPE_ERASE_NOTHROW
+                : COWStorage(in_place_type< std::decay_t<T> >, std::forward<T>(value))
             {}
 
+            /// Constructs the stored object on the heap.
+            template <class T, class... Args>
+            explicit COWStorage(in_place_type_t<T>, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+                : Base(Base::template create<T>()),
+                  table(detail::objectTable<T>())
+            {
+                static_assert(std::is_copy_constructible<T>::value, "stored objects must be copyable");
+                block = detail::makeSharedBlock<T>(data, std::forward<Args>(args)...);
+                Recorder::template recordConstruction<T>(false);
+            }
+
+            /// Takes over the object of a storage with another storage policy. Objects on the heap
+            /// are shared without copying them.
+            template <class Other,
+                      std::enable_if_t<detail::CanAdopt<Other, rttiEnabled, Tag, true>::value &&
+                                       !std::is_same<Other, COWStorage>::value>* = nullptr>
+            explicit COWStorage(Other&& other) CLANG_TYPE_ERASE_NOTHROW
+                : Base(other),
+                  Recorder(detail::Transfer::recorder(other))
+            {
+                auto payload = detail::Transfer::release(other);
+                detail::moveToHeap(payload);
+                table = payload.table;
+                block = payload.block;
+                data = payload.data;
+            }
+
             template <class T,
-                      std::enable_if_t<!std::is_base_of<COWStorage, std::decay_t<T> >::value>* = nullptr>
-            COWStorage& operator=(T&& value)
+                      std::enable_if_t<detail::IsValue<std::decay_t<T> >::value>* = nullptr>
+            COWStorage& operator=(T&& value) CLANG_TYPE_ERASE_NOTHROW
             {
                 return *this = COWStorage(std::forward<T>(value));
             }
 
+            ~COWStorage()
+            {
+                reset();
+            }
+
+            COWStorage(const COWStorage& other) noexcept
+                : Base(other),
+                  Recorder(other),
+                  table(other.table),
+                  block(other.block),
+                  data(other.data)
+            {
+                detail::acquireShared(block);
+            }
+
+            COWStorage(COWStorage&& other) noexcept
+                : Base(other),
+                  Recorder(other),
+                  table(other.table),
+                  block(other.block),
+                  data(other.data)
+            {
+                other.table = detail::emptyObjectTable();
+                other.block = nullptr;
+                other.data = nullptr;
+            }
+
+            COWStorage& operator=(const COWStorage& other) noexcept
+            {
+                if(this == &other)
+                    return *this;
+                detail::acquireShared(other.block);
+                reset();
+                Base::operator=(other);
+                Recorder::operator=(other);
+                table = other.table;
+                block = other.block;
+                data = other.data;
+                return *this;
+            }
+
+            COWStorage& operator=(COWStorage&& other) noexcept
+            {
+                if(this == &other)
+                    return *this;
+                reset();
+                Base::operator=(other);
+                Recorder::operator=(other);
+                table = other.table;
+                block = other.block;
+                data = other.data;
+                other.table = detail::emptyObjectTable();
+                other.block = nullptr;
+                other.data = nullptr;
+                return *this;
+            }
+
         private:
+            void reset() noexcept
+            {
+                if(detail::releaseShared(block))
+                {
+                    Recorder::recordDestruction();
+                    detail::Reclamation<Tag>::del(*table, block);
+                }
+                table = detail::emptyObjectTable();
+                block = nullptr;
+                data = nullptr;
+            }
+
             void* read() const noexcept
             {
-                return data.get();
+                return data;
             }
 
-            void* write()
+            void* write() CLANG_TYPE_ERASE_NOTHROW
             {
-                if(!data.unique())
-                    data = copy_data(data);
+                if(block && !detail::isUniquelyShared(block))
+                {
+                    void* copy = nullptr;
+                    const auto copied_block = table->copy(data, copy);
+                    const auto copied_table = table;
+                    reset();
+                    table = copied_table;
+                    block = copied_block;
+                    data = copy;
+                    Recorder::recordUnshare();
+                }
                 return read();
             }
 
-            using copy_fn = std::shared_ptr<void>(*)(const std::shared_ptr<void>&);
-            copy_fn copy_data = nullptr;
-            std::shared_ptr<void> data = nullptr;
+            detail::Payload release() noexcept
+            {
+                const detail::Payload payload{table, block, data};
+                table = detail::emptyObjectTable();
+                block = nullptr;
+                data = nullptr;
+                return payload;
+            }
+
+            const detail::ObjectTable* table = detail::emptyObjectTable();
+            detail::SharedCount* block = nullptr;
+            void* data = nullptr;
         };
 
 
-        template <int buffer_size, bool rttiEnabled>
-        class SBOStorage : public Accessor< SBOStorage<buffer_size, rttiEnabled>, rttiEnabled >
+        template <int buffer_size, bool rttiEnabled, class Tag = void>
+        class SBOStorage : public Accessor< SBOStorage<buffer_size, rttiEnabled, Tag>, rttiEnabled >,
+                           private detail::StatsRecorder<Tag>,
+                           private detail::StorageKind<rttiEnabled, Tag, true>
         {
-            using Buffer = std::array<char,buffer_size>;
-
-            struct FunctionTable
-            {
-                using delete_fn = void(*)(void*);
-                using destruct_fn = void(*)(void*);
-                using copy_fn = void*(*)(void*);
-                using buffer_copy_fn = void*(*)(void*, Buffer&);
-
-                delete_fn del = nullptr;
-                destruct_fn destruct = nullptr;
-                copy_fn copy = nullptr;
-                buffer_copy_fn copy_into = nullptr;
-            };
+            using Buffer = detail::SmallBuffer<buffer_size>;
 
             friend class Accessor< SBOStorage, rttiEnabled >;
             friend class Casts<SBOStorage, rttiEnabled>;
+            friend struct detail::Transfer;
 
             using Base = Accessor<SBOStorage, rttiEnabled>;
+            using Recorder = detail::StatsRecorder<Tag>;
         public:
             constexpr SBOStorage() noexcept = default;
 
             template <class T,
-                      std::enable_if_t<!std::is_base_of<SBOStorage, std::decay_t<T> >::value>* = nullptr,
-                      std::enable_if_t<std::greater<>()(sizeof(std::decay_t<T>), sizeof(Buffer))>* = nullptr>
+                      std::enable_if_t<detail::IsValue<std::decay_t<T> >::value>* = nullptr>
             explicit SBOStorage(T&& value)
-            noexcept( sizeof(std::decay_t<T>) <= sizeof(Buffer) &&
-                      ( (std::is_rvalue_reference<T>::value && std::is_nothrow_move_constructible<std::decay_t<T>>::value) ||
-                        (std::is_lvalue_reference<T>::value && std::is_nothrow_copy_constructible<std::decay_t<T>>::value) ) )
-                : Base(Base::template create<std::decay_t<T>>(detail::IsReferenceWrapper< std::decay_t<T> >::value)),
-                  function_table{&detail::deleteData< std::decay_t<T> >,
-                                 &detail::destructData< std::decay_t<T> >,
-                                 &detail::copyData< std::decay_t<T> >,
-                                 &detail::copyIntoBuffer<std::decay_t<T>, Buffer>},
-                  data(new std::decay_t<T>(std::forward<T>(value)))
+            CLANG_TYPE_ERASE_NOEXCEPT( detail::FitsIntoBuffer<std::decay_t<T>, Buffer>::value && std::is_nothrow_constructible<std::decay_t<T>, T&&>::value )
+                : SBOStorage(in_place_type< std::decay_t<T> >, std::forward<T>(value))
             {}
 
-            template <class T,
-                      std::enable_if_t<!std::is_base_of<SBOStorage, std::decay_t<T> >::value>* = nullptr,
-                      std::enable_if_t<std::less_equal<>()(sizeof(std::decay_t<T>), sizeof(Buffer))>* = nullptr>
-            explicit SBOStorage(T&& value)
-            noexcept( sizeof(std::decay_t<T>) <= sizeof(Buffer) &&
-                      ( (std::is_rvalue_reference<T>::value && std::is_nothrow_move_constructible<std::decay_t<T>>::value) ||
-                        (std::is_lvalue_reference<T>::value && std::is_nothrow_copy_constructible<std::decay_t<T>>::value) ) )
-                : Base(Base::template create<std::decay_t<T>>(detail::IsReferenceWrapper< std::decay_t<T> >::value)),
-                  function_table{&detail::deleteData< std::decay_t<T> >,
-                                 &detail::destructData< std::decay_t<T> >,
-                                 &detail::copyData< std::decay_t<T> >,
-                                 &detail::copyIntoBuffer<std::decay_t<T>, Buffer>}
+            /// Constructs the stored object in the buffer if it fits.
+            template <class T, class... Args>
+            explicit SBOStorage(in_place_type_t<T>, Args&&... args)
+            CLANG_TYPE_ERASE_NOEXCEPT( detail::FitsIntoBuffer<T, Buffer>::value && std::is_nothrow_constructible<T, Args&&...>::value )
+                : Base(Base::template create<T>()),
+                  table(detail::objectTable<T>())
+            {
+                static_assert(std::is_copy_constructible<T>::value, "stored objects must be copyable");
+                data = detail::construct<T>(detail::FitsIntoBuffer<T, Buffer>(), buffer, block, std::forward<Args>(args)...);
+                Recorder::template recordConstruction<T>(data == &buffer);
+            }
+
+            /// Takes over the object of a storage with another storage policy. Objects on the heap
+            /// are taken over without copying them, objects in the buffer of the other storage are
+            /// relocated.
+            template <class Other,
+                      std::enable_if_t<detail::CanAdopt<Other, rttiEnabled, Tag, true>::value &&
+                                       !std::is_same<Other, SBOStorage>::value>* = nullptr>
+            explicit SBOStorage(Other&& other) CLANG_TYPE_ERASE_NOTHROW
+                : Base(other),
+                  Recorder(detail::Transfer::recorder(other))
             {
-                new(&buffer) std::decay_t<T>(std::forward<T>(value));
-                data = &buffer;
+                adopt(detail::Transfer::release(other));
             }
 
             template <class T,
-                      std::enable_if_t<!std::is_base_of<SBOStorage, std::decay_t<T> >::value>* = nullptr>
+                      std::enable_if_t<detail::IsValue<std::decay_t<T> >::value>* = nullptr>
             SBOStorage& operator=(T&& value)
-            noexcept( sizeof(std::decay_t<T>) <= sizeof(Buffer) &&
-                      ( (std::is_rvalue_reference<T>::value && std::is_nothrow_move_constructible<std::decay_t<T>>::value) ||
+            CLANG_TYPE_ERASE_NOEXCEPT( detail::FitsIntoBuffer<std::decay_t<T>, Buffer>::value &&
+                      ( (std::is_rvalue_reference<T&&>::value && std::is_nothrow_move_constructible<std::decay_t<T>>::value) ||
                         (std::is_lvalue_reference<T>::value && std::is_nothrow_copy_constructible<std::decay_t<T>>::value) ) )
             {
                 return *this = SBOStorage(std::forward<T>(value));
@@ -498,71 +1022,55 @@ namespace clang
                 reset();
             }
 
-            SBOStorage(const SBOStorage& other)
+            SBOStorage(const SBOStorage& other) CLANG_TYPE_ERASE_NOTHROW
                 : Base(other),
-                  function_table(other.function_table)
+                  Recorder(other)
             {
-                data = other.copy_into(buffer);
+                copy(other);
             }
 
             SBOStorage(SBOStorage&& other) noexcept
                 : Base(other),
-                  function_table(other.function_table)
+                  Recorder(other),
+                  table(other.table)
             {
-                if(!other.data)
-                    return;
-
-                if(detail::isHeapAllocated(other.data, other.buffer))
-                    data = other.data;
-                else
-                {
-                    buffer = other.buffer;
-                    data = &buffer;
-                }
-
-                other.data = nullptr;
+                move(other);
             }
 
-            SBOStorage& operator=(const SBOStorage& other)
+            SBOStorage& operator=(const SBOStorage& other) CLANG_TYPE_ERASE_NOTHROW
             {
+                if(this == &other)
+                    return *this;
                 reset();
                 Base::operator=(other);
-                function_table = other.function_table;
-                data = other.copy_into(buffer);
+                Recorder::operator=(other);
+                copy(other);
                 return *this;
             }
 
             SBOStorage& operator=(SBOStorage&& other) noexcept
             {
-                reset();
-                if(!other.data)
-                {
-                    data = nullptr;
+                if(this == &other)
                     return *this;
-                }
+                reset();
                 Base::operator=(other);
-                function_table = other.function_table;
-                if(detail::isHeapAllocated(other.data, other.buffer))
-                    data = other.data;
-                else
-                {
-                    buffer = other.buffer;
-                    data = &buffer;
-                }
-                other.data = nullptr;
+                Recorder::operator=(other);
+                table = other.table;
+                move(other);
                 return *this;
             }
 
         private:
             void reset() noexcept
             {
-                if(!data)
-                    return;
-
-                if(detail::isHeapAllocated(data, buffer))
-                    function_table.del(data);
+                Recorder::recordDestruction(data);
+                if(block)
+                    detail::Reclamation<Tag>::del(*table, block);
                 else
-                    function_table.destruct(data);
+                    table->destruct(data);
+                table = detail::emptyObjectTable();
+                block = nullptr;
+                data = nullptr;
             }
 
             void* read() const noexcept
@@ -570,72 +1078,117 @@ namespace clang
                 return data;
             }
 
-            void* write()
+            void* write() CLANG_TYPE_ERASE_NOTHROW
             {
                 return read();
             }
 
-            void* copy_into(Buffer& other_buffer) const
+            void copy(const SBOStorage& other) CLANG_TYPE_ERASE_NOTHROW
+            {
+                if(other.block)
+                    block = other.table->copy(other.data, data);
+                else
+                    data = other.table->copy_into(other.data, &buffer);
+                table = other.table;
+                Recorder::recordClone(data);
+            }
+
+            void move(SBOStorage& other) noexcept
+            {
+                if(other.block)
+                {
+                    block = other.block;
+                    data = other.data;
+                }
+                else
+                    data = table->move_into(other.data, &buffer);
+                other.table = detail::emptyObjectTable();
+                other.block = nullptr;
+                other.data = nullptr;
+            }
+
+            detail::Payload release() noexcept
+            {
+                const detail::Payload payload{table, block, data};
+                table = detail::emptyObjectTable();
+                block = nullptr;
+                data = nullptr;
+                return payload;
+            }
+
+            void adopt(detail::Payload payload) CLANG_TYPE_ERASE_NOTHROW
             {
-                if(!data)
-                    return nullptr;
-                if(detail::isHeapAllocated(data, buffer))
-                    return function_table.copy(data);
-                return function_table.copy_into(data, other_buffer);
+                if(detail::unshare(payload))
+                    Recorder::recordClone();
+                if(payload.data && !payload.block && detail::fitsIntoBuffer<Buffer>(*payload.table))
+                    payload.data = payload.table->move_into(payload.data, &buffer);
+                else
+                    detail::moveToHeap(payload);
+                table = payload.table;
+                block = payload.block;
+                data = payload.data;
             }
 
-            FunctionTable function_table;
+            const detail::ObjectTable* table = detail::emptyObjectTable();
+            detail::SharedCount* block = nullptr;
             void* data = nullptr;
             Buffer buffer;
         };
 
 
-        template <int buffer_size, bool rttiEnabled>
-        class NonCopyableSBOStorage : public Accessor< NonCopyableSBOStorage<buffer_size, rttiEnabled>, rttiEnabled >
+        template <int buffer_size, bool rttiEnabled, class Tag = void>
+        class NonCopyableSBOStorage : public Accessor< NonCopyableSBOStorage<buffer_size, rttiEnabled, Tag>, rttiEnabled >,
+                                      private detail::StatsRecorder<Tag>,
+                                      private detail::StorageKind<rttiEnabled, Tag, false>
         {
-            using Buffer = std::array<char,buffer_size>;
-
-            struct FunctionTable
-            {
-                using delete_fn = void(*)(void*);
-                using destruct_fn = void(*)(void*);
-                delete_fn del = nullptr;
-                destruct_fn destruct = nullptr;
-            };
+            using Buffer = detail::SmallBuffer<buffer_size>;
 
             friend class Accessor< NonCopyableSBOStorage, rttiEnabled >;
             friend class Casts< NonCopyableSBOStorage, rttiEnabled >;
+            friend struct detail::Transfer;
 
             using Base = Accessor< NonCopyableSBOStorage, rttiEnabled >;
+            using Recorder = detail::StatsRecorder<Tag>;
 
         public:
             constexpr NonCopyableSBOStorage() noexcept = default;
 
             template <class T,
-                      std::enable_if_t<!std::is_base_of<NonCopyableSBOStorage, std::decay_t<T> >::value>* = nullptr>
+                      std::enable_if_t<detail::IsValue<std::decay_t<T> >::value>* = nullptr>
             explicit NonCopyableSBOStorage(T&& value)
-            noexcept( sizeof(std::decay_t<T>) <= sizeof(Buffer) &&
-                      ( (std::is_rvalue_reference<T>::value && std::is_nothrow_move_constructible<std::decay_t<T>>::value) ||
-                        (std::is_lvalue_reference<T>::value && std::is_nothrow_copy_constructible<std::decay_t<T>>::value) ) )
-                : Base(Base::template create<std::decay_t<T>>(detail::IsReferenceWrapper< std::decay_t<T> >::value)),
-                  function_table{
-                      &detail::deleteData< std::decay_t<T> >,
-                      &detail::destructData< std::decay_t<T> > }
+            CLANG_TYPE_ERASE_NOEXCEPT( detail::FitsIntoBuffer<std::decay_t<T>, Buffer>::value && std::is_nothrow_constructible<std::decay_t<T>, T&&>::value )
+                : NonCopyableSBOStorage(in_place_type< std::decay_t<T> >, std::forward<T>(value))
+            {}
+
+            /// Constructs the stored object in the buffer if it fits.
+            template <class T, class... Args>
+            explicit NonCopyableSBOStorage(in_place_type_t<T>, Args&&... args)
+            CLANG_TYPE_ERASE_NOEXCEPT( detail::FitsIntoBuffer<T, Buffer>::value && std::is_nothrow_constructible<T, Args&&...>::value )
+                : Base(Base::template create<T>()),
+                  table(detail::objectTable<T>())
             {
-                if( sizeof(std::decay_t<T>) <= sizeof(Buffer))
-                {
-                    new(&buffer) std::decay_t<T>(std::forward<T>(value));
-                    data = &buffer;
-                }
-                else
-                    data = new std::decay_t<T>(std::forward<T>(value));
+                data = detail::construct<T>(detail::FitsIntoBuffer<T, Buffer>(), buffer, block, std::forward<Args>(args)...);
+                Recorder::template recordConstruction<T>(data == &buffer);
+            }
+
+            /// Takes over the object of a storage with another storage policy. Objects on the heap
+            /// are taken over without copying them, objects in the buffer of the other storage are
+            /// relocated.
+            template <class Other,
+                      std::enable_if_t<detail::CanAdopt<Other, rttiEnabled, Tag, false>::value &&
+                                       !std::is_same<Other, NonCopyableSBOStorage>::value>* = nullptr>
+            explicit NonCopyableSBOStorage(Other&& other) CLANG_TYPE_ERASE_NOTHROW
+                : Base(other),
+                  Recorder(detail::Transfer::recorder(other))
+            {
+                adopt(detail::Transfer::release(other));
             }
 
             template <class T,
-                      std::enable_if_t<!std::is_base_of<NonCopyableSBOStorage, std::decay_t<T> >::value>* = nullptr>
+                      std::enable_if_t<detail::IsValue<std::decay_t<T> >::value>* = nullptr>
             NonCopyableSBOStorage& operator=(T&& value)
-            noexcept( sizeof(std::decay_t<T>) <= sizeof(Buffer) &&
-                      ( (std::is_rvalue_reference<T>::value && std::is_nothrow_move_constructible<std::decay_t<T>>::value) ||
+            CLANG_TYPE_ERASE_NOEXCEPT( detail::FitsIntoBuffer<std::decay_t<T>, Buffer>::value &&
+                      ( (std::is_rvalue_reference<T&&>::value && std::is_nothrow_move_constructible<std::decay_t<T>>::value) ||
                         (std::is_lvalue_reference<T>::value && std::is_nothrow_copy_constructible<std::decay_t<T>>::value) ) )
             {
                 return *this = NonCopyableSBOStorage(std::forward<T>(value));
@@ -648,40 +1201,21 @@ namespace clang
 
             NonCopyableSBOStorage(NonCopyableSBOStorage&& other) noexcept
                 : Base(other),
-                  function_table(other.function_table)
+                  Recorder(other),
+                  table(other.table)
             {
-                if(!other.data)
-                    return;
-
-                if(detail::isHeapAllocated(other.data, other.buffer))
-                    data = other.data;
-                else
-                {
-                    buffer = other.buffer;
-                    data = &buffer;
-                }
-
-                other.data = nullptr;
+                move(other);
             }
 
             NonCopyableSBOStorage& operator=(NonCopyableSBOStorage&& other) noexcept
             {
-                reset();
-                if(!other.data)
-                {
-                    data = nullptr;
+                if(this == &other)
                     return *this;
-                }
+                reset();
                 Base::operator=(other);
-                function_table = other.function_table;
-                if(detail::isHeapAllocated(other.data, other.buffer))
-                    data = other.data;
-                else
-                {
-                    buffer = other.buffer;
-                    data = &buffer;
-                }
-                other.data = nullptr;
+                Recorder::operator=(other);
+                table = other.table;
+                move(other);
                 return *this;
             }
 
@@ -691,13 +1225,14 @@ namespace clang
         private:
             void reset() noexcept
             {
-                if(!data)
-                    return;
-
-                if(detail::isHeapAllocated(data, buffer))
-                    function_table.del(data);
+                Recorder::recordDestruction(data);
+                if(block)
+                    detail::Reclamation<Tag>::del(*table, block);
                 else
-                    function_table.destruct(data);
+                    table->destruct(data);
+                table = detail::emptyObjectTable();
+                block = nullptr;
+                data = nullptr;
             }
 
             void* read() const noexcept
@@ -705,102 +1240,137 @@ namespace clang
                 return data;
             }
 
-            void* write()
+            void* write() CLANG_TYPE_ERASE_NOTHROW
             {
                 return read();
             }
 
-            FunctionTable function_table;
+            void move(NonCopyableSBOStorage& other) noexcept
+            {
+                if(other.block)
+                {
+                    block = other.block;
+                    data = other.data;
+                }
+                else
+                    data = table->move_into(other.data, &buffer);
+                other.table = detail::emptyObjectTable();
+                other.block = nullptr;
+                other.data = nullptr;
+            }
+
+            detail::Payload release() noexcept
+            {
+                const detail::Payload payload{table, block, data};
+                table = detail::emptyObjectTable();
+                block = nullptr;
+                data = nullptr;
+                return payload;
+            }
+
+            void adopt(detail::Payload payload) CLANG_TYPE_ERASE_NOTHROW
+            {
+                if(detail::unshare(payload))
+                    Recorder::recordClone();
+                if(payload.data && !payload.block && detail::fitsIntoBuffer<Buffer>(*payload.table))
+                    payload.data = payload.table->move_into(payload.data, &buffer);
+                else
+                    detail::moveToHeap(payload);
+                table = payload.table;
+                block = payload.block;
+                data = payload.data;
+            }
+
+            const detail::ObjectTable* table = detail::emptyObjectTable();
+            detail::SharedCount* block = nullptr;
             void* data = nullptr;
             Buffer buffer;
         };
 
 
-        template <int buffer_size, bool rttiEnabled>
-        class SBOCOWStorage : public Accessor< SBOCOWStorage<buffer_size, rttiEnabled>, rttiEnabled >
+        /// Copy-on-write storage with small buffer optimization.
+        ///
+        /// Objects that fit into the buffer are copied eagerly, larger objects are shared.
+        /// The thread-safety guarantees are the same as for COWStorage.
+        template <int buffer_size, bool rttiEnabled, class Tag = void>
+        class SBOCOWStorage : public Accessor< SBOCOWStorage<buffer_size, rttiEnabled, Tag>, rttiEnabled >,
+                              private detail::StatsRecorder<Tag>,
+                              private detail::StorageKind<rttiEnabled, Tag, true>
         {
-            using Buffer = std::array<char,buffer_size>;
-
-            struct FunctionTable
-            {
-                using destruct_fn = void(*)(void*);
-                using copy_fn = std::shared_ptr<void>(*)(const std::shared_ptr<void>&);
-                using buffer_copy_fn = std::shared_ptr<void>(*)(const std::shared_ptr<void>&, Buffer&);
-
-                destruct_fn destruct = nullptr;
-                copy_fn copy = nullptr;
-                buffer_copy_fn copy_into = nullptr;
-            };
+            using Buffer = detail::SmallBuffer<buffer_size>;
 
             friend class Accessor< SBOCOWStorage, rttiEnabled >;
             friend class Casts< SBOCOWStorage, rttiEnabled >;
+            friend struct detail::Transfer;
 
             using Base = Accessor< SBOCOWStorage, rttiEnabled >;
+            using Recorder = detail::StatsRecorder<Tag>;
 
         public:
             constexpr SBOCOWStorage() noexcept = default;
 
             template <class T,
-                      std::enable_if_t<!std::is_base_of<SBOCOWStorage, std::decay_t<T> >::value>* = nullptr,
-                      std::enable_if_t<std::greater<>()(sizeof(std::decay_t<T>), sizeof(Buffer))>* = nullptr>
+                      std::enable_if_t<detail::IsValue<std::decay_t<T> >::value>* = nullptr>
             explicit SBOCOWStorage(T&& value)
-            noexcept( sizeof(std::decay_t<T>) <= sizeof(Buffer) &&
-                      ( (std::is_rvalue_reference<T>::value && std::is_nothrow_move_constructible<std::decay_t<T>>::value) ||
-                        (std::is_lvalue_reference<T>::value && std::is_nothrow_copy_constructible<std::decay_t<T>>::value) ) )
-                : Base(Base::template create<std::decay_t<T>>(detail::IsReferenceWrapper< std::decay_t<T> >::value)),
-                  function_table{&detail::destructData< std::decay_t<T> >,
-                                 &detail::copyData< std::decay_t<T> >,
-                                 &detail::copyIntoBuffer<std::decay_t<T>, Buffer>},
-                  data(std::make_shared< std::decay_t<T> >(std::forward<T>(value)))
-            {
-            }
+            CLANG_TYPE_ERASE_NOEXCEPT( detail::FitsIntoBuffer<std::decay_t<T>, Buffer>::value && std::is_nothrow_constructible<std::decay_t<T>, T&&>::value )
+                : SBOCOWStorage(in_place_type< std::decay_t<T> >, std::forward<T>(value))
+            {}
 
-            template <class T,
-                      std::enable_if_t<!std::is_base_of<SBOCOWStorage, std::decay_t<T> >::value>* = nullptr,
-                      std::enable_if_t<std::less_equal<>()(sizeof(std::decay_t<T>), sizeof(Buffer))>* = nullptr>
-            explicit SBOCOWStorage(T&& value)
-            noexcept( sizeof(std::decay_t<T>) <= sizeof(Buffer) &&
-                      ( (std::is_rvalue_reference<T>::value && std::is_nothrow_move_constructible<std::decay_t<T>>::value) ||
-                        (std::is_lvalue_reference<T>::value && std::is_nothrow_copy_constructible<std::decay_t<T>>::value) ) )
-                : Base(Base::template create<std::decay_t<T>>(detail::IsReferenceWrapper< std::decay_t<T> >::value)),
-                  function_table{&detail::destructData< std::decay_t<T> >,
-                                 &detail::copyData< std::decay_t<T> >,
-                                 &detail::copyIntoBuffer<std::decay_t<T>, Buffer>}
+            /// Constructs the stored object in the buffer if it fits.
+            template <class T, class... Args>
+            explicit SBOCOWStorage(in_place_type_t<T>, Args&&... args)
+            CLANG_TYPE_ERASE_NOEXCEPT( detail::FitsIntoBuffer<T, Buffer>::value && std::is_nothrow_constructible<T, Args&&...>::value )
+                : Base(Base::template create<T>()),
+                  table(detail::objectTable<T>())
+            {
+                static_assert(std::is_copy_constructible<T>::value, "stored objects must be copyable");
+                data = detail::construct<T>(detail::FitsIntoBuffer<T, Buffer>(), buffer, block, std::forward<Args>(args)...);
+                Recorder::template recordConstruction<T>(data == &buffer);
+            }
+
+            /// Takes over the object of a storage with another storage policy. Objects on the heap
+            /// are shared without copying them, objects in the buffer of the other storage are
+            /// relocated.
+            template <class Other,
+                      std::enable_if_t<detail::CanAdopt<Other, rttiEnabled, Tag, true>::value &&
+                                       !std::is_same<Other, SBOCOWStorage>::value>* = nullptr>
+            explicit SBOCOWStorage(Other&& other) CLANG_TYPE_ERASE_NOTHROW
+                : Base(other),
+                  Recorder(detail::Transfer::recorder(other))
             {
-                new(&buffer) std::decay_t<T>(std::forward<T>(value));
-                data = std::shared_ptr< std::decay_t<T> >(
-                           std::shared_ptr< std::decay_t<T> >(),
-                           static_cast<std::decay_t<T>*>(static_cast<void*>(&buffer))
-                           );
+                auto payload = detail::Transfer::release(other);
+                if(payload.data && !payload.block && detail::fitsIntoBuffer<Buffer>(*payload.table))
+                    payload.data = payload.table->move_into(payload.data, &buffer);
+                else
+                    detail::moveToHeap(payload);
+                table = payload.table;
+                block = payload.block;
+                data = payload.data;
             }
 
             template <class T,
-                      std::enable_if_t<!std::is_base_of<SBOCOWStorage, std::decay_t<T> >::value>* = nullptr>
+                      std::enable_if_t<detail::IsValue<std::decay_t<T> >::value>* = nullptr>
             SBOCOWStorage& operator=(T&& value)
-            noexcept( sizeof(std::decay_t<T>) <= sizeof(Buffer) &&
-                      ( (std::is_rvalue_reference<T>::value && std::is_nothrow_move_constructible<std::decay_t<T>>::value) ||
+            CLANG_TYPE_ERASE_NOEXCEPT( detail::FitsIntoBuffer<std::decay_t<T>, Buffer>::value &&
+                      ( (std::is_rvalue_reference<T&&>::value && std::is_nothrow_move_constructible<std::decay_t<T>>::value) ||
                         (std::is_lvalue_reference<T>::value && std::is_nothrow_copy_constructible<std::decay_t<T>>::value) ) )
             {
                 return *this = SBOCOWStorage(std::forward<T>(value));
             }
 
-            SBOCOWStorage(const SBOCOWStorage& other)
+            SBOCOWStorage(const SBOCOWStorage& other) CLANG_TYPE_ERASE_NOTHROW
                 : Base(other),
-                  function_table(other.function_table)
+                  Recorder(other)
             {
-                if(!other.data)
-                    return;
-                data = other.copy(buffer);
+                copy(other);
             }
 
             SBOCOWStorage(SBOCOWStorage&& other) noexcept
                 : Base(other),
-                  function_table(other.function_table)
+                  Recorder(other),
+                  table(other.table)
             {
-                if(!other.data)
-                    return;
-                data = std::move(other).move_if_heap_allocated(buffer);
-                other.data = nullptr;
+                move(other);
             }
 
             ~SBOCOWStorage() noexcept
@@ -808,75 +1378,113 @@ namespace clang
                 reset();
             }
 
-            SBOCOWStorage& operator=(const SBOCOWStorage& other)
+            SBOCOWStorage& operator=(const SBOCOWStorage& other) CLANG_TYPE_ERASE_NOTHROW
             {
-                reset();
-                if(!other.data)
-                {
-                    data = nullptr;
+                if(this == &other)
                     return *this;
-                }
+                reset();
                 Base::operator=(other);
-                function_table = other.function_table;
-
-                data = other.copy(buffer);
+                Recorder::operator=(other);
+                copy(other);
                 return *this;
             }
 
             SBOCOWStorage& operator=(SBOCOWStorage&& other) noexcept
             {
-                reset();
-                if(!other.data)
-                {
-                    data = nullptr;
+                if(this == &other)
                     return *this;
-                }
+                reset();
                 Base::operator=(other);
-                function_table = other.function_table;
-                data = std::move(other).move_if_heap_allocated(buffer);
-                other.data = nullptr;
+                Recorder::operator=(other);
+                table = other.table;
+                move(other);
                 return *this;
             }
 
         private:
             void reset() noexcept
             {
-                if(!data)
-                    return;
-
-                if(!detail::isHeapAllocated(data.get(), buffer))
-                    function_table.destruct(data.get());
+                if(block)
+                {
+                    if(detail::releaseShared(block))
+                    {
+                        Recorder::recordDestruction();
+                        detail::Reclamation<Tag>::del(*table, block);
+                    }
+                }
+                else
+                {
+                    Recorder::recordDestruction(data);
+                    table->destruct(data);
+                }
+                table = detail::emptyObjectTable();
+                block = nullptr;
+                data = nullptr;
             }
+
             void* read() const noexcept
             {
-                return data.get();
+                return data;
             }
 
-            void* write()
+            void* write() CLANG_TYPE_ERASE_NOTHROW
             {
-                if(!data.unique() && detail::isHeapAllocated(data.get(), buffer))
-                    data = function_table.copy(data);
+                if(block && !detail::isUniquelyShared(block))
+                {
+                    void* copied_data = nullptr;
+                    const auto copied_block = table->copy(data, copied_data);
+                    const auto copied_table = table;
+                    reset();
+                    table = copied_table;
+                    block = copied_block;
+                    data = copied_data;
+                    Recorder::recordUnshare();
+                }
                 return read();
             }
 
-            std::shared_ptr<void> copy(Buffer& other_buffer) const
+            void copy(const SBOCOWStorage& other) CLANG_TYPE_ERASE_NOTHROW
             {
-                if(detail::isHeapAllocated(data.get(), buffer))
-                    return data;
+                if(other.block)
+                {
+                    detail::acquireShared(other.block);
+                    block = other.block;
+                    data = other.data;
+                }
                 else
-                    return function_table.copy_into(data, other_buffer);
+                {
+                    data = other.table->copy_into(other.data, &buffer);
+                    Recorder::recordClone(data);
+                }
+                table = other.table;
             }
 
-            std::shared_ptr<void> move_if_heap_allocated(Buffer& other_buffer) const &&
+            void move(SBOCOWStorage& other) noexcept
             {
-                if(detail::isHeapAllocated(data.get(), buffer))
-                    return std::move(data);
+                if(other.block)
+                {
+                    block = other.block;
+                    data = other.data;
+                }
                 else
-                    return function_table.copy_into(data, other_buffer);
+                    data = table->move_into(other.data, &buffer);
+                other.table = detail::emptyObjectTable();
+                other.block = nullptr;
+                other.data = nullptr;
+            }
+
+            detail::Payload release() noexcept
+            {
+                const detail::Payload payload{table, block, data};
+                table = detail::emptyObjectTable();
+                block = nullptr;
+                data = nullptr;
+                return payload;
             }
 
-            FunctionTable function_table;
-            std::shared_ptr<void> data = nullptr;
+            const detail::ObjectTable* table = detail::emptyObjectTable();
+            detail::SharedCount* block = nullptr;
+            void* data = nullptr;
             Buffer buffer;
         };
     }
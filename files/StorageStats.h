@@ -0,0 +1,314 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#ifdef CLANG_TYPE_ERASE_STORAGE_STATS
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#endif
+
+namespace clang
+{
+    namespace type_erasure
+    {
+        namespace detail
+        {
+            /// Obtains the name of T from the function signature, which does not require RTTI.
+            template <class T>
+            std::string typeName()
+            {
+#if defined(__clang__) || defined(__GNUC__)
+                const std::string Signature = __PRETTY_FUNCTION__;
+                const auto Begin = Signature.find("T = ") + 4;
+                const auto End = Signature.find_first_of(";]", Begin);
+                return Signature.substr(Begin, End - Begin);
+#else
+                return "unknown";
+#endif
+            }
+        }
+
+#ifdef CLANG_TYPE_ERASE_STORAGE_STATS
+        /// Storage statistics of one type-erased interface, summed over all threads.
+        struct StorageStats
+        {
+            /// Type of an implementation that has been stored on the heap.
+            struct SpilledType
+            {
+                std::string name;
+                std::size_t size = 0;
+                std::uint64_t count = 0;
+            };
+
+            std::string interface;
+            std::int64_t inline_constructions = 0;
+            std::int64_t heap_constructions = 0;
+            std::int64_t clones = 0;
+            std::int64_t unshares = 0;
+            std::int64_t live_objects = 0;
+            std::int64_t live_bytes = 0;
+            std::vector<SpilledType> spilled_types;
+        };
+
+        namespace detail
+        {
+            /// Counters of one thread, only modified by this thread.
+            struct StorageCounters
+            {
+                void add(std::atomic<std::int64_t>& counter, std::int64_t value) noexcept
+                {
+                    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+                }
+
+                std::atomic<std::int64_t> inline_constructions{0};
+                std::atomic<std::int64_t> heap_constructions{0};
+                std::atomic<std::int64_t> clones{0};
+                std::atomic<std::int64_t> unshares{0};
+                std::atomic<std::int64_t> live_objects{0};
+                std::atomic<std::int64_t> live_bytes{0};
+            };
+
+            struct SpilledTypeCounter
+            {
+                std::string name;
+                std::size_t size;
+                std::atomic<std::uint64_t> count{0};
+            };
+
+            class StatsRegistry
+            {
+            public:
+                using collect_fn = StorageStats(*)();
+
+                static StatsRegistry& instance()
+                {
+                    static StatsRegistry registry;
+                    return registry;
+                }
+
+                void add(collect_fn collect)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    collectors.push_back(collect);
+                }
+
+                std::vector<StorageStats> collect() const
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    std::vector<StorageStats> stats;
+                    for(auto collect : collectors)
+                        stats.push_back(collect());
+                    return stats;
+                }
+
+            private:
+                mutable std::mutex mutex;
+                std::vector<collect_fn> collectors;
+            };
+
+
+            /// Storage statistics of the interface identified by Tag.
+            ///
+            /// Counters are thread-local and are only summed up in collect(). Counters of
+            /// terminated threads are kept.
+            template <class Tag>
+            class Telemetry
+            {
+            public:
+                static StorageCounters& counters()
+                {
+                    static thread_local StorageCounters& local = instance().registerThread();
+                    return local;
+                }
+
+                template <class T>
+                static void spill()
+                {
+                    static SpilledTypeCounter& counter = instance().registerSpilledType(typeName<T>(), sizeof(T));
+                    counter.count.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                static StorageStats collect()
+                {
+                    auto& telemetry = instance();
+                    std::lock_guard<std::mutex> lock(telemetry.mutex);
+                    StorageStats stats;
+                    stats.interface = typeName<Tag>();
+                    for(const auto& thread : telemetry.threads)
+                    {
+                        stats.inline_constructions += thread->inline_constructions.load(std::memory_order_relaxed);
+                        stats.heap_constructions += thread->heap_constructions.load(std::memory_order_relaxed);
+                        stats.clones += thread->clones.load(std::memory_order_relaxed);
+                        stats.unshares += thread->unshares.load(std::memory_order_relaxed);
+                        stats.live_objects += thread->live_objects.load(std::memory_order_relaxed);
+                        stats.live_bytes += thread->live_bytes.load(std::memory_order_relaxed);
+                    }
+                    for(const auto& spilled : telemetry.spilled_types)
+                        stats.spilled_types.push_back({spilled->name, spilled->size,
+                                                       spilled->count.load(std::memory_order_relaxed)});
+                    return stats;
+                }
+
+            private:
+                Telemetry()
+                {
+                    StatsRegistry::instance().add(&Telemetry::collect);
+                }
+
+                static Telemetry& instance()
+                {
+                    static Telemetry telemetry;
+                    return telemetry;
+                }
+
+                StorageCounters& registerThread()
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    threads.emplace_back(new StorageCounters);
+                    return *threads.back();
+                }
+
+                SpilledTypeCounter& registerSpilledType(std::string name, std::size_t size)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    spilled_types.emplace_back(new SpilledTypeCounter{std::move(name), size});
+                    return *spilled_types.back();
+                }
+
+                std::mutex mutex;
+                std::vector<std::unique_ptr<StorageCounters>> threads;
+                std::vector<std::unique_ptr<SpilledTypeCounter>> spilled_types;
+            };
+
+
+            /// Records the life cycle of the payload of a storage.
+            template <class Tag>
+            class StatsRecorder
+            {
+            protected:
+                template <class T>
+                void recordConstruction(bool isInline)
+                {
+                    size = sizeof(T);
+                    auto& counters = Telemetry<Tag>::counters();
+                    counters.add(isInline ? counters.inline_constructions : counters.heap_constructions, 1);
+                    counters.add(counters.live_objects, 1);
+                    counters.add(counters.live_bytes, size);
+                    if(!isInline)
+                        Telemetry<Tag>::template spill<T>();
+                }
+
+                void recordClone()
+                {
+                    auto& counters = Telemetry<Tag>::counters();
+                    counters.add(counters.clones, 1);
+                    counters.add(counters.live_objects, 1);
+                    counters.add(counters.live_bytes, size);
+                }
+
+                /// Records the clone of the object at data, nothing for copies of empty storages.
+                void recordClone(const void* data)
+                {
+                    if(data)
+                        recordClone();
+                }
+
+                void recordUnshare()
+                {
+                    auto& counters = Telemetry<Tag>::counters();
+                    counters.add(counters.unshares, 1);
+                    counters.add(counters.live_objects, 1);
+                    counters.add(counters.live_bytes, size);
+                }
+
+                void recordDestruction() noexcept
+                {
+                    auto& counters = Telemetry<Tag>::counters();
+                    counters.add(counters.live_objects, -1);
+                    counters.add(counters.live_bytes, -static_cast<std::int64_t>(size));
+                }
+
+                /// Records the destruction of the object at data, nothing for empty storages.
+                void recordDestruction(const void* data) noexcept
+                {
+                    if(data)
+                        recordDestruction();
+                }
+
+            private:
+                std::size_t size = 0;
+            };
+        }
+
+
+        /// Storage statistics of the interface identified by Tag, see storage_stats() of the
+        /// generated interfaces.
+        template <class Tag>
+        StorageStats storageStats()
+        {
+            return detail::Telemetry<Tag>::collect();
+        }
+
+        /// Writes stats as JSON object. Each spilled type is written on a separate line.
+        inline std::ostream& operator<<(std::ostream& OS, const StorageStats& stats)
+        {
+            OS << "{\"interface\": \"" << stats.interface << "\", "
+               << "\"inline_constructions\": " << stats.inline_constructions << ", "
+               << "\"heap_constructions\": " << stats.heap_constructions << ", "
+               << "\"clones\": " << stats.clones << ", "
+               << "\"unshares\": " << stats.unshares << ", "
+               << "\"live_objects\": " << stats.live_objects << ", "
+               << "\"live_bytes\": " << stats.live_bytes << ", "
+               << "\"spilled_types\": [";
+            for(const auto& spilled : stats.spilled_types)
+                OS << (&spilled == &stats.spilled_types.front() ? "\n" : ",\n")
+                   << "  {\"type\": \"" << spilled.name << "\", \"size\": " << spilled.size
+                   << ", \"count\": " << spilled.count << "}";
+            return OS << "]}";
+        }
+
+        /// Writes the storage statistics of all interfaces as JSON array, see '-storage-stats' of clang-type-erase.
+        inline void writeStorageStats(std::ostream& OS)
+        {
+            const auto stats = detail::StatsRegistry::instance().collect();
+            OS << "[";
+            for(const auto& entry : stats)
+                OS << (&entry == &stats.front() ? "\n" : ",\n") << entry;
+            OS << "\n]\n";
+        }
+
+#else
+        namespace detail
+        {
+            template <class Tag>
+            class StatsRecorder
+            {
+            protected:
+                template <class T>
+                void recordConstruction(bool) noexcept
+                {}
+
+                void recordClone() noexcept
+                {}
+
+                void recordClone(const void*) noexcept
+                {}
+
+                void recordUnshare() noexcept
+                {}
+
+                void recordDestruction() noexcept
+                {}
+
+                void recordDestruction(const void*) noexcept
+                {}
+            };
+        }
+#endif
+    }
+}
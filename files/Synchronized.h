@@ -0,0 +1,131 @@
+#pragma once
+
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+
+#include "Atomic.h"
+
+namespace clang
+{
+    namespace type_erasure
+    {
+#if __cplusplus >= 201703L
+        using SharedMutex = std::shared_mutex;
+#else
+        using SharedMutex = std::shared_timed_mutex;
+#endif
+
+        /// Interface that is shared between threads, see '-synchronized'.
+        ///
+        /// Readers, i.e. const methods, hold a shared lock and run concurrently, writers hold an
+        /// exclusive lock.
+        template <class Erased>
+        class Synchronized
+        {
+        public:
+            Synchronized() = default;
+
+            explicit Synchronized(Erased value)
+                : value_(std::move(value))
+            {}
+
+            Synchronized(const Synchronized&) = delete;
+            Synchronized& operator=(const Synchronized&) = delete;
+
+            template <class Read>
+            decltype(auto) read(Read read) const
+            {
+                std::shared_lock<SharedMutex> lock(mutex_);
+                return read(value_);
+            }
+
+            template <class Write>
+            decltype(auto) write(Write write)
+            {
+                std::lock_guard<SharedMutex> lock(mutex_);
+                return write(value_);
+            }
+
+            Erased load() const
+            {
+                std::shared_lock<SharedMutex> lock(mutex_);
+                return value_;
+            }
+
+            void store(Erased value)
+            {
+                std::lock_guard<SharedMutex> lock(mutex_);
+                value_ = std::move(value);
+            }
+
+        private:
+            mutable SharedMutex mutex_;
+            Erased value_;
+        };
+
+
+        /// Copy-on-write interface that is shared between threads, see '-synchronized'.
+        ///
+        /// Readers call the const methods on a snapshot of the current value without locking and
+        /// without waiting for writers, see Atomic. Writers are serialized, call the non-const
+        /// methods on a copy, which only copies the implementation if it is shared, and publish it.
+        template <class Erased>
+        class SnapshotSynchronized
+        {
+        public:
+            SnapshotSynchronized() = default;
+
+            explicit SnapshotSynchronized(Erased value)
+                : value_(std::move(value))
+            {}
+
+            SnapshotSynchronized(const SnapshotSynchronized&) = delete;
+            SnapshotSynchronized& operator=(const SnapshotSynchronized&) = delete;
+
+            template <class Read>
+            decltype(auto) read(Read read) const
+            {
+                const auto snapshot = value_.load();
+                return read(*snapshot);
+            }
+
+            template <class Write,
+                      std::enable_if_t<std::is_void<decltype(std::declval<Write&>()(std::declval<Erased&>()))>::value>* = nullptr>
+            void write(Write write)
+            {
+                std::lock_guard<std::mutex> lock(writer_);
+                auto next = load();
+                write(next);
+                value_.store(std::move(next));
+            }
+
+            template <class Write,
+                      std::enable_if_t<!std::is_void<decltype(std::declval<Write&>()(std::declval<Erased&>()))>::value>* = nullptr>
+            auto write(Write write)
+            {
+                std::lock_guard<std::mutex> lock(writer_);
+                auto next = load();
+                auto result = write(next);
+                value_.store(std::move(next));
+                return result;
+            }
+
+            Erased load() const
+            {
+                return *value_.load();
+            }
+
+            void store(Erased value)
+            {
+                std::lock_guard<std::mutex> lock(writer_);
+                value_.store(std::move(value));
+            }
+
+        private:
+            std::mutex writer_;
+            Atomic<Erased> value_;
+        };
+    }
+}
@@ -0,0 +1,432 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "Storage.h"
+
+namespace clang
+{
+    namespace type_erasure
+    {
+        namespace detail
+        {
+            /// Identifies the type of the object in a thin block. Followed by the function table
+            /// of the interface, see ThinDescriptor.
+            struct ThinDescriptorBase
+            {
+                const ObjectTable* object;
+            };
+
+            /// Type-specific part of a thin storage, one per interface and type.
+            template <class Functions>
+            struct ThinDescriptor : ThinDescriptorBase
+            {
+                ThinDescriptor(const ObjectTable* object, const Functions& functions) noexcept
+                    : ThinDescriptorBase{object},
+                      functions(functions)
+                {}
+
+                Functions functions;
+            };
+
+            template <class T, class Functions>
+            const ThinDescriptorBase* thinDescriptor(const Functions& functions)
+            {
+                // the entries of the function table only depend on T
+                static const ThinDescriptor<Functions> descriptor(objectTable<T>(), functions);
+                return &descriptor;
+            }
+
+            /// Header of the heap block of a thin storage, the stored object follows at offset
+            /// thinOffset. The count is only shared by copy-on-write storages.
+            struct ThinBlock : SharedCount
+            {
+                explicit ThinBlock(const ThinDescriptorBase* descriptor) noexcept
+                    : descriptor(descriptor)
+                {}
+
+                const ThinDescriptorBase* descriptor;
+            };
+
+            /// Fixed offset of the stored object, such that accessing it does not require a load.
+            constexpr std::size_t thinOffset = alignof(std::max_align_t);
+            static_assert(sizeof(ThinBlock) <= thinOffset, "the header of thin blocks must fit in front of the object");
+
+            inline void* thinData(ThinBlock* block) noexcept
+            {
+                return reinterpret_cast<char*>(block) + thinOffset;
+            }
+
+            template <class T, class... Args>
+            ThinBlock* makeThinBlock(const ThinDescriptorBase* descriptor, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+            {
+                static_assert(alignof(T) <= thinOffset, "over-aligned types can not be stored in thin storages");
+                const auto memory = allocate(thinOffset + sizeof(T));
+                CLANG_TYPE_ERASE_TRY
+                {
+                    new (static_cast<char*>(memory) + thinOffset) T(std::forward<Args>(args)...);
+                }
+                CLANG_TYPE_ERASE_CATCH_ALL
+                {
+                    ::operator delete(memory);
+                    CLANG_TYPE_ERASE_RETHROW;
+                }
+                return new (memory) ThinBlock(descriptor);
+            }
+
+            inline ThinBlock* copyThinBlock(ThinBlock* block) CLANG_TYPE_ERASE_NOTHROW
+            {
+                assert(block);
+                const auto& object = *block->descriptor->object;
+                assert(object.copy_into);
+                const auto memory = allocate(thinOffset + object.size);
+                CLANG_TYPE_ERASE_TRY
+                {
+                    object.copy_into(thinData(block), static_cast<char*>(memory) + thinOffset);
+                }
+                CLANG_TYPE_ERASE_CATCH_ALL
+                {
+                    ::operator delete(memory);
+                    CLANG_TYPE_ERASE_RETHROW;
+                }
+                return new (memory) ThinBlock(block->descriptor);
+            }
+
+            inline void deleteThinBlock(ThinBlock* block) noexcept
+            {
+                assert(block);
+                block->descriptor->object->destruct(thinData(block));
+                block->~ThinBlock();
+                ::operator delete(block);
+            }
+
+
+            /// Common part of the thin storages, which only hold a pointer to a heap block that
+            /// starts with the descriptor of the stored object.
+            template <class Derived, class Tag>
+            class ThinStorageBase : private StatsRecorder<Tag>,
+                                    private StorageBase
+            {
+            public:
+                /// The function table that has been passed to the constructor.
+                ///
+                /// Functions must be the type of that table, which the generated interfaces
+                /// guarantee by always passing their own table.
+                template <class Functions>
+                const Functions& functions() const noexcept
+                {
+                    assert(block);
+                    return static_cast<const ThinDescriptor<Functions>*>(block->descriptor)->functions;
+                }
+
+                /// Pointer to the stored object, as passed to the function table.
+                void* object() CLANG_TYPE_ERASE_NOTHROW
+                {
+                    return static_cast<Derived*>(this)->write();
+                }
+
+                /// Pointer to the stored object, as passed to the function table.
+                const void* object() const noexcept
+                {
+                    return read();
+                }
+
+                explicit operator bool() const noexcept
+                {
+                    return block != nullptr;
+                }
+
+                template <class T>
+                T& get() noexcept
+                {
+                    const auto result = target<T>();
+                    assert(result);
+                    return *result;
+                }
+
+                template <class T>
+                const T& get() const noexcept
+                {
+                    const auto result = target<T>();
+                    assert(result);
+                    return *result;
+                }
+
+                /// Pointer to the stored object if it is of type T or refers to an object of type
+                /// T, else nullptr.
+                template <class T>
+                T* target() noexcept
+                {
+                    if(holds<T>())
+                        return static_cast<T*>(object());
+                    if(holds< std::reference_wrapper<T> >())
+                        return &static_cast<std::reference_wrapper<T>*>(object())->get();
+                    return nullptr;
+                }
+
+                template <class T>
+                const T* target() const noexcept
+                {
+                    if(holds<T>())
+                        return static_cast<const T*>(read());
+                    if(holds< std::reference_wrapper<T> >())
+                        return &static_cast<const std::reference_wrapper<T>*>(read())->get();
+                    return nullptr;
+                }
+
+                /// True if target<T>() does not return nullptr.
+                template <class T>
+                bool is() const noexcept
+                {
+                    return holds<T>() || holds< std::reference_wrapper<T> >();
+                }
+
+                /// Identifies the type of the stored object, nullptr if the storage is empty.
+                const void* type() const noexcept
+                {
+                    return block ? block->descriptor->object : nullptr;
+                }
+
+            protected:
+                using Recorder = StatsRecorder<Tag>;
+
+                constexpr ThinStorageBase() noexcept = default;
+
+                template <class T, class Functions, class... Args>
+                ThinStorageBase(in_place_type_t<T>, const Functions& functions, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+                    : block(makeThinBlock<T>(thinDescriptor<T>(functions), std::forward<Args>(args)...))
+                {
+                    Recorder::template recordConstruction<T>(false);
+                }
+
+                ThinStorageBase(const ThinStorageBase& other, ThinBlock* block) noexcept
+                    : Recorder(other),
+                      block(block)
+                {}
+
+                ThinStorageBase(ThinStorageBase&& other) noexcept
+                    : Recorder(other),
+                      block(other.block)
+                {
+                    other.block = nullptr;
+                }
+
+                ~ThinStorageBase()
+                {
+                    reset();
+                }
+
+                /// Takes over block, which must not be the current block.
+                void assign(const ThinStorageBase& other, ThinBlock* block) noexcept
+                {
+                    reset();
+                    Recorder::operator=(other);
+                    this->block = block;
+                }
+
+                void* read() const noexcept
+                {
+                    return block ? thinData(block) : nullptr;
+                }
+
+                void recordClone()
+                {
+                    Recorder::recordClone();
+                }
+
+                void recordUnshare()
+                {
+                    Recorder::recordUnshare();
+                }
+
+                ThinBlock* block = nullptr;
+
+            private:
+                // blocks that are not shared have a count of one
+                void reset() noexcept
+                {
+                    if(!block)
+                        return;
+                    if(isUniquelyShared(block) || releaseShared(block))
+                    {
+                        Recorder::recordDestruction();
+                        deleteThinBlock(block);
+                    }
+                    block = nullptr;
+                }
+
+                template <class T>
+                bool holds() const noexcept
+                {
+                    return type() == objectTable< std::decay_t<T> >();
+                }
+            };
+        }
+
+
+        /// Storage that only holds a single pointer.
+        ///
+        /// The stored object is allocated together with a descriptor that identifies its type and
+        /// holds the function table of the interface, thus sizeof(ThinStorage) == sizeof(void*).
+        /// Calls load the table from the heap block instead of from the interface.
+        template <bool rttiEnabled, class Tag = void>
+        class ThinStorage : public detail::ThinStorageBase<ThinStorage<rttiEnabled, Tag>, Tag>
+        {
+            friend class detail::ThinStorageBase<ThinStorage, Tag>;
+
+            using Base = detail::ThinStorageBase<ThinStorage, Tag>;
+        public:
+            constexpr ThinStorage() noexcept = default;
+
+            /// Constructs the stored object on the heap, in front of which the descriptor with the
+            /// function table is stored.
+            template <class T, class Functions, class... Args>
+            explicit ThinStorage(in_place_type_t<T>, const Functions& functions, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+                : Base(in_place_type<T>, functions, std::forward<Args>(args)...)
+            {
+                static_assert(std::is_copy_constructible<T>::value, "stored objects must be copyable");
+            }
+
+            ThinStorage(const ThinStorage& other) CLANG_TYPE_ERASE_NOTHROW
+                : Base(other, other.block ? detail::copyThinBlock(other.block) : nullptr)
+            {
+                if(this->block)
+                    this->recordClone();
+            }
+
+            ThinStorage(ThinStorage&&) noexcept = default;
+
+            ThinStorage& operator=(const ThinStorage& other) CLANG_TYPE_ERASE_NOTHROW
+            {
+                if(this != &other)
+                    *this = ThinStorage(other);
+                return *this;
+            }
+
+            ThinStorage& operator=(ThinStorage&& other) noexcept
+            {
+                if(this == &other)
+                    return *this;
+                this->assign(other, other.block);
+                other.block = nullptr;
+                return *this;
+            }
+
+        private:
+            void* write() noexcept
+            {
+                return this->read();
+            }
+        };
+
+
+        /// Copy-on-write variant of ThinStorage, copies share the heap block.
+        ///
+        /// As for COWStorage, distinct copies may be read and modified concurrently on different
+        /// threads, the object is unshared before the first modification.
+        template <bool rttiEnabled, class Tag = void>
+        class ThinCOWStorage : public detail::ThinStorageBase<ThinCOWStorage<rttiEnabled, Tag>, Tag>
+        {
+            friend class detail::ThinStorageBase<ThinCOWStorage, Tag>;
+
+            using Base = detail::ThinStorageBase<ThinCOWStorage, Tag>;
+        public:
+            constexpr ThinCOWStorage() noexcept = default;
+
+            template <class T, class Functions, class... Args>
+            explicit ThinCOWStorage(in_place_type_t<T>, const Functions& functions, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+                : Base(in_place_type<T>, functions, std::forward<Args>(args)...)
+            {
+                static_assert(std::is_copy_constructible<T>::value, "stored objects must be copyable");
+            }
+
+            ThinCOWStorage(const ThinCOWStorage& other) noexcept
+                : Base(other, other.block)
+            {
+                detail::acquireShared(this->block);
+            }
+
+            ThinCOWStorage(ThinCOWStorage&&) noexcept = default;
+
+            ThinCOWStorage& operator=(const ThinCOWStorage& other) noexcept
+            {
+                if(this == &other)
+                    return *this;
+                detail::acquireShared(other.block);
+                this->assign(other, other.block);
+                return *this;
+            }
+
+            ThinCOWStorage& operator=(ThinCOWStorage&& other) noexcept
+            {
+                if(this == &other)
+                    return *this;
+                this->assign(other, other.block);
+                other.block = nullptr;
+                return *this;
+            }
+
+        private:
+            void* write() CLANG_TYPE_ERASE_NOTHROW
+            {
+                auto& block = this->block;
+                if(block && !detail::isUniquelyShared(block))
+                {
+                    const auto copy = detail::copyThinBlock(block);
+                    if(detail::releaseShared(block))
+                    {
+                        // all other copies have been released in the meantime
+                        detail::deleteThinBlock(copy);
+                        block->count.store(1, std::memory_order_relaxed);
+                    }
+                    else
+                    {
+                        block = copy;
+                        this->recordUnshare();
+                    }
+                }
+                return this->read();
+            }
+        };
+
+
+        /// Move-only variant of ThinStorage.
+        template <bool rttiEnabled, class Tag = void>
+        class NonCopyableThinStorage
+            : public detail::ThinStorageBase<NonCopyableThinStorage<rttiEnabled, Tag>, Tag>
+        {
+            friend class detail::ThinStorageBase<NonCopyableThinStorage, Tag>;
+
+            using Base = detail::ThinStorageBase<NonCopyableThinStorage, Tag>;
+        public:
+            constexpr NonCopyableThinStorage() noexcept = default;
+
+            template <class T, class Functions, class... Args>
+            explicit NonCopyableThinStorage(in_place_type_t<T>, const Functions& functions, Args&&... args) CLANG_TYPE_ERASE_NOTHROW
+                : Base(in_place_type<T>, functions, std::forward<Args>(args)...)
+            {}
+
+            NonCopyableThinStorage(NonCopyableThinStorage&&) noexcept = default;
+
+            NonCopyableThinStorage& operator=(NonCopyableThinStorage&& other) noexcept
+            {
+                if(this == &other)
+                    return *this;
+                this->assign(other, other.block);
+                other.block = nullptr;
+                return *this;
+            }
+
+        private:
+            void* write() noexcept
+            {
+                return this->read();
+            }
+        };
+    }
+}
@@ -3,6 +3,8 @@
 // @cond TYPE_ERASURE_DETAIL
 
 #include <cassert>
+#include <cstddef>
+#include <functional>
 #include <memory>
 #include <typeinfo>
 #include <type_traits>
@@ -27,6 +29,36 @@ namespace type_erasure_table_detail
     template < class T >
     using remove_reference_wrapper_t = typename remove_reference_wrapper< T >::type;
 
+    /// Access to the stored object in the function table. The thunks are instantiated with
+    /// the stored type, thus std::reference_wrapper< T > is unwrapped at compile time.
+    template < class T >
+    struct object_access
+    {
+        static T& get( void* data ) noexcept
+        {
+            return *static_cast< T* >( data );
+        }
+
+        static const T& get( const void* data ) noexcept
+        {
+            return *static_cast< const T* >( data );
+        }
+    };
+
+    template < class T >
+    struct object_access< std::reference_wrapper< T > >
+    {
+        static T& get( void* data ) noexcept
+        {
+            return static_cast< std::reference_wrapper< T >* >( data )->get( );
+        }
+
+        static const T& get( const void* data ) noexcept
+        {
+            return static_cast< const std::reference_wrapper< T >* >( data )->get( );
+        }
+    };
+
     template < class... Args >
     struct AndImpl;
 
@@ -44,6 +76,45 @@ namespace type_erasure_table_detail
 
     template <class... Args>
     using And = typename AndImpl<Args...>::type;
+
+    /// Bulk operations are called for runs of at most bulk_chunk_size objects.
+    constexpr std::size_t bulk_chunk_size = 64;
+
+    /// Calls call(data, first, count) for each run of consecutive interfaces with the same bulk
+    /// entry, i.e. with the same implementation type, where data points to the stored objects.
+    template < class Interface, class Entry, class Object, class Call >
+    void for_each_run( Interface* interfaces, std::size_t count, Entry entry, Object object, Call call )
+    {
+        using Data = decltype( object( *interfaces ) );
+        Data data[ bulk_chunk_size ];
+        for ( std::size_t first = 0, n = 0; first < count; first += n )
+        {
+            const auto function = entry( interfaces[ first ] );
+            const auto last = count - first < bulk_chunk_size ? count - first : bulk_chunk_size;
+            data[ 0 ] = object( interfaces[ first ] );
+            for ( n = 1; n < last && entry( interfaces[ first + n ] ) == function; ++n )
+                data[ n ] = object( interfaces[ first + n ] );
+            call( static_cast< const Data* >( data ), first, n );
+        }
+    }
+
+    /// Calls call(objects, first, count) for chunks of at most bulk_chunk_size of the stored objects
+    /// in data, where objects points to the (unwrapped) implementations.
+    template < class Impl, class Data, class Call >
+    void for_each_chunk( Data* const* data, std::size_t count, Call call )
+    {
+        using Object = std::conditional_t< std::is_const< Data >::value,
+                                           const remove_reference_wrapper_t< Impl >,
+                                           remove_reference_wrapper_t< Impl > >;
+        Object* objects[ bulk_chunk_size ];
+        for ( std::size_t first = 0; first < count; first += bulk_chunk_size )
+        {
+            const auto n = count - first < bulk_chunk_size ? count - first : bulk_chunk_size;
+            for ( std::size_t i = 0; i < n; ++i )
+                objects[ i ] = &object_access< Impl >::get( data[ first + i ] );
+            call( static_cast< Object* const* >( objects ), first, n );
+        }
+    }
 }
 
 // @endcond
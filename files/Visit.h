@@ -0,0 +1,85 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+namespace clang
+{
+    namespace type_erasure
+    {
+        /// Function object that combines the call operators of Fs.
+        template <class... Fs>
+        struct overloaded;
+
+        template <class F>
+        struct overloaded<F> : F
+        {
+            explicit overloaded(F f)
+                : F(std::move(f))
+            {}
+
+            using F::operator();
+        };
+
+        template <class F, class... Fs>
+        struct overloaded<F, Fs...> : F, overloaded<Fs...>
+        {
+            explicit overloaded(F f, Fs... fs)
+                : F(std::move(f)),
+                  overloaded<Fs...>(std::move(fs)...)
+            {}
+
+            using F::operator();
+            using overloaded<Fs...>::operator();
+        };
+
+        /// Combines lambdas to a visitor, e.g. overload([](ImplA& a) {...}, [](ImplB& b) {...}).
+        template <class... Fs>
+        overloaded<std::decay_t<Fs>...> overload(Fs&&... fs)
+        {
+            return overloaded<std::decay_t<Fs>...>(std::forward<Fs>(fs)...);
+        }
+
+
+        namespace detail
+        {
+            template <class... Impls>
+            struct ImplList
+            {};
+
+            template <class Erased, class Impl>
+            using TargetRef = decltype(*std::declval<Erased&>().template target<Impl>());
+
+            template <class Result, class Erased, class Visitor, class Fallback>
+            Result visit(ImplList<>, Erased& erased, Visitor&, Fallback& fallback)
+            {
+                return fallback(erased);
+            }
+
+            template <class Result, class Impl, class... Impls, class Erased, class Visitor, class Fallback>
+            Result visit(ImplList<Impl, Impls...>, Erased& erased, Visitor& visitor, Fallback& fallback)
+            {
+                if(auto impl = erased.template target<Impl>())
+                    return visitor(*impl);
+                return detail::visit<Result>(ImplList<Impls...>(), erased, visitor, fallback);
+            }
+        }
+
+
+        /// Calls visitor with the stored object if it is of one of the types Impls, which are
+        /// tried in the given order, else calls fallback with erased.
+        ///
+        /// The types are compared via the object tables resp. type tags of the stored objects, and
+        /// the visitor is called with the concrete type. Thus the calls of the expected
+        /// implementations can be inlined, while all others go through the function table resp.
+        /// virtual function table in fallback. The result type is the one of the visitor for the
+        /// first type. Works for all interfaces with the default cast name 'target' and for the
+        /// storages themselves.
+        template <class Impl, class... Impls, class Erased, class Visitor, class Fallback>
+        decltype(auto) visit(Erased&& erased, Visitor&& visitor, Fallback&& fallback)
+        {
+            using Result = decltype(visitor(std::declval< detail::TargetRef<std::remove_reference_t<Erased>, Impl> >()));
+            return detail::visit<Result>(detail::ImplList<Impl, Impls...>(), erased, visitor, fallback);
+        }
+    }
+}
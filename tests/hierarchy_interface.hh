@@ -0,0 +1,19 @@
+    /**
+     * @brief class Fooable
+     */
+    class Fooable
+    {
+    public:
+        /// Does something.
+        int foo() const;
+    };
+
+    /**
+     * @brief class Settable, converts to Fooable
+     */
+    class Settable : public Fooable
+    {
+    public:
+        //! Sets something.
+        void set_value(int value);
+    };
@@ -0,0 +1,11 @@
+    /**
+     * @brief class Pricing
+     */
+    class Pricing
+    {
+    public:
+        /// Computes something expensive, cached per arguments.
+        [[clang::annotate("te_memoize")]] int price(int item, int quantity) const;
+        //! Changes the results of price.
+        void set_discount(int discount);
+    };
@@ -28,5 +28,35 @@ namespace Mock
     private:
         std::array<double,1024> buffer_;
     };
+
+    /// Small, but not trivially copyable, as it refers to itself.
+    struct MockSelfReferencingFooable
+    {
+        MockSelfReferencingFooable() = default;
+
+        MockSelfReferencingFooable(const MockSelfReferencingFooable& other)
+            : value_(other.value_)
+        {}
+
+        MockSelfReferencingFooable& operator=(const MockSelfReferencingFooable& other)
+        {
+            value_ = other.value_;
+            return *this;
+        }
+
+        int foo() const
+        {
+            return self_ == this ? value_ : -1;
+        }
+
+        void set_value(int val)
+        {
+            value_ = val;
+        }
+
+    private:
+        const MockSelfReferencingFooable* self_ = this;
+        int value_ = value;
+    };
 }
 
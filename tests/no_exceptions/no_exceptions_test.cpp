@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <Storage.h>
+#include <ThinStorage.h>
+
+#include <cstdio>
+#include <limits>
+#include <string>
+
+namespace
+{
+    struct Large
+    {
+        std::string name = "large";
+        char padding[128] = {};
+    };
+
+    // as generated with '-no-exceptions' for struct Nameable { std::string name() const; };
+    struct Table
+    {
+        std::string (*name)(const void*) CLANG_TYPE_ERASE_NOTHROW_FUNCTION;
+    };
+
+    template <class T>
+    std::string name(const void* data) noexcept
+    {
+        return static_cast<const T*>(data)->name;
+    }
+
+    struct Huge
+    {
+        Huge() = default;
+
+        Huge(const Huge&)
+        {}
+
+        char data[std::numeric_limits<std::ptrdiff_t>::max() / 2];
+    };
+
+    void report(const char* what)
+    {
+        std::fputs(what, stderr);
+    }
+}
+
+TEST( NoExceptions, LifecycleOperationsAreNoexcept )
+{
+    using Storage = clang::type_erasure::Storage<false>;
+    using SBOStorage = clang::type_erasure::SBOStorage<16, false>;
+    using COWStorage = clang::type_erasure::COWStorage<false>;
+    using ThinStorage = clang::type_erasure::ThinStorage<false>;
+
+    static_assert(std::is_nothrow_constructible<Storage, Large>::value, "");
+    static_assert(std::is_nothrow_copy_constructible<Storage>::value, "");
+    static_assert(std::is_nothrow_copy_assignable<Storage>::value, "");
+    static_assert(std::is_nothrow_constructible<SBOStorage, Large>::value, "");
+    static_assert(std::is_nothrow_copy_constructible<SBOStorage>::value, "");
+    static_assert(std::is_nothrow_constructible<Storage, SBOStorage&&>::value, "");
+    static_assert(std::is_nothrow_constructible<COWStorage, Large>::value, "");
+    static_assert(std::is_nothrow_constructible<ThinStorage, clang::type_erasure::in_place_type_t<Large>,
+                                                const Table&>::value, "");
+    static_assert(std::is_nothrow_copy_constructible<ThinStorage>::value, "");
+
+    const ThinStorage thin(clang::type_erasure::in_place_type<Large>, Table{ &name<Large> });
+    const auto copy = thin;
+    EXPECT_EQ( "large", copy.functions<Table>().name(copy.object()) );
+
+    SBOStorage storage(Large{});
+    const auto moved = Storage(std::move(storage));
+    EXPECT_EQ( "large", moved.get<Large>().name );
+}
+
+TEST( NoExceptionsDeathTest, AllocationFailuresAreReportedToTheFailureHandler )
+{
+    clang::type_erasure::setFailureHandler(&report);
+    EXPECT_DEATH( clang::type_erasure::Storage<false>(clang::type_erasure::in_place_type<Huge>),
+                  "memory allocation failed" );
+    clang::type_erasure::setFailureHandler(nullptr);
+}
@@ -34,5 +34,37 @@ namespace Mock
     private:
         std::array<double,1024> buffer_;
     };
+
+    /// Small, but not trivially movable, as it refers to itself.
+    struct NonCopyableMockSelfReferencingFooable
+    {
+        NonCopyableMockSelfReferencingFooable() = default;
+        NonCopyableMockSelfReferencingFooable(const NonCopyableMockSelfReferencingFooable&) = delete;
+        NonCopyableMockSelfReferencingFooable& operator=(const NonCopyableMockSelfReferencingFooable&) = delete;
+
+        NonCopyableMockSelfReferencingFooable(NonCopyableMockSelfReferencingFooable&& other)
+            : value_(other.value_)
+        {}
+
+        NonCopyableMockSelfReferencingFooable& operator=(NonCopyableMockSelfReferencingFooable&& other)
+        {
+            value_ = other.value_;
+            return *this;
+        }
+
+        int foo() const
+        {
+            return self_ == this ? value_ : -1;
+        }
+
+        void set_value(int val)
+        {
+            value_ = val;
+        }
+
+    private:
+        const NonCopyableMockSelfReferencingFooable* self_ = this;
+        int value_ = value;
+    };
 }
 
@@ -7,6 +7,7 @@
 using SBO::Fooable;
 using Mock::MockFooable;
 using Mock::MockLargeFooable;
+using Mock::MockSelfReferencingFooable;
 
 TEST( TestSBOFooable_HeapAllocations, Empty )
 {
@@ -260,3 +261,47 @@ TEST( TestSBOFooable_HeapAllocations, MoveAssignFromValueWithReferenceWrapper_La
                       fooable = std::move(std::ref(mock_fooable)),
                       expected_heap_allocations );
 }
+
+
+TEST( TestSBOFooable_HeapAllocations, CopyConstruction_NonTriviallyCopyableSmallObject )
+{
+    auto expected_heap_allocations = 0u;
+
+    Fooable fooable = MockSelfReferencingFooable();
+    CHECK_HEAP_ALLOC( Fooable other( fooable ),
+                      expected_heap_allocations );
+    EXPECT_EQ( Mock::value, other.foo() );
+}
+
+TEST( TestSBOFooable_HeapAllocations, CopyAssignment_NonTriviallyCopyableSmallObject )
+{
+    auto expected_heap_allocations = 0u;
+
+    Fooable fooable = MockSelfReferencingFooable();
+    Fooable other;
+    CHECK_HEAP_ALLOC( other = fooable,
+                      expected_heap_allocations );
+    EXPECT_EQ( Mock::value, other.foo() );
+}
+
+
+TEST( TestSBOFooable_HeapAllocations, MoveConstruction_NonTriviallyCopyableSmallObject )
+{
+    auto expected_heap_allocations = 0u;
+
+    Fooable fooable = MockSelfReferencingFooable();
+    CHECK_HEAP_ALLOC( Fooable other( std::move(fooable) ),
+                      expected_heap_allocations );
+    EXPECT_EQ( Mock::value, other.foo() );
+}
+
+TEST( TestSBOFooable_HeapAllocations, MoveAssignment_NonTriviallyCopyableSmallObject )
+{
+    auto expected_heap_allocations = 0u;
+
+    Fooable fooable = MockSelfReferencingFooable();
+    Fooable other;
+    CHECK_HEAP_ALLOC( other = std::move(fooable),
+                      expected_heap_allocations );
+    EXPECT_EQ( Mock::value, other.foo() );
+}
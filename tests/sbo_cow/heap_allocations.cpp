@@ -7,6 +7,7 @@
 using SBO_COW::Fooable;
 using Mock::MockFooable;
 using Mock::MockLargeFooable;
+using Mock::MockSelfReferencingFooable;
 
 TEST( TestSBOCOWFooable_HeapAllocations, Empty )
 {
@@ -268,3 +269,47 @@ TEST( TestSBOCOWFooable_HeapAllocations, MoveAssignFromValueWithReferenceWrapper
                       fooable = std::move(std::ref(mock_fooable)),
                       expected_heap_allocations );
 }
+
+
+TEST( TestSBOCOWFooable_HeapAllocations, CopyConstruction_NonTriviallyCopyableSmallObject )
+{
+    auto expected_heap_allocations = 0u;
+
+    Fooable fooable = MockSelfReferencingFooable();
+    CHECK_HEAP_ALLOC( Fooable other( fooable ),
+                      expected_heap_allocations );
+    EXPECT_EQ( Mock::value, other.foo() );
+}
+
+TEST( TestSBOCOWFooable_HeapAllocations, CopyAssignment_NonTriviallyCopyableSmallObject )
+{
+    auto expected_heap_allocations = 0u;
+
+    Fooable fooable = MockSelfReferencingFooable();
+    Fooable other;
+    CHECK_HEAP_ALLOC( other = fooable,
+                      expected_heap_allocations );
+    EXPECT_EQ( Mock::value, other.foo() );
+}
+
+
+TEST( TestSBOCOWFooable_HeapAllocations, MoveConstruction_NonTriviallyCopyableSmallObject )
+{
+    auto expected_heap_allocations = 0u;
+
+    Fooable fooable = MockSelfReferencingFooable();
+    CHECK_HEAP_ALLOC( Fooable other( std::move(fooable) ),
+                      expected_heap_allocations );
+    EXPECT_EQ( Mock::value, other.foo() );
+}
+
+TEST( TestSBOCOWFooable_HeapAllocations, MoveAssignment_NonTriviallyCopyableSmallObject )
+{
+    auto expected_heap_allocations = 0u;
+
+    Fooable fooable = MockSelfReferencingFooable();
+    Fooable other;
+    CHECK_HEAP_ALLOC( other = std::move(fooable),
+                      expected_heap_allocations );
+    EXPECT_EQ( Mock::value, other.foo() );
+}
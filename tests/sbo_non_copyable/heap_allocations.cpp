@@ -7,6 +7,7 @@
 using SBONonCopyable::Fooable;
 using MockFooable = Mock::NonCopyableMockFooable;
 using MockLargeFooable = Mock::NonCopyableMockLargeFooable;
+using MockSelfReferencingFooable = Mock::NonCopyableMockSelfReferencingFooable;
 
 TEST( TestNonCopyableSBOFooable_HeapAllocations, Empty )
 {
@@ -177,3 +178,25 @@ TEST( TestNonCopyableSBOFooable_HeapAllocations, MoveAssignFromValueWithReferenc
                       fooable = std::move(std::ref(mock_fooable)),
                       expected_heap_allocations );
 }
+
+
+TEST( TestNonCopyableSBOFooable_HeapAllocations, MoveConstruction_NonTriviallyCopyableSmallObject )
+{
+    auto expected_heap_allocations = 0u;
+
+    Fooable fooable = MockSelfReferencingFooable();
+    CHECK_HEAP_ALLOC( Fooable other( std::move(fooable) ),
+                      expected_heap_allocations );
+    EXPECT_EQ( Mock::value, other.foo() );
+}
+
+TEST( TestNonCopyableSBOFooable_HeapAllocations, MoveAssignment_NonTriviallyCopyableSmallObject )
+{
+    auto expected_heap_allocations = 0u;
+
+    Fooable fooable = MockSelfReferencingFooable();
+    Fooable other;
+    CHECK_HEAP_ALLOC( other = std::move(fooable),
+                      expected_heap_allocations );
+    EXPECT_EQ( Mock::value, other.foo() );
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <Instrumentation.h>
+#include <TypeErasureUtil.h>
+
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+    struct Fast
+    {
+        int foo() const
+        {
+            return 1;
+        }
+    };
+
+    struct Slow
+    {
+        int foo() const
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            return 2;
+        }
+    };
+
+    // as generated with '-custom -instrument'
+    template <class Interface, class Impl>
+    struct execution_wrapper
+    {
+        static int foo(const void* data)
+        {
+            static auto& type_erasure_counters = clang::type_erasure::detail::registerMethod("Metrics::Fooable", "foo() const", clang::type_erasure::detail::typeName<std::remove_const_t<type_erasure_table_detail::remove_reference_wrapper_t<Impl>>>());
+            const clang::type_erasure::MethodCall type_erasure_call(type_erasure_counters);
+            return type_erasure_table_detail::object_access<Impl>::get(data).foo();
+        }
+    };
+
+    struct Fooable;
+
+    const Fast fast_impl{};
+    const Slow slow_impl{};
+
+    clang::type_erasure::MethodMetrics metricsOf(const std::string& implementation)
+    {
+        const auto metrics = clang::type_erasure::collectMethodMetrics();
+        const auto entry = std::find_if(begin(metrics), end(metrics), [&implementation](const auto& metrics)
+        {
+            return metrics.interface == "Metrics::Fooable" && metrics.implementation.find(implementation) != std::string::npos;
+        });
+        EXPECT_NE( end(metrics), entry );
+        return entry == end(metrics) ? clang::type_erasure::MethodMetrics() : *entry;
+    }
+}
+
+TEST(MethodMetrics, CountsCallsPerImplementation)
+{
+    constexpr int n_threads = 4;
+    constexpr int n_calls = 1000;
+    std::vector<std::thread> threads;
+    for(int i = 0; i < n_threads; ++i)
+        threads.emplace_back([]
+        {
+            for(int j = 0; j < n_calls; ++j)
+                execution_wrapper<Fooable, Fast>::foo(&fast_impl);
+        });
+    for(auto& thread : threads)
+        thread.join();
+    execution_wrapper<Fooable, Slow>::foo(&slow_impl);
+
+    const auto fast = metricsOf("Fast");
+    EXPECT_EQ( "foo() const", fast.method );
+    EXPECT_EQ( static_cast<std::uint64_t>(n_threads * n_calls), fast.calls );
+    EXPECT_EQ( 1u, metricsOf("Slow").calls );
+}
+
+TEST(MethodMetrics, SamplesLatency)
+{
+    execution_wrapper<Fooable, Slow>::foo(&slow_impl);
+
+    // CLANG_TYPE_ERASE_LATENCY_SAMPLE_RATE is 1 for this test
+    const auto slow = metricsOf("Slow");
+    EXPECT_EQ( slow.calls, slow.sampled_calls );
+    const auto first_bucket = std::find_if(begin(slow.latency_histogram), end(slow.latency_histogram),
+                                           [](std::uint64_t count) { return count > 0; });
+    // at least 50us
+    EXPECT_GE( first_bucket - begin(slow.latency_histogram), 15 );
+}
+
+TEST(MethodMetrics, WritesJSON)
+{
+    execution_wrapper<Fooable, Fast>::foo(&fast_impl);
+
+    std::stringstream stream;
+    clang::type_erasure::writeMethodMetrics(stream);
+    EXPECT_NE( std::string::npos, stream.str().find("\"interface\": \"Metrics::Fooable\", \"method\": \"foo() const\"") );
+}
+
+TEST(MethodMetrics, CountsReferencesToTheImplementation)
+{
+    execution_wrapper<Fooable, Fast>::foo(&fast_impl);
+    const auto calls = metricsOf("Fast").calls;
+    const auto fast = std::cref(fast_impl);
+    execution_wrapper<Fooable, std::reference_wrapper<const Fast>>::foo(&fast);
+
+    const auto metrics = clang::type_erasure::collectMethodMetrics();
+    EXPECT_EQ( 1, std::count_if(begin(metrics), end(metrics), [](const auto& metrics)
+    {
+        return metrics.interface == "Metrics::Fooable" && metrics.implementation.find("Fast") != std::string::npos;
+    }) );
+    EXPECT_EQ( calls + 1, metricsOf("Fast").calls );
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <Storage.h>
+#include <SmartPointerStorage.h>
+
+#include <array>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+    struct Small
+    {
+        int value = 42;
+    };
+
+    struct Large
+    {
+        std::array<char, 64> data{};
+    };
+
+    struct SBOTag;
+    struct SBOCOWTag;
+    struct ThreadsTag;
+    struct JSONTag;
+
+    using SBOStorage = clang::type_erasure::SBOStorage<16, true, SBOTag>;
+    using SBOCOWStorage = clang::type_erasure::SBOCOWStorage<16, true, SBOCOWTag>;
+}
+
+TEST(StorageStats, SBOStorage_CountsInlineAndHeapConstructions)
+{
+    {
+        SBOStorage small(Small{});
+        SBOStorage large(Large{});
+        const auto stats = clang::type_erasure::storageStats<SBOTag>();
+        EXPECT_EQ( 1, stats.inline_constructions );
+        EXPECT_EQ( 1, stats.heap_constructions );
+        EXPECT_EQ( 2, stats.live_objects );
+        EXPECT_EQ( static_cast<std::int64_t>(sizeof(Small) + sizeof(Large)), stats.live_bytes );
+        ASSERT_EQ( 1u, stats.spilled_types.size() );
+        EXPECT_EQ( sizeof(Large), stats.spilled_types.front().size );
+        EXPECT_EQ( 1u, stats.spilled_types.front().count );
+        EXPECT_NE( std::string::npos, stats.spilled_types.front().name.find("Large") );
+
+        SBOStorage copy(small);
+        SBOStorage moved(std::move(large));
+        EXPECT_EQ( 1, clang::type_erasure::storageStats<SBOTag>().clones );
+        EXPECT_EQ( 3, clang::type_erasure::storageStats<SBOTag>().live_objects );
+    }
+    const auto stats = clang::type_erasure::storageStats<SBOTag>();
+    EXPECT_EQ( 0, stats.live_objects );
+    EXPECT_EQ( 0, stats.live_bytes );
+}
+
+TEST(StorageStats, SBOCOWStorage_CountsUnshares)
+{
+    {
+        SBOCOWStorage value(Large{});
+        SBOCOWStorage copy(value);
+        EXPECT_EQ( 0, clang::type_erasure::storageStats<SBOCOWTag>().clones );
+        EXPECT_EQ( 1, clang::type_erasure::storageStats<SBOCOWTag>().live_objects );
+
+        copy.get<Large>().data[0] = 'x';
+        const auto stats = clang::type_erasure::storageStats<SBOCOWTag>();
+        EXPECT_EQ( 1, stats.unshares );
+        EXPECT_EQ( 2, stats.live_objects );
+    }
+    EXPECT_EQ( 0, clang::type_erasure::storageStats<SBOCOWTag>().live_objects );
+}
+
+TEST(StorageStats, Storage_SumsCountersOfAllThreads)
+{
+    using Storage = clang::type_erasure::Storage<true, ThreadsTag>;
+    Storage value(Small{});
+    std::thread([&value]
+    {
+        Storage copy(value);
+    }).join();
+
+    const auto stats = clang::type_erasure::storageStats<ThreadsTag>();
+    EXPECT_EQ( 1, stats.heap_constructions );
+    EXPECT_EQ( 1, stats.clones );
+    EXPECT_EQ( 1, stats.live_objects );
+}
+
+TEST(StorageStats, WritesJSON)
+{
+    using Storage = clang::type_erasure::NonCopyableStorage<false, JSONTag>;
+    Storage value(Large{});
+
+    std::stringstream stream;
+    clang::type_erasure::writeStorageStats(stream);
+    const auto json = stream.str();
+    EXPECT_NE( std::string::npos, json.find("JSONTag\", \"inline_constructions\": 0, \"heap_constructions\": 1") );
+    EXPECT_NE( std::string::npos, json.find("\"size\": " + std::to_string(sizeof(Large)) + ", \"count\": 1}") );
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <TypeErasureUtil.h>
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    struct Erased
+    {
+        int type;
+        void* object;
+    };
+
+    using Range = std::pair<std::size_t, std::size_t>;
+
+    std::vector<Range> getRuns(std::vector<Erased>& objects)
+    {
+        std::vector<Range> runs;
+        type_erasure_table_detail::for_each_run(objects.data(), objects.size(),
+                                                [](const Erased& erased) { return erased.type; },
+                                                [](const Erased& erased) { return erased.object; },
+                                                [&runs, &objects](void* const* data, std::size_t first, std::size_t n)
+        {
+            for(std::size_t i = 0; i < n; ++i)
+                EXPECT_EQ( objects[first + i].object, data[i] );
+            runs.emplace_back(first, n);
+        });
+        return runs;
+    }
+}
+
+TEST( Bulk, RunsHaveTheSameImplementation )
+{
+    int a = 0, b = 1;
+    std::vector<Erased> objects{ {0, &a}, {0, &a}, {1, &b}, {0, &a} };
+
+    EXPECT_EQ( (std::vector<Range>{ {0u, 2u}, {2u, 1u}, {3u, 1u} }), getRuns(objects) );
+}
+
+TEST( Bulk, RunsAreSplitIntoChunks )
+{
+    int a = 0;
+    const auto count = 2 * type_erasure_table_detail::bulk_chunk_size + 1;
+    std::vector<Erased> objects(count, Erased{0, &a});
+
+    const auto runs = getRuns(objects);
+    ASSERT_EQ( 3u, runs.size() );
+    EXPECT_EQ( type_erasure_table_detail::bulk_chunk_size, runs[0].second );
+    EXPECT_EQ( count - 1, runs[2].first );
+    EXPECT_EQ( 1u, runs[2].second );
+}
+
+TEST( Bulk, NoRunsForNoObjects )
+{
+    std::vector<Erased> objects;
+
+    EXPECT_TRUE( getRuns(objects).empty() );
+}
+
+TEST( Bulk, ChunksUnwrapReferences )
+{
+    int value = 42;
+    std::reference_wrapper<int> reference(value);
+    const std::vector<const void*> data(type_erasure_table_detail::bulk_chunk_size + 1, &reference);
+
+    std::size_t calls = 0;
+    type_erasure_table_detail::for_each_chunk<std::reference_wrapper<int>>(data.data(), data.size(),
+                                                                            [&](const int* const* objects, std::size_t first, std::size_t n)
+    {
+        ++calls;
+        for(std::size_t i = 0; i < n; ++i)
+            EXPECT_EQ( &value, objects[i] );
+        EXPECT_EQ( first == 0 ? type_erasure_table_detail::bulk_chunk_size : 1u, n );
+    });
+    EXPECT_EQ( 2u, calls );
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <DeferredDestruction.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+
+namespace
+{
+    struct Tag;
+
+    /// Reports the thread that destroys it.
+    struct Heavy
+    {
+        explicit Heavy(std::shared_ptr<std::promise<std::thread::id>> destroyed)
+            : destroyed(std::move(destroyed))
+        {}
+
+        Heavy(Heavy&&) = default;
+
+        ~Heavy()
+        {
+            if(destroyed)
+                destroyed->set_value(std::this_thread::get_id());
+        }
+
+        std::shared_ptr<std::promise<std::thread::id>> destroyed;
+        char payload[64] = {};
+    };
+
+    struct Counted
+    {
+        explicit Counted(std::atomic<int>& destructions)
+            : destructions(&destructions)
+        {}
+
+        Counted(const Counted&) = default;
+
+        ~Counted()
+        {
+            ++*destructions;
+        }
+
+        std::atomic<int>* destructions;
+    };
+
+    using Storage = clang::type_erasure::Storage<false, clang::type_erasure::DeferredDestruction<Tag>>;
+    using COWStorage = clang::type_erasure::COWStorage<false, clang::type_erasure::DeferredDestruction<Tag>>;
+    using SBOStorage = clang::type_erasure::NonCopyableSBOStorage<16, false, clang::type_erasure::DeferredDestruction<Tag>>;
+}
+
+TEST( DeferredDestruction, HeapObjectsAreDestroyedOnAnotherThread )
+{
+    auto destroyed = std::make_shared<std::promise<std::thread::id>>();
+    auto thread = destroyed->get_future();
+    {
+        SBOStorage storage(clang::type_erasure::in_place_type<Heavy>, destroyed);
+        destroyed.reset();
+    }
+
+    ASSERT_EQ( std::future_status::ready, thread.wait_for(std::chrono::seconds(10)) );
+    EXPECT_NE( std::this_thread::get_id(), thread.get() );
+}
+
+TEST( DeferredDestruction, DrainDestroysAllQueuedObjects )
+{
+    std::atomic<int> destructions{0};
+    {
+        const COWStorage storage(clang::type_erasure::in_place_type<Counted>, destructions);
+        auto copy = storage;
+        Storage other(clang::type_erasure::in_place_type<Counted>, destructions);
+        other = Storage();
+    }
+    clang::type_erasure::drainDeferredDestruction();
+
+    EXPECT_EQ( 2, destructions.load() );
+}
+
+TEST( DeferredDestruction, InlineObjectsAreDestroyedImmediately )
+{
+    struct Small
+    {
+        ~Small()
+        {
+            destroyedOn = std::this_thread::get_id();
+        }
+
+        std::thread::id& destroyedOn;
+    };
+
+    std::thread::id destroyedOn;
+    {
+        SBOStorage storage(clang::type_erasure::in_place_type<Small>, Small{destroyedOn});
+        destroyedOn = std::thread::id();
+    }
+
+    EXPECT_EQ( std::this_thread::get_id(), destroyedOn );
+}
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include <HandleStorage.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Value
+    {
+        int value = 42;
+        std::string name = "value";
+    };
+
+    struct Other
+    {
+        int value = 7;
+    };
+
+    // as generated for struct Fooable { int foo() const; };
+    struct Table
+    {
+        int (*foo)(const void*);
+    };
+
+    template <class T>
+    int foo(const void* data)
+    {
+        return static_cast<const T*>(data)->value;
+    }
+
+    template <class T>
+    Table table()
+    {
+        return { &foo<T> };
+    }
+
+    struct Tag;
+
+    using Storage = clang::type_erasure::HandleStorage<false, Tag>;
+    using NonCopyableStorage = clang::type_erasure::NonCopyableHandleStorage<false, Tag>;
+
+    template <class Storage, class T, class... Args>
+    Storage make(Args&&... args)
+    {
+        return Storage(clang::type_erasure::in_place_type<T>, table<T>(), std::forward<Args>(args)...);
+    }
+}
+
+TEST( HandleStorage, HoldsA32BitHandle )
+{
+    EXPECT_EQ( sizeof(std::uint32_t), sizeof(Storage) );
+    EXPECT_EQ( sizeof(std::uint32_t), sizeof(NonCopyableStorage) );
+}
+
+TEST( HandleStorage, ResolvesTypeAndFunctionTableThroughTheRegistry )
+{
+    const auto value = make<Storage, Value>();
+    const auto other = make<Storage, Other>();
+
+    EXPECT_EQ( 42, value.functions<Table>().foo(value.object()) );
+    EXPECT_EQ( 7, other.functions<Table>().foo(other.object()) );
+    EXPECT_TRUE( value.is<Value>() );
+    EXPECT_EQ( nullptr, value.target<Other>() );
+    EXPECT_EQ( "value", value.get<Value>().name );
+    EXPECT_FALSE( Storage() );
+    EXPECT_EQ( nullptr, Storage().type() );
+}
+
+TEST( HandleStorage, CopiesUseAnotherSlotOfTheSlab )
+{
+    auto storage = make<Storage, Value>();
+    auto copy = storage;
+    copy.get<Value>().value = 1;
+
+    EXPECT_EQ( 42, storage.get<Value>().value );
+    EXPECT_EQ( 1, copy.functions<Table>().foo(copy.object()) );
+    EXPECT_EQ( storage.type(), copy.type() );
+
+    storage = std::move(copy);
+    EXPECT_FALSE( copy );
+    EXPECT_EQ( 1, storage.get<Value>().value );
+}
+
+TEST( HandleStorage, SlotsAreReused )
+{
+    const void* object = nullptr;
+    {
+        const auto storage = make<NonCopyableStorage, Other>();
+        object = storage.object();
+    }
+    const auto storage = make<NonCopyableStorage, Other>();
+    EXPECT_EQ( object, storage.object() );
+}
+
+TEST( HandleStorage, SlabsAreIteratedInSlotOrder )
+{
+    struct Counted
+    {
+        int value;
+    };
+
+    std::vector<NonCopyableStorage> storages;
+    for(int i = 0; i < 5000; ++i)
+        storages.emplace_back(clang::type_erasure::in_place_type<Counted>, table<Counted>(), Counted{i});
+    storages.erase(storages.begin() + 10);
+
+    auto expected = 0;
+    clang::type_erasure::forEachInSlab<Tag, Counted>([&expected](Counted& counted)
+    {
+        if(expected == 10)
+            ++expected;
+        EXPECT_EQ( expected++, counted.value );
+    });
+    EXPECT_EQ( 5000, expected );
+    EXPECT_EQ( 4999, storages.back().functions<Table>().foo(storages.back().object()) );
+}
+
+TEST( HandleStorage, StoresMoveOnlyTypes )
+{
+    using Pointer = std::unique_ptr<int>;
+    const NonCopyableStorage storage(clang::type_erasure::in_place_type<Pointer>, Table{nullptr},
+                                     std::make_unique<int>(7));
+    EXPECT_EQ( 7, *storage.get<Pointer>() );
+}
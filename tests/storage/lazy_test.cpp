@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+
+#include <Storage.h>
+#include <Lazy.h>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    struct Counter
+    {
+        int value() const
+        {
+            return count;
+        }
+
+        void add(int increment)
+        {
+            count += increment;
+        }
+
+        int count = 0;
+    };
+
+    // as generated with '-custom -sbo -lazy', resp. '-custom -non-copyable -sbo -lazy', for
+    // struct Countable { int value() const; void add(int); };
+    namespace CountableDetail
+    {
+        template <class Interface>
+        struct Table
+        {
+            using value_function = int (*)(const void*);
+            value_function value;
+            using add_int_function = void (*)(void*, int);
+            add_int_function add_int;
+        };
+
+        template <class Interface, class Impl>
+        struct execution_wrapper
+        {
+            static int value(const void* data)
+            {
+                return type_erasure_table_detail::object_access<Impl>::get(data).value();
+            }
+
+            static void add_int(void* data, int increment)
+            {
+                type_erasure_table_detail::object_access<Impl>::get(data).add(increment);
+            }
+        };
+
+        template <class T>
+        using Concept = std::is_same<type_erasure_table_detail::remove_reference_wrapper_t<T>, Counter>;
+    }
+
+    template <class Storage>
+    class BasicCountable
+    {
+    public:
+        BasicCountable() noexcept = default;
+
+        template <class T,
+                  std::enable_if_t<CountableDetail::Concept<std::decay_t<T>>::value>* = nullptr>
+        BasicCountable(T&& value)
+            : function_({ &CountableDetail::execution_wrapper<BasicCountable, std::decay_t<T>>::value,
+                          &CountableDetail::execution_wrapper<BasicCountable, std::decay_t<T>>::add_int }),
+              impl_(std::forward<T>(value))
+        {}
+
+        int value() const
+        {
+            return function_.value(impl_.object());
+        }
+
+        void add(int increment)
+        {
+            function_.add_int(impl_.object(), increment);
+        }
+
+        template <class T>
+        const T* target() const noexcept
+        {
+            return impl_.template target<T>();
+        }
+
+    private:
+        CountableDetail::Table<BasicCountable> function_;
+        Storage impl_;
+    };
+
+    struct Tag;
+
+    using Countable = BasicCountable<clang::type_erasure::SBOStorage<64, false, Tag>>;
+    using NonCopyableCountable = BasicCountable<clang::type_erasure::NonCopyableSBOStorage<64, false, Tag>>;
+
+    struct CountingFactory
+    {
+        Counter operator()() const
+        {
+            ++*calls;
+            return Counter{42};
+        }
+
+        std::atomic<int>* calls;
+    };
+
+    using LazyCounter = clang::type_erasure::Lazy<Counter, CountingFactory>;
+
+    // the implementation replaces the factory, only a state byte is added
+    static_assert(sizeof(LazyCounter) <= sizeof(CountingFactory) + alignof(CountingFactory),
+                  "lazy implementations do not reserve space for both factory and implementation");
+
+    struct FailingFactory
+    {
+        Counter operator()() const
+        {
+            if(++*calls == 1)
+                throw std::runtime_error("not yet");
+            return Counter{42};
+        }
+
+        std::atomic<int>* calls;
+    };
+}
+
+TEST( Lazy, FactoryIsCalledOnFirstCall )
+{
+    std::atomic<int> calls{0};
+    Countable countable = clang::type_erasure::lazy<Counter>(CountingFactory{&calls});
+    ASSERT_NE( nullptr, countable.target<LazyCounter>() );
+    EXPECT_FALSE( countable.target<LazyCounter>()->built() );
+    EXPECT_EQ( 0, calls );
+
+    countable.add(1);
+    EXPECT_EQ( 43, countable.value() );
+    EXPECT_TRUE( countable.target<LazyCounter>()->built() );
+    EXPECT_EQ( 1, calls );
+}
+
+TEST( Lazy, ConcurrentFirstCallsBuildOnce )
+{
+    std::atomic<int> calls{0};
+    const Countable countable = clang::type_erasure::lazy<Counter>(CountingFactory{&calls});
+
+    std::atomic<int> sum{0};
+    std::vector<std::thread> threads;
+    for(auto i = 0; i < 8; ++i)
+        threads.emplace_back([&] { sum += countable.value(); });
+    for(auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ( 8 * 42, sum );
+    EXPECT_EQ( 1, calls );
+}
+
+TEST( Lazy, CopiesOfUnbuiltImplementationsStayLazy )
+{
+    std::atomic<int> calls{0};
+    const Countable countable = clang::type_erasure::lazy<Counter>(CountingFactory{&calls});
+    auto copy = countable;
+    EXPECT_EQ( 0, calls );
+
+    copy.add(1);
+    EXPECT_EQ( 1, calls );
+    EXPECT_FALSE( countable.target<LazyCounter>()->built() );
+
+    auto built = copy;
+    EXPECT_EQ( 43, built.value() );
+    EXPECT_EQ( 42, countable.value() );
+    EXPECT_EQ( 2, calls );
+}
+
+TEST( Lazy, FactoriesCanBeMoveOnly )
+{
+    auto count = std::make_unique<int>(42);
+    auto factory = [count = std::move(count)] { return Counter{*count}; };
+    static_assert(std::is_nothrow_move_constructible<clang::type_erasure::Lazy<Counter, decltype(factory)>>::value,
+                  "lazy implementations are relocated in the noexcept moves of the storages");
+
+    NonCopyableCountable countable = clang::type_erasure::lazy<Counter>(std::move(factory));
+    auto moved = std::move(countable);
+    EXPECT_EQ( 42, moved.value() );
+
+    auto built = std::move(moved);
+    built.add(1);
+    EXPECT_EQ( 43, built.value() );
+}
+
+TEST( Lazy, FailedBuildsAreRetried )
+{
+    std::atomic<int> calls{0};
+    const Countable countable = clang::type_erasure::lazy<Counter>(FailingFactory{&calls});
+
+    EXPECT_THROW( countable.value(), std::runtime_error );
+    EXPECT_EQ( 42, countable.value() );
+    EXPECT_EQ( 2, calls );
+}
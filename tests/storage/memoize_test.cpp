@@ -0,0 +1,42 @@
+#include <gtest/gtest.h>
+
+#include <Memoize.h>
+
+namespace
+{
+    template <class Policy>
+    using Cache = clang::type_erasure::MemoCache<Policy, 2, int, int>;
+
+    template <class Policy>
+    int lookup(const Cache<Policy>& cache, int key, int& computed)
+    {
+        return cache.get([&] { ++computed; return 2 * key; }, key);
+    }
+}
+
+TEST( Memoize, LruPolicyRenewsHits )
+{
+    const Cache<clang::type_erasure::LruPolicy> cache;
+    auto computed = 0;
+    lookup(cache, 1, computed);
+    lookup(cache, 2, computed);
+    lookup(cache, 1, computed);
+    lookup(cache, 3, computed);
+
+    EXPECT_EQ( 2, cache.size() );
+    EXPECT_EQ( 2, lookup(cache, 1, computed) );
+    EXPECT_EQ( 3, computed );
+}
+
+TEST( Memoize, FifoPolicyEvictsTheOldestEntry )
+{
+    const Cache<clang::type_erasure::FifoPolicy> cache;
+    auto computed = 0;
+    lookup(cache, 1, computed);
+    lookup(cache, 2, computed);
+    lookup(cache, 1, computed);
+    lookup(cache, 3, computed);
+
+    EXPECT_EQ( 2, lookup(cache, 1, computed) );
+    EXPECT_EQ( 4, computed );
+}
@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+
+#include <Storage.h>
+
+#include <utility>
+
+namespace
+{
+    struct Counter
+    {
+        int value() const
+        {
+            return count;
+        }
+
+        int count = 0;
+    };
+}
+
+TEST( NullObject, EmptyStoragesReferToTheEmptyTable )
+{
+    using SBOStorage = clang::type_erasure::SBOStorage<16, false>;
+    using SBOCOWStorage = clang::type_erasure::SBOCOWStorage<16, false>;
+
+    const SBOStorage empty{};
+    auto copy = empty;
+    SBOStorage storage(Counter{});
+    storage = std::move(copy);
+    SBOCOWStorage shared;
+    shared = SBOCOWStorage(Counter{});
+    shared = SBOCOWStorage();
+
+    EXPECT_FALSE( storage );
+    EXPECT_EQ( nullptr, storage.type() );
+    EXPECT_FALSE( copy );
+    EXPECT_FALSE( shared );
+    EXPECT_EQ( nullptr, shared.type() );
+}
@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+
+#include <Storage.h>
+
+#include <cassert>
+#include <type_traits>
+
+namespace
+{
+    struct Counter
+    {
+        int foo() const
+        {
+            return value;
+        }
+
+        void bar(int increment)
+        {
+            value += increment;
+        }
+
+        int value = 0;
+    };
+
+    // as generated with '-custom -refs' for
+    // struct Fooable { int foo() const; };
+    // struct Barable { void bar(int); };
+    // struct FooableBarable : Fooable, Barable {};
+    namespace FooableDetail
+    {
+        struct Table
+        {
+            int (*foo)(const void*);
+        };
+    }
+
+    namespace BarableDetail
+    {
+        struct Table
+        {
+            void (*bar)(void*, int);
+        };
+    }
+
+    namespace FooableBarableDetail
+    {
+        struct Table
+        {
+            FooableDetail::Table Fooable_table;
+            BarableDetail::Table Barable_table;
+        };
+
+        template <class Impl>
+        int foo(const void* data)
+        {
+            return static_cast<const Impl*>(data)->foo();
+        }
+
+        template <class Impl>
+        void bar(void* data, int increment)
+        {
+            static_cast<Impl*>(data)->bar(increment);
+        }
+    }
+
+    class FooableRef
+    {
+    public:
+        FooableRef(const FooableDetail::Table& table, void* object) noexcept
+            : table_(&table), object_(object)
+        {}
+
+        explicit operator bool() const noexcept
+        {
+            return object_ != nullptr;
+        }
+
+        void* object() const noexcept
+        {
+            return object_;
+        }
+
+        int foo() const
+        {
+            assert(*this);
+            return (*table_).foo((*this).object());
+        }
+
+    private:
+        const FooableDetail::Table* table_;
+        void* object_;
+    };
+
+    class BarableRef
+    {
+    public:
+        BarableRef(const BarableDetail::Table& table, void* object) noexcept
+            : table_(&table), object_(object)
+        {}
+
+        explicit operator bool() const noexcept
+        {
+            return object_ != nullptr;
+        }
+
+        void* object() const noexcept
+        {
+            return object_;
+        }
+
+        void bar(int increment)
+        {
+            assert(*this);
+            (*table_).bar((*this).object(), increment);
+        }
+
+    private:
+        const BarableDetail::Table* table_;
+        void* object_;
+    };
+
+    class FooableBarable
+    {
+    public:
+        template <class T,
+                  std::enable_if_t<!std::is_same<std::decay_t<T>, FooableBarable>::value>* = nullptr>
+        FooableBarable(T&& value)
+            : function_({ { &FooableBarableDetail::foo<std::decay_t<T>> },
+                          { &FooableBarableDetail::bar<std::decay_t<T>> } }),
+              impl_(std::forward<T>(value))
+        {}
+
+        int foo() const
+        {
+            assert(impl_);
+            return function_.Fooable_table.foo(impl_.object());
+        }
+
+        void bar(int increment)
+        {
+            assert(impl_);
+            function_.Barable_table.bar(impl_.object(), increment);
+        }
+
+        operator FooableRef() &
+        {
+            return FooableRef(function_.Fooable_table, impl_.object());
+        }
+
+        operator BarableRef() &
+        {
+            return BarableRef(function_.Barable_table, impl_.object());
+        }
+
+    private:
+        FooableBarableDetail::Table function_;
+        clang::type_erasure::COWStorage<false, FooableBarable> impl_;
+    };
+
+    int useFooable(FooableRef fooable)
+    {
+        return fooable.foo();
+    }
+
+    void useBarable(BarableRef barable)
+    {
+        barable.bar(2);
+    }
+}
+
+TEST( Refs, ViewsOfAllBasesShareTheObject )
+{
+    FooableBarable combined = Counter{40};
+    useBarable(combined);
+
+    EXPECT_EQ( 42, useFooable(combined) );
+    EXPECT_EQ( 42, combined.foo() );
+    EXPECT_EQ( static_cast<FooableRef>(combined).object(), static_cast<BarableRef>(combined).object() );
+}
+
+TEST( Refs, ViewsOfCopyOnWriteInterfacesUnshareTheObject )
+{
+    FooableBarable combined = Counter{40};
+    const auto copy = combined;
+    BarableRef barable = combined;
+    barable.bar(2);
+
+    EXPECT_EQ( 42, combined.foo() );
+    EXPECT_EQ( 40, copy.foo() );
+}
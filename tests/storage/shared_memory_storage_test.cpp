@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+
+#include <SharedMemoryStorage.h>
+
+#ifdef __linux__
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <cstdint>
+
+namespace
+{
+    struct Job
+    {
+        int run() const
+        {
+            return id * 2;
+        }
+
+        int id;
+    };
+
+    struct Reply
+    {
+        int run() const
+        {
+            return value;
+        }
+
+        int value;
+    };
+
+    // as generated for struct Runnable { int run() const; };
+    struct Table
+    {
+        int (*run)(const void*);
+    };
+
+    template <class T>
+    int run(const void* data)
+    {
+        return static_cast<const T*>(data)->run();
+    }
+
+    template <class T>
+    Table table()
+    {
+        return { &run<T> };
+    }
+
+    struct Tag;
+    // types are registered per tag, the processes start without registered types
+    struct ProcessTag;
+
+    using Storage = clang::type_erasure::SharedMemoryStorage<false, Tag>;
+    using ProcessStorage = clang::type_erasure::SharedMemoryStorage<false, ProcessTag>;
+
+    template <class StorageType>
+    int call(const StorageType& storage)
+    {
+        return storage.template functions<Table>().run(storage.object());
+    }
+
+    // the storages handed over between the processes
+    struct Mailbox
+    {
+        ProcessStorage job;
+        ProcessStorage reply;
+    };
+
+#ifdef __linux__
+    // closes the ends of the pipes of the parent and stops the child unless it has been waited
+    // for, such that it does not wait for the parent forever if an assertion fails
+    struct ChildProcess
+    {
+        ~ChildProcess()
+        {
+            close(toChild);
+            close(toParent);
+            if(pid != 0)
+            {
+                kill(pid, SIGKILL);
+                waitpid(pid, nullptr, 0);
+            }
+        }
+
+        pid_t pid;
+        int toChild;
+        int toParent;
+    };
+#endif
+
+    constexpr std::size_t regionSize = 1 << 16;
+}
+
+TEST( SharedMemoryStorage, StoresOffsetsAndTypeIds )
+{
+    alignas(16) static char region[regionSize];
+    clang::type_erasure::useSharedArena<Tag>(clang::type_erasure::SharedArena::create(region, sizeof(region)));
+
+    const Storage storage(clang::type_erasure::in_place_type<Job>, table<Job>(), Job{21});
+    auto copy = storage;
+
+    EXPECT_EQ( 2 * sizeof(std::uint64_t), sizeof(Storage) );
+    EXPECT_EQ( 42, call(copy) );
+    EXPECT_TRUE( copy.is<Job>() );
+    EXPECT_FALSE( copy.is<Reply>() );
+    EXPECT_EQ( storage.type(), copy.type() );
+    EXPECT_NE( storage.object(), static_cast<const Storage&>(copy).object() );
+
+    // freed blocks are reused
+    const auto object = static_cast<const Storage&>(copy).object();
+    copy = Storage();
+    const Storage reply(clang::type_erasure::in_place_type<Reply>, table<Reply>(), Reply{1});
+    EXPECT_EQ( object, reply.object() );
+}
+
+#ifdef __linux__
+TEST( SharedMemoryStorage, ObjectsAreSharedBetweenProcesses )
+{
+    const auto fd = memfd_create("shared_memory_storage_test", 0);
+    ASSERT_NE( -1, fd );
+    ASSERT_EQ( 0, ftruncate(fd, regionSize) );
+    int toChild[2];
+    int toParent[2];
+    ASSERT_EQ( 0, pipe(toChild) );
+    ASSERT_EQ( 0, pipe(toParent) );
+    char signal = 0;
+
+    // the child is forked before any type is registered for ProcessTag and maps the region at
+    // another address
+    const auto child = fork();
+    ASSERT_NE( -1, child );
+    if(child == 0)
+    {
+        close(toChild[1]);
+        close(toParent[0]);
+        auto result = 1;
+        std::uint64_t offset = 0;
+        if(read(toChild[0], &offset, sizeof(offset)) == sizeof(offset))
+        {
+            const auto region = mmap(nullptr, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            const auto arena = clang::type_erasure::SharedArena::attach(region);
+            clang::type_erasure::useSharedArena<ProcessTag>(arena);
+            ProcessStorage::registerType<Job>(table<Job>());
+            auto& mailbox = *static_cast<Mailbox*>(arena.data(offset));
+
+            const auto answer = call(mailbox.job);
+            mailbox.reply = ProcessStorage(clang::type_erasure::in_place_type<Reply>, table<Reply>(), Reply{answer + 1});
+            result = answer == 42 && mailbox.job.is<Job>() ? 0 : 2;
+        }
+        if(write(toParent[1], &signal, 1) != 1)
+            result = 3;
+        _exit(result);
+    }
+    close(toChild[0]);
+    close(toParent[1]);
+    ChildProcess guard{child, toChild[1], toParent[0]};
+
+    const auto region = mmap(nullptr, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ASSERT_NE( MAP_FAILED, region );
+    auto arena = clang::type_erasure::SharedArena::create(region, regionSize);
+    clang::type_erasure::useSharedArena<ProcessTag>(arena);
+    const auto offset = arena.allocate(sizeof(Mailbox));
+    auto& mailbox = *new (arena.data(offset)) Mailbox();
+    mailbox.job = ProcessStorage(clang::type_erasure::in_place_type<Job>, table<Job>(), Job{21});
+    ProcessStorage::registerType<Reply>(table<Reply>());
+
+    ASSERT_EQ( static_cast<ssize_t>(sizeof(offset)), write(toChild[1], &offset, sizeof(offset)) );
+    ASSERT_EQ( 1, read(toParent[0], &signal, 1) );
+    int status = 0;
+    ASSERT_EQ( child, waitpid(child, &status, 0) );
+    guard.pid = 0;
+    ASSERT_TRUE( WIFEXITED(status) );
+    EXPECT_EQ( 0, WEXITSTATUS(status) );
+
+    EXPECT_EQ( 43, call(mailbox.reply) );
+    EXPECT_EQ( 42, call(mailbox.job) );
+
+    mailbox.~Mailbox();
+    arena.deallocate(offset);
+    munmap(region, regionSize);
+    close(fd);
+}
+#endif
@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include <Storage.h>
+
+#include <array>
+#include <utility>
+
+#include "../util.hh"
+
+namespace
+{
+    struct Small
+    {
+        int value = 42;
+    };
+
+    struct Large
+    {
+        std::array<int, 64> data{};
+    };
+
+    /// Small, but not trivially copyable, as it refers to itself.
+    struct SelfReferencing
+    {
+        SelfReferencing() = default;
+
+        SelfReferencing(const SelfReferencing& other)
+            : value(other.value)
+        {}
+
+        bool valid() const
+        {
+            return self == this;
+        }
+
+        const SelfReferencing* self = this;
+        int value = 42;
+    };
+
+    /// Small, but its move constructor may throw.
+    struct ThrowingMove
+    {
+        ThrowingMove() = default;
+        ThrowingMove(const ThrowingMove&) = default;
+
+        ThrowingMove(ThrowingMove&& other) noexcept(false)
+            : value(other.value)
+        {}
+
+        int value = 42;
+    };
+
+    struct alignas(64) OverAligned
+    {
+        int value = 42;
+    };
+
+    // what the storages and the constructors generated with '-inline-only' check
+    template <class T>
+    using FitsIntoBuffer = clang::type_erasure::detail::FitsIntoBuffer<T, clang::type_erasure::detail::SmallBuffer<64>>;
+
+    static_assert(FitsIntoBuffer<Small>::value, "small objects are buffered");
+    static_assert(!FitsIntoBuffer<OverAligned>::value, "over-aligned objects are stored on the heap");
+    static_assert(!FitsIntoBuffer<ThrowingMove>::value, "objects with throwing moves are stored on the heap");
+
+    struct Tag;
+
+    using HeapStorage = clang::type_erasure::Storage<true, Tag>;
+    using COWStorage = clang::type_erasure::COWStorage<true, Tag>;
+    using SBOStorage = clang::type_erasure::SBOStorage<32, true, Tag>;
+    using SBOCOWStorage = clang::type_erasure::SBOCOWStorage<32, true, Tag>;
+    using NonCopyableStorage = clang::type_erasure::NonCopyableStorage<true, Tag>;
+    using NonCopyableSBOStorage = clang::type_erasure::NonCopyableSBOStorage<32, true, Tag>;
+
+    static_assert(std::is_constructible<NonCopyableStorage, COWStorage&&>::value,
+                  "copyable storages can hand over their objects to non-copyable storages");
+    static_assert(!std::is_constructible<COWStorage, NonCopyableStorage&&>::value,
+                  "non-copyable storages can not hand over their objects to copyable storages");
+    static_assert(!std::is_constructible<COWStorage, SBOStorage&>::value,
+                  "objects are only handed over in converting moves");
+}
+
+TEST( StorageTransfer, HeapObjectIsHandedOverWithoutAllocation )
+{
+    SBOStorage storage(Large{});
+    const auto object = storage.target<Large>();
+
+    CHECK_HEAP_ALLOC( COWStorage cow(std::move(storage)),
+                      0u );
+    EXPECT_FALSE( storage );
+    EXPECT_EQ( object, cow.target<Large>() );
+
+    CHECK_HEAP_ALLOC( NonCopyableSBOStorage non_copyable(std::move(cow)),
+                      0u );
+    EXPECT_FALSE( cow );
+    EXPECT_EQ( object, non_copyable.target<Large>() );
+}
+
+TEST( StorageTransfer, BufferedObjectIsRelocated )
+{
+    SBOStorage storage(SelfReferencing{});
+
+    CHECK_HEAP_ALLOC( SBOCOWStorage sbo_cow(std::move(storage)),
+                      0u );
+    EXPECT_FALSE( storage );
+    ASSERT_TRUE( sbo_cow );
+    EXPECT_TRUE( sbo_cow.get<SelfReferencing>().valid() );
+    EXPECT_EQ( 42, sbo_cow.get<SelfReferencing>().value );
+
+    CHECK_HEAP_ALLOC( NonCopyableSBOStorage non_copyable(std::move(sbo_cow)),
+                      0u );
+    ASSERT_TRUE( non_copyable );
+    EXPECT_TRUE( non_copyable.get<SelfReferencing>().valid() );
+}
+
+TEST( StorageTransfer, BufferedObjectIsMovedToTheHeap )
+{
+    SBOStorage storage(Small{});
+
+    CHECK_HEAP_ALLOC( HeapStorage heap(std::move(storage)),
+                      1u );
+    EXPECT_FALSE( storage );
+    ASSERT_TRUE( heap );
+    EXPECT_EQ( 42, heap.get<Small>().value );
+}
+
+TEST( StorageTransfer, ObjectWithThrowingMoveIsNotBuffered )
+{
+    SBOStorage storage(ThrowingMove{});
+    const auto object = storage.target<ThrowingMove>();
+
+    CHECK_HEAP_ALLOC( SBOStorage moved(std::move(storage)),
+                      0u );
+    EXPECT_EQ( object, moved.target<ThrowingMove>() );
+
+    HeapStorage heap(ThrowingMove{});
+    const auto other = heap.target<ThrowingMove>();
+    CHECK_HEAP_ALLOC( NonCopyableSBOStorage non_copyable(std::move(heap)),
+                      0u );
+    EXPECT_EQ( other, non_copyable.target<ThrowingMove>() );
+    EXPECT_EQ( 42, non_copyable.get<ThrowingMove>().value );
+}
+
+TEST( StorageTransfer, SharedObjectIsCopied )
+{
+    COWStorage cow(Large{});
+    const COWStorage copy(cow);
+
+    CHECK_HEAP_ALLOC( SBOStorage storage(std::move(cow)),
+                      1u );
+    EXPECT_FALSE( cow );
+    EXPECT_NE( copy.target<Large>(), storage.target<Large>() );
+
+    storage.get<Large>().data[0] = 1;
+    EXPECT_EQ( 0, copy.get<Large>().data[0] );
+}
+
+TEST( StorageTransfer, SharedObjectIsSharedWithCopyOnWriteStorages )
+{
+    SBOCOWStorage sbo_cow(Large{});
+    const SBOCOWStorage copy(sbo_cow);
+
+    CHECK_HEAP_ALLOC( COWStorage cow(std::move(sbo_cow)),
+                      0u );
+    EXPECT_EQ( copy.target<Large>(), static_cast<const COWStorage&>(cow).target<Large>() );
+
+    cow.get<Large>().data[0] = 1;
+    EXPECT_EQ( 0, copy.get<Large>().data[0] );
+}
+
+TEST( StorageTransfer, Empty )
+{
+    SBOStorage storage;
+
+    CHECK_HEAP_ALLOC( NonCopyableStorage non_copyable(std::move(storage)),
+                      0u );
+    EXPECT_FALSE( non_copyable );
+}
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include <ThinStorage.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace
+{
+    struct Value
+    {
+        int value = 42;
+        std::string name = "value";
+    };
+
+    // as generated for struct Fooable { int foo() const; };
+    struct Table
+    {
+        int (*foo)(const void*);
+    };
+
+    template <class T>
+    int foo(const void* data)
+    {
+        return static_cast<const T*>(data)->value;
+    }
+
+    template <class T>
+    Table table()
+    {
+        return { &foo<T> };
+    }
+
+    struct Tag;
+
+    using Storage = clang::type_erasure::ThinStorage<false, Tag>;
+    using COWStorage = clang::type_erasure::ThinCOWStorage<false, Tag>;
+    using NonCopyableStorage = clang::type_erasure::NonCopyableThinStorage<false, Tag>;
+
+    template <class Storage, class T, class... Args>
+    Storage make(Args&&... args)
+    {
+        return Storage(clang::type_erasure::in_place_type<T>, table<T>(), std::forward<Args>(args)...);
+    }
+}
+
+TEST( ThinStorage, HoldsASinglePointer )
+{
+    EXPECT_EQ( sizeof(void*), sizeof(Storage) );
+    EXPECT_EQ( sizeof(void*), sizeof(COWStorage) );
+    EXPECT_EQ( sizeof(void*), sizeof(NonCopyableStorage) );
+}
+
+TEST( ThinStorage, CallsTheFunctionTableOfTheDescriptor )
+{
+    const auto storage = make<Storage, Value>();
+
+    ASSERT_TRUE( bool(storage) );
+    EXPECT_EQ( 42, storage.functions<Table>().foo(storage.object()) );
+    EXPECT_TRUE( storage.is<Value>() );
+    EXPECT_EQ( "value", storage.get<Value>().name );
+    EXPECT_FALSE( Storage() );
+    EXPECT_EQ( nullptr, Storage().type() );
+}
+
+TEST( ThinStorage, CopiesAreDeep )
+{
+    auto storage = make<Storage, Value>();
+    auto copy = storage;
+    copy.get<Value>().value = 1;
+
+    EXPECT_EQ( 42, storage.get<Value>().value );
+    EXPECT_EQ( 1, copy.functions<Table>().foo(copy.object()) );
+    EXPECT_EQ( storage.type(), copy.type() );
+
+    storage = copy;
+    EXPECT_EQ( 1, storage.get<Value>().value );
+    EXPECT_NE( storage.object(), copy.object() );
+}
+
+TEST( ThinStorage, CopyOnWriteSharesUntilModified )
+{
+    const auto storage = make<COWStorage, Value>();
+    auto copy = storage;
+
+    EXPECT_EQ( storage.object(), static_cast<const COWStorage&>(copy).object() );
+    copy.get<Value>().value = 1;
+    EXPECT_NE( storage.object(), static_cast<const COWStorage&>(copy).object() );
+    EXPECT_EQ( 42, storage.get<Value>().value );
+    EXPECT_EQ( 1, copy.functions<Table>().foo(copy.object()) );
+}
+
+TEST( ThinStorage, MovesTransferTheBlock )
+{
+    auto storage = make<NonCopyableStorage, Value>();
+    const auto object = static_cast<const NonCopyableStorage&>(storage).object();
+
+    NonCopyableStorage moved(std::move(storage));
+    EXPECT_FALSE( storage );
+    EXPECT_EQ( object, static_cast<const NonCopyableStorage&>(moved).object() );
+
+    storage = std::move(moved);
+    EXPECT_EQ( 42, storage.functions<Table>().foo(storage.object()) );
+}
+
+TEST( ThinStorage, StoresMoveOnlyTypesAndReferences )
+{
+    using Pointer = std::unique_ptr<int>;
+    auto storage = NonCopyableStorage(clang::type_erasure::in_place_type<Pointer>, Table{nullptr},
+                                      std::make_unique<int>(7));
+    EXPECT_EQ( 7, *storage.get<Pointer>() );
+
+    Value value;
+    const Storage reference(clang::type_erasure::in_place_type<std::reference_wrapper<Value>>, Table{nullptr},
+                            std::ref(value));
+    EXPECT_EQ( &value, reference.target<Value>() );
+}
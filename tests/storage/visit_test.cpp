@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <Storage.h>
+#include <TypeErasureUtil.h>
+
+#include <array>
+#include <functional>
+#include <type_traits>
+
+namespace
+{
+    struct Small
+    {
+        int value = 42;
+    };
+
+    struct Large
+    {
+        std::array<int, 64> data{};
+    };
+
+    struct Tag;
+
+    using Storage = clang::type_erasure::SBOStorage<16, false, Tag>;
+    using COWStorage = clang::type_erasure::COWStorage<false, Tag>;
+
+    static_assert(std::is_empty<clang::type_erasure::Accessor<Storage, false>>::value,
+                  "the stored type is only known to the object table");
+
+    auto visitor = clang::type_erasure::overload([](const Small& small) { return small.value; },
+                                                 [](const Large& large) { return large.data.front(); });
+
+    auto fallback = [](const Storage&) { return -1; };
+}
+
+TEST( Visit, TypeQueriesDoNotRequireRTTI )
+{
+    const Storage storage(Small{});
+
+    EXPECT_TRUE( storage.is<Small>() );
+    EXPECT_FALSE( storage.is<Large>() );
+    EXPECT_FALSE( Storage().is<Small>() );
+    EXPECT_EQ( nullptr, storage.target<Large>() );
+    ASSERT_NE( nullptr, storage.target<Small>() );
+    EXPECT_EQ( 42, storage.target<Small>()->value );
+}
+
+TEST( Visit, TypeQueriesSeeThroughReferenceWrappers )
+{
+    Small small;
+    Storage storage(std::ref(small));
+
+    EXPECT_TRUE( storage.is<Small>() );
+    EXPECT_EQ( &small, storage.target<Small>() );
+    EXPECT_EQ( &small, &storage.get<Small>() );
+    // as the thunks access arguments of the interface type, which store the same type
+    EXPECT_EQ( &small, &type_erasure_table_detail::object_access<std::reference_wrapper<Small>>::get(storage.object()) );
+}
+
+TEST( Visit, TypeIsSharedBetweenStorages )
+{
+    const Storage storage(Large{});
+    const COWStorage cow(Large{});
+
+    EXPECT_EQ( storage.type(), cow.type() );
+    EXPECT_NE( storage.type(), Storage(Small{}).type() );
+    EXPECT_EQ( nullptr, Storage().type() );
+}
+
+TEST( Visit, ExpectedTypesAreVisited )
+{
+    Large large;
+    large.data.front() = 7;
+
+    EXPECT_EQ( 42, (clang::type_erasure::visit<Small, Large>(Storage(Small{}), visitor, fallback)) );
+    EXPECT_EQ( 7, (clang::type_erasure::visit<Small, Large>(Storage(large), visitor, fallback)) );
+}
+
+TEST( Visit, OtherTypesAreHandedToTheFallback )
+{
+    const Storage storage(Large{});
+
+    EXPECT_EQ( -1, clang::type_erasure::visit<Small>(storage, visitor, fallback) );
+    EXPECT_EQ( -1, clang::type_erasure::visit<Small>(Storage(), visitor, fallback) );
+}
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include <ActiveObject.h>
+#include <Storage.h>
+
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr int n_threads = 8;
+    constexpr int n_iterations = 2000;
+
+    // not thread-safe, all calls run on the thread of the active object
+    struct Counter
+    {
+        int add(int value)
+        {
+            count += value;
+            return count;
+        }
+
+        int get() const
+        {
+            if(count < 0)
+                throw std::runtime_error("negative count");
+            return count;
+        }
+
+        int count = 0;
+    };
+
+    // stands in for an interface with 'int add(int);' and 'int get() const;'
+    class Countable
+    {
+    public:
+        explicit Countable(int count = 0)
+            : impl_(Counter{count})
+        {}
+
+        int add(int value)
+        {
+            return impl_.get<Counter>().add(value);
+        }
+
+        int get() const
+        {
+            return impl_.get<Counter>().get();
+        }
+
+    private:
+        clang::type_erasure::Storage<false> impl_;
+    };
+
+    // as generated with '-active-object'
+    class ActiveCountable
+    {
+    public:
+        explicit ActiveCountable(Countable value)
+            : active_(std::move(value))
+        {}
+
+        std::future<int> add(int value)
+        {
+            return active_.call([value = std::move(value)](Countable& object) mutable { return object.add(std::move(value)); });
+        }
+
+        template <class Done>
+        void add(int value, Done done)
+        {
+            active_.post([value = std::move(value)](Countable& object) mutable { return object.add(std::move(value)); }, std::move(done));
+        }
+
+        std::future<int> get()
+        {
+            return active_.call([](Countable& object) mutable { return object.get(); });
+        }
+
+        template <class Done>
+        void get(Done done)
+        {
+            active_.post([](Countable& object) mutable { return object.get(); }, std::move(done));
+        }
+
+    private:
+        clang::type_erasure::ActiveObject<Countable> active_;
+    };
+}
+
+TEST( ActiveObjectStress, FuturesAndCallbacksFromManyThreads )
+{
+    std::atomic<int> completed{0};
+    {
+        ActiveCountable counter{Countable()};
+        std::vector<std::thread> threads;
+        for(int i = 0; i < n_threads; ++i)
+            threads.emplace_back([&counter, &completed, i]
+            {
+                for(int j = 0; j < n_iterations; ++j)
+                {
+                    if(i % 2 == 0)
+                        EXPECT_GT( counter.add(1).get(), 0 );
+                    else
+                        counter.add(1, [&completed](int count) { EXPECT_GT( count, 0 ); ++completed; });
+                }
+            });
+        for(auto& thread : threads)
+            thread.join();
+
+        EXPECT_EQ( n_threads * n_iterations, counter.get().get() );
+    }
+    // the destructor runs the remaining callbacks
+    EXPECT_EQ( n_threads / 2 * n_iterations, completed );
+}
+
+TEST( ActiveObjectStress, FuturesHoldExceptions )
+{
+    ActiveCountable counter{Countable(-1)};
+    auto count = counter.get();
+    EXPECT_THROW( count.get(), std::runtime_error );
+    EXPECT_EQ( 0, counter.add(1).get() );
+}
+
+TEST( ActiveObjectStress, ReturnsInOrderOfCalls )
+{
+    ActiveCountable counter{Countable()};
+    std::vector<std::future<int>> counts;
+    for(int i = 0; i < 4 * 256; ++i)
+        counts.push_back(counter.add(1));
+    for(int i = 0; i < 4 * 256; ++i)
+        EXPECT_EQ( i + 1, counts[i].get() );
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <Atomic.h>
+#include <Storage.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr int n_readers = 8;
+    constexpr int n_updates = 5000;
+    constexpr int size = 32;
+
+    struct Payload
+    {
+        explicit Payload(int value)
+            : values(size, value)
+        {}
+
+        bool consistent() const
+        {
+            return std::all_of(begin(values), end(values),
+                               [this](int value) { return value == values.front(); });
+        }
+
+        void set_value(int value)
+        {
+            std::fill(begin(values), end(values), value);
+        }
+
+        std::vector<int> values;
+    };
+
+    using Storage = clang::type_erasure::COWStorage<true>;
+}
+
+
+TEST( TestAtomic_Stress, ReadersSeeConsistentSnapshots )
+{
+    clang::type_erasure::Atomic<Storage> atomic{ Storage(Payload(0)) };
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> readers;
+    for(int i = 0; i < n_readers; ++i)
+        readers.emplace_back([&atomic, &done]
+        {
+            auto last_value = 0;
+            while(!done.load())
+            {
+                const auto snapshot = atomic.load();
+                const auto& payload = snapshot->get<Payload>();
+                EXPECT_TRUE( payload.consistent() );
+                EXPECT_LE( last_value, payload.values.front() );
+                last_value = payload.values.front();
+            }
+        });
+
+    std::thread writer([&atomic]
+    {
+        for(int i = 1; i <= n_updates; ++i)
+        {
+            if(i % 2)
+                atomic.store(Storage(Payload(i)));
+            else
+                atomic.update([i](Storage& storage) { storage.get<Payload>().set_value(i); });
+        }
+    });
+
+    writer.join();
+    done.store(true);
+    for(auto& reader : readers)
+        reader.join();
+
+    EXPECT_EQ( n_updates, atomic.load()->get<Payload>().values.front() );
+}
+
+TEST( TestAtomic_Stress, ConcurrentUpdatesAreNotLost )
+{
+    clang::type_erasure::Atomic<Storage> atomic{ Storage(Payload(0)) };
+
+    std::vector<std::thread> writers;
+    for(int i = 0; i < n_readers; ++i)
+        writers.emplace_back([&atomic]
+        {
+            for(int j = 0; j < n_updates / n_readers; ++j)
+                atomic.update([](Storage& storage)
+                {
+                    auto& payload = storage.get<Payload>();
+                    payload.set_value(payload.values.front() + 1);
+                });
+        });
+
+    for(auto& writer : writers)
+        writer.join();
+
+    const auto snapshot = atomic.load();
+    EXPECT_TRUE( snapshot->get<Payload>().consistent() );
+    EXPECT_EQ( n_readers * (n_updates / n_readers), snapshot->get<Payload>().values.front() );
+}
+
+TEST( TestAtomic_Stress, MovedSnapshotsKeepTheirValuesPinned )
+{
+    clang::type_erasure::Atomic<Storage> atomic{ Storage(Payload(0)) };
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> readers;
+    for(int i = 0; i < n_readers; ++i)
+        readers.emplace_back([&atomic, &done]
+        {
+            auto outer = atomic.load();
+            while(!done.load())
+            {
+                // the moved-to snapshot releases the pin of the replaced one, not of outer
+                auto inner = atomic.load();
+                auto moved = std::move(inner);
+                moved = atomic.load();
+                EXPECT_TRUE( moved->get<Payload>().consistent() );
+                EXPECT_TRUE( outer->get<Payload>().consistent() );
+            }
+        });
+
+    for(int i = 1; i <= n_updates; ++i)
+        atomic.store(Storage(Payload(i)));
+
+    done.store(true);
+    for(auto& reader : readers)
+        reader.join();
+}
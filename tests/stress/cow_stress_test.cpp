@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include <Storage.h>
+
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr int n_threads = 8;
+    constexpr int n_iterations = 2000;
+    constexpr int initial_value = 1;
+
+    struct Payload
+    {
+        explicit Payload(int value)
+            : values(32, value)
+        {}
+
+        int sum() const
+        {
+            return std::accumulate(begin(values), end(values), 0);
+        }
+
+        void set_value(int value)
+        {
+            std::fill(begin(values), end(values), value);
+        }
+
+        std::vector<int> values;
+    };
+
+    template <class Storage>
+    void stress_copy_and_write()
+    {
+        const Storage shared = Storage(Payload(initial_value));
+        const auto expected_sum = shared.template get<Payload>().sum();
+
+        std::vector<std::thread> threads;
+        for(int i = 0; i < n_threads; ++i)
+            threads.emplace_back([&shared, expected_sum, i]
+            {
+                for(int j = 0; j < n_iterations; ++j)
+                {
+                    Storage copy(shared);
+                    EXPECT_EQ( expected_sum, copy.template get<Payload>().sum() );
+
+                    Storage other = copy;
+                    other.template get<Payload>().set_value(i + 2);
+                    EXPECT_EQ( 32 * (i + 2), static_cast<const Storage&>(other).template get<Payload>().sum() );
+                    EXPECT_EQ( expected_sum, static_cast<const Storage&>(copy).template get<Payload>().sum() );
+                }
+            });
+
+        for(auto& thread : threads)
+            thread.join();
+
+        EXPECT_EQ( expected_sum, shared.template get<Payload>().sum() );
+    }
+
+    template <class Storage>
+    void stress_release_and_write()
+    {
+        std::vector<Storage> copies(n_threads, Storage(Payload(initial_value)));
+        for(auto& copy : copies)
+            copy = copies.front();
+
+        std::vector<std::thread> threads;
+        for(int i = 0; i < n_threads; ++i)
+            threads.emplace_back([&copies, i]
+            {
+                // modifications of the last owner must not race with reads through released copies
+                EXPECT_EQ( 32 * initial_value, static_cast<const Storage&>(copies[i]).template get<Payload>().sum() );
+                copies[i].template get<Payload>().set_value(i + 2);
+                EXPECT_EQ( 32 * (i + 2), static_cast<const Storage&>(copies[i]).template get<Payload>().sum() );
+            });
+
+        for(auto& thread : threads)
+            thread.join();
+    }
+}
+
+
+TEST( TestCOWStorage_Stress, ConcurrentCopyAndWrite )
+{
+    stress_copy_and_write< clang::type_erasure::COWStorage<true> >();
+}
+
+TEST( TestCOWStorage_Stress, ConcurrentReleaseAndWrite )
+{
+    for(int i = 0; i < n_iterations; ++i)
+        stress_release_and_write< clang::type_erasure::COWStorage<true> >();
+}
+
+TEST( TestSBOCOWStorage_Stress, ConcurrentCopyAndWrite )
+{
+    stress_copy_and_write< clang::type_erasure::SBOCOWStorage<16, true> >();
+}
+
+TEST( TestSBOCOWStorage_Stress, ConcurrentReleaseAndWrite )
+{
+    for(int i = 0; i < n_iterations; ++i)
+        stress_release_and_write< clang::type_erasure::SBOCOWStorage<16, true> >();
+}
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include <SmartPointerStorage.h>
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr int n_threads = 8;
+    constexpr int n_iterations = 2000;
+    constexpr int initial_value = 1;
+
+    struct Interface
+    {
+        virtual ~Interface() = default;
+        virtual Interface* clone_into(void* buffer) const = 0;
+        virtual Interface* move_into(void* buffer) = 0;
+        virtual int sum() const = 0;
+        virtual void set_value(int value) = 0;
+    };
+
+    template <class Impl>
+    struct Wrapper final : Interface
+    {
+        template <class T>
+        Wrapper(T&& t) : impl(std::forward<T>(t)) {}
+
+        Interface* clone_into(void* buffer) const override
+        {
+            return new(buffer) Wrapper(impl);
+        }
+
+        Interface* move_into(void* buffer) override
+        {
+            return new(buffer) Wrapper(std::move(impl));
+        }
+
+        int sum() const override
+        {
+            return std::accumulate(begin(impl), end(impl), 0);
+        }
+
+        void set_value(int value) override
+        {
+            std::fill(begin(impl), end(impl), value);
+        }
+
+        Impl impl;
+    };
+
+    using Payload = std::vector<int>;
+
+    template <class Storage>
+    void stress_copy_and_write()
+    {
+        const Storage shared(Payload(32, initial_value));
+        const auto expected_sum = shared->sum();
+
+        std::vector<std::thread> threads;
+        for(int i = 0; i < n_threads; ++i)
+            threads.emplace_back([&shared, expected_sum, i]
+            {
+                for(int j = 0; j < n_iterations; ++j)
+                {
+                    Storage copy(shared);
+                    EXPECT_EQ( expected_sum, static_cast<const Storage&>(copy)->sum() );
+
+                    Storage other = copy;
+                    other->set_value(i + 2);
+                    EXPECT_EQ( 32 * (i + 2), static_cast<const Storage&>(other)->sum() );
+                    EXPECT_EQ( expected_sum, static_cast<const Storage&>(copy)->sum() );
+                }
+            });
+
+        for(auto& thread : threads)
+            thread.join();
+
+        EXPECT_EQ( expected_sum, shared->sum() );
+    }
+}
+
+
+TEST( TestPolymorphicCOWStorage_Stress, ConcurrentCopyAndWrite )
+{
+    stress_copy_and_write< clang::type_erasure::polymorphic::COWStorage<Interface, Wrapper> >();
+}
+
+TEST( TestPolymorphicSBOCOWStorage_Stress, ConcurrentCopyAndWrite )
+{
+    stress_copy_and_write< clang::type_erasure::polymorphic::SBOCOWStorage<Interface, Wrapper, 16> >();
+}
@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+
+#include <Queue.h>
+#include <Storage.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr int n_threads = 4;
+    constexpr int n_tasks = 20000;
+
+    struct Task
+    {
+        explicit Task(int value)
+            : value(value)
+        {}
+
+        Task(Task&& other) noexcept
+            : value(other.value)
+        {
+            ++moves();
+        }
+
+        static std::atomic<int>& moves()
+        {
+            static std::atomic<int> moves{0};
+            return moves;
+        }
+
+        int value;
+    };
+
+    struct LargeTask
+    {
+        explicit LargeTask(int value)
+        {
+            values.fill(value);
+        }
+
+        std::array<int, 32> values;
+    };
+
+    struct ThrowingTask
+    {
+        ThrowingTask()
+        {
+            throw std::runtime_error("construction failed");
+        }
+    };
+
+    using Storage = clang::type_erasure::NonCopyableSBOStorage<16, true>;
+    using Queue = clang::type_erasure::Queue<Storage, 1024>;
+    using SPSCQueue = clang::type_erasure::Queue<Storage, 64, false, false>;
+}
+
+
+TEST( TestQueue, ObjectsAreConstructedInTheirSlot )
+{
+    auto queue = std::make_unique<Queue>();
+
+    Task::moves() = 0;
+    EXPECT_TRUE( queue->try_emplace(clang::type_erasure::in_place_type<Task>, 42) );
+    EXPECT_EQ( 1u, queue->size() );
+
+    int value = 0;
+    EXPECT_TRUE( queue->try_consume([&value](Storage& storage) { value = storage.get<Task>().value; }) );
+    EXPECT_EQ( 42, value );
+    EXPECT_EQ( 0, Task::moves().load() );
+    EXPECT_FALSE( queue->try_consume([](Storage&) {}) );
+}
+
+TEST( TestQueue, LargeObjectsAreStoredOnTheHeap )
+{
+    auto queue = std::make_unique<Queue>();
+
+    EXPECT_TRUE( queue->try_emplace(clang::type_erasure::in_place_type<LargeTask>, 7) );
+
+    Storage storage;
+    EXPECT_TRUE( queue->try_pop(storage) );
+    EXPECT_EQ( 7, storage.get<LargeTask>().values.back() );
+}
+
+TEST( TestQueue, FullQueueRejectsObjects )
+{
+    SPSCQueue queue;
+    for(int i = 0; i < 64; ++i)
+        EXPECT_TRUE( queue.try_emplace(clang::type_erasure::in_place_type<Task>, i) );
+    EXPECT_FALSE( queue.try_emplace(clang::type_erasure::in_place_type<Task>, 64) );
+
+    // remaining objects are destroyed with the queue
+    EXPECT_TRUE( queue.try_consume([](Storage& storage) { EXPECT_EQ( 0, storage.get<Task>().value ); }) );
+    EXPECT_TRUE( queue.try_emplace(clang::type_erasure::in_place_type<Task>, 64) );
+}
+
+TEST( TestQueue, FailedConstructionsAreSkipped )
+{
+    SPSCQueue queue;
+    EXPECT_THROW( queue.try_emplace(clang::type_erasure::in_place_type<ThrowingTask>), std::runtime_error );
+    EXPECT_TRUE( queue.try_emplace(clang::type_erasure::in_place_type<Task>, 1) );
+
+    int value = 0;
+    EXPECT_TRUE( queue.try_consume([&value](Storage& storage) { value = storage.get<Task>().value; }) );
+    EXPECT_EQ( 1, value );
+    EXPECT_FALSE( queue.try_consume([](Storage&) {}) );
+}
+
+TEST( TestQueue_Stress, SingleProducerSingleConsumerKeepsOrder )
+{
+    SPSCQueue queue;
+
+    std::thread producer([&queue]
+    {
+        for(int i = 0; i < n_tasks; ++i)
+            while(!queue.try_emplace(clang::type_erasure::in_place_type<Task>, i))
+                std::this_thread::yield();
+    });
+
+    for(int expected = 0; expected < n_tasks; )
+        if(!queue.try_consume([&expected](Storage& storage) { EXPECT_EQ( expected++, storage.get<Task>().value ); }))
+            std::this_thread::yield();
+
+    producer.join();
+}
+
+TEST( TestQueue_Stress, EveryObjectIsConsumedOnce )
+{
+    auto queue = std::make_unique<Queue>();
+    std::vector<std::atomic<int>> consumed(n_threads * n_tasks);
+    std::atomic<int> remaining{n_threads * n_tasks};
+
+    std::vector<std::thread> threads;
+    for(int i = 0; i < n_threads; ++i)
+    {
+        threads.emplace_back([&queue, i]
+        {
+            for(int j = 0; j < n_tasks; ++j)
+            {
+                const auto value = i * n_tasks + j;
+                // alternate between buffered and heap allocated objects
+                const auto emplace = [&queue, value]
+                {
+                    return value % 2 ? queue->try_emplace(clang::type_erasure::in_place_type<Task>, value)
+                                     : queue->try_emplace(clang::type_erasure::in_place_type<LargeTask>, value);
+                };
+                while(!emplace())
+                    std::this_thread::yield();
+            }
+        });
+        threads.emplace_back([&queue, &consumed, &remaining]
+        {
+            while(remaining.load() > 0)
+            {
+                const auto success = queue->try_consume([&consumed](Storage& storage)
+                {
+                    const auto value = storage.target<Task>() ? storage.get<Task>().value
+                                                              : storage.get<LargeTask>().values.front();
+                    ++consumed[value];
+                });
+                if(success)
+                    --remaining;
+                else
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    for(auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ( 0u, queue->size() );
+    for(const auto& count : consumed)
+        EXPECT_EQ( 1, count.load() );
+}
@@ -0,0 +1,11 @@
+    /**
+     * @brief class Values
+     */
+    class Values
+    {
+    public:
+        /// Reads all values.
+        int sum() const;
+        //! Overwrites all values and returns the previous one.
+        int exchange(int value);
+    };
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+
+#include "interface.hh"
+#include "../mock_fooable.hh"
+#include "../util.hh"
+
+#include <cstddef>
+#include <utility>
+
+namespace
+{
+    using Hierarchy::Fooable;
+    using Hierarchy::Settable;
+    using Mock::MockFooable;
+
+    // the table of the base is a sub-table at the start of the derived table
+    static_assert(offsetof(Hierarchy::SettableDetail::Table<Settable>, Fooable_table) == 0,
+                  "the sub-table of the base interface comes first");
+
+    // conversions to the base share the storage instead of wrapping the derived interface
+    static_assert(!Hierarchy::FooableDetail::Concept<Fooable, Settable>::value,
+                  "derived interfaces are not wrapped by their base");
+    static_assert(Hierarchy::FooableDetail::Concept<Fooable, MockFooable>::value,
+                  "implementations are wrapped");
+}
+
+TEST( TestHierarchy, InheritsMethodsOfBase )
+{
+    Settable settable = MockFooable();
+    EXPECT_EQ( Mock::value, settable.foo() );
+    settable.set_value( Mock::other_value );
+    EXPECT_EQ( Mock::other_value, settable.foo() );
+}
+
+TEST( TestHierarchy, CopyingUpcastSharesNoState )
+{
+    Settable settable = MockFooable();
+    Fooable fooable = settable;
+    settable.set_value( Mock::other_value );
+
+    EXPECT_EQ( Mock::value, fooable.foo() );
+    EXPECT_EQ( Mock::other_value, settable.foo() );
+}
+
+TEST( TestHierarchy, UpcastsDoNotWrapTheDerivedInterface )
+{
+    const Settable settable = MockFooable();
+    const Fooable fooable = settable;
+    EXPECT_TRUE( fooable.is<MockFooable>() );
+    EXPECT_FALSE( fooable.is<Settable>() );
+    ASSERT_NE( nullptr, fooable.target<MockFooable>() );
+}
+
+TEST( TestHierarchy, MovingUpcastDoesNotAllocate )
+{
+    Settable settable = MockFooable();
+    settable.set_value( Mock::other_value );
+
+    auto expected_heap_allocations = 0u;
+    CHECK_HEAP_ALLOC( Fooable fooable = std::move(settable),
+                      expected_heap_allocations );
+    EXPECT_EQ( Mock::other_value, fooable.foo() );
+}
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include "interface.hh"
+
+#include <type_traits>
+
+namespace
+{
+    using VTableMemoize::Pricing;
+    using VTableMemoize::PricingRef;
+
+    struct Catalog
+    {
+        int price(int item, int quantity) const
+        {
+            ++lookups;
+            return item * quantity * discount;
+        }
+
+        void set_discount(int value)
+        {
+            discount = value;
+        }
+
+        int discount = 1;
+        mutable int lookups = 0;
+    };
+
+    // calls through the views would not clear the caches
+    static_assert(!std::is_convertible<Pricing&, PricingRef>::value,
+                  "interfaces with memoized methods do not convert to their views");
+}
+
+TEST( TestVTableMemoizePricing, ConstMethodsAreCalledOncePerArguments )
+{
+    const Pricing pricing = Catalog{};
+
+    EXPECT_EQ( 6, pricing.price(3, 2) );
+    EXPECT_EQ( 6, pricing.price(3, 2) );
+    EXPECT_EQ( 9, pricing.price(3, 3) );
+    EXPECT_EQ( 4, pricing.price(2, 2) );
+    EXPECT_EQ( 9, pricing.price(3, 3) );
+
+    auto copy = pricing;
+    EXPECT_EQ( 6, copy.price(3, 2) );
+    EXPECT_EQ( 3, copy.target<Catalog>()->lookups );
+}
+
+TEST( TestVTableMemoizePricing, NonConstMethodsInvalidateTheCache )
+{
+    Pricing pricing = Catalog{};
+
+    EXPECT_EQ( 6, pricing.price(3, 2) );
+    pricing.set_discount(10);
+    EXPECT_EQ( 60, pricing.price(3, 2) );
+    EXPECT_EQ( 2, pricing.target<Catalog>()->lookups );
+}
+
+TEST( TestVTableMemoizePricing, MutableTargetsInvalidateTheCache )
+{
+    Pricing pricing = Catalog{};
+
+    EXPECT_EQ( 6, pricing.price(3, 2) );
+    pricing.target<Catalog>()->discount = 10;
+    EXPECT_EQ( 60, pricing.price(3, 2) );
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+
+#include "interface.hh"
+#include "../mock_fooable.hh"
+
+#include <cstdio>
+#include <utility>
+
+namespace
+{
+    using VTableSBONullObject::Fooable;
+    using Mock::MockFooable;
+
+    void report(const char* what)
+    {
+        std::fputs(what, stderr);
+    }
+}
+
+TEST( TestVTableSBONullObjectFooable, MovedFromInterfacesAreEmpty )
+{
+    Fooable fooable = MockFooable();
+    fooable.set_value( Mock::other_value );
+    auto moved = std::move(fooable);
+
+    EXPECT_EQ( Mock::other_value, moved.foo() );
+    EXPECT_FALSE( fooable );
+}
+
+TEST( TestVTableSBONullObjectFooable, MoveAssignedFromInterfacesAreEmpty )
+{
+    Fooable fooable = MockFooable();
+    Fooable other;
+    other = std::move(fooable);
+
+    EXPECT_EQ( Mock::value, other.foo() );
+    EXPECT_FALSE( fooable );
+}
+
+TEST( TestVTableSBONullObjectFooableDeathTest, CallsOfEmptyInterfacesAreReportedToTheFailureHandler )
+{
+    clang::type_erasure::setFailureHandler(&report);
+    Fooable fooable = MockFooable();
+    auto moved = std::move(fooable);
+
+    EXPECT_DEATH( Fooable().foo(), "method called on an empty interface" );
+    EXPECT_DEATH( fooable.set_value( Mock::other_value ), "method called on an empty interface" );
+    clang::type_erasure::setFailureHandler(nullptr);
+}
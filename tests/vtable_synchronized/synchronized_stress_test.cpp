@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include "interface.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using VTableSynchronized::Values;
+    using VTableSynchronized::ValuesShared;
+    using VTableSynchronized::SynchronizedValues;
+    using VTableSynchronized::SynchronizedValuesShared;
+
+    constexpr int n_readers = 6;
+    constexpr int n_writers = 2;
+    constexpr int n_iterations = 2000;
+    constexpr int size = 32;
+
+    struct Payload
+    {
+        int sum() const
+        {
+            return std::accumulate(begin(values), end(values), 0);
+        }
+
+        int exchange(int value)
+        {
+            const auto previous = values.front();
+            std::fill(begin(values), end(values), value);
+            return previous;
+        }
+
+        std::vector<int> values = std::vector<int>(size, 0);
+    };
+
+    // Readers never observe partial writes, the writers see the values of each other in sequence.
+    template <class Synchronized, class Interface>
+    void stress_readers_and_writers()
+    {
+        Synchronized values{Interface(Payload())};
+        std::atomic<int> exchanged{0};
+        std::vector<std::thread> threads;
+        for(int i = 0; i < n_readers; ++i)
+            threads.emplace_back([&values]
+            {
+                for(int j = 0; j < n_iterations; ++j)
+                {
+                    const auto sum = values.sum();
+                    EXPECT_EQ( 0, sum % size );
+                    EXPECT_EQ( 0, values.load().sum() % size );
+                }
+            });
+        for(int i = 0; i < n_writers; ++i)
+            threads.emplace_back([&values, &exchanged]
+            {
+                for(int j = 1; j <= n_iterations; ++j)
+                    exchanged += values.exchange(1);
+            });
+
+        for(auto& thread : threads)
+            thread.join();
+
+        // all but the first exchange return the value of a previous one
+        EXPECT_EQ( n_writers * n_iterations - 1, exchanged );
+        EXPECT_EQ( size, values.sum() );
+    }
+}
+
+TEST( SynchronizedStress, SharedLocks )
+{
+    stress_readers_and_writers< SynchronizedValues, Values >();
+}
+
+TEST( SynchronizedStress, CopyOnWriteSnapshots )
+{
+    stress_readers_and_writers< SynchronizedValuesShared, ValuesShared >();
+}
@@ -7,9 +7,15 @@
 
 #include <boost/filesystem.hpp>
 
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
+#include <fstream>
+#include <iterator>
 #include <memory>
+#include <regex>
+#include <set>
+#include <vector>
 
 using namespace clang;
 using namespace clang::tooling;
@@ -107,6 +113,121 @@ cl::opt<bool> NoRTTI("no-rtti",
 cl::alias NoRTTIAlias("nr", cl::desc("Alias for -no-rtti"),
                       cl::aliasopt(NoRTTI));
 
+cl::opt<bool> Atomic("atomic",
+                     cl::desc(R"(generate a holder 'Atomic<interface>' for publishing values to concurrent readers)"),
+                     cl::init(false),
+                     cl::cat(ClangTypeEraseCategory));
+
+cl::opt<bool> Queue("queue",
+                    cl::desc(R"(generate a bounded lock-free queue 'FooableQueue<capacity>' whose slots hold the interfaces, e.g. for tasks generated with '-custom -sbo -non-copyable')"),
+                    cl::init(false),
+                    cl::cat(ClangTypeEraseCategory));
+
+cl::opt<bool> Instrument("instrument",
+                         cl::desc(R"(count the calls of each method per implementation, see Instrumentation.h for latency sampling and USDT probes)"),
+                         cl::init(false),
+                         cl::cat(ClangTypeEraseCategory));
+
+cl::opt<bool> Bulk("bulk",
+                   cl::desc(R"(add bulk operations 'foo_n' that hand runs of objects with the same implementation to 'static void Impl::foo_n(const Impl* const*, std::size_t, ...)', if provided)"),
+                   cl::init(false),
+                   cl::cat(ClangTypeEraseCategory));
+
+cl::opt<bool> Thin("thin",
+                   cl::desc(R"(store the function table in front of the object on the heap, such that the interfaces hold a single pointer, combines with '-cow' and '-non-copyable' (requires '-custom'))"),
+                   cl::init(false),
+                   cl::cat(ClangTypeEraseCategory));
+
+cl::opt<bool> Handle("handle",
+                     cl::desc(R"(store the objects in per-type slabs, such that the interfaces hold a 32-bit handle, combines with '-non-copyable' (requires '-custom'))"),
+                     cl::init(false),
+                     cl::cat(ClangTypeEraseCategory));
+
+cl::opt<bool> SharedMemory("shared-memory",
+                           cl::desc(R"(store trivially copyable objects in an arena that is shared between processes, see SharedMemoryStorage.h; types created by other processes are registered with 'Fooable::register_type<Impl>()' (requires '-custom'))"),
+                           cl::init(false),
+                           cl::cat(ClangTypeEraseCategory));
+
+cl::opt<bool> NoExceptions("no-exceptions",
+                           cl::desc(R"(generate noexcept thunks, methods and constructors for builds with '-fno-exceptions', allocation failures are reported to 'clang::type_erasure::setFailureHandler'; the function pointers in the tables are noexcept with '-cpp-standard=17' (requires '-custom'))"),
+                           cl::init(false),
+                           cl::cat(ClangTypeEraseCategory));
+
+cl::opt<bool> Refs("refs",
+                   cl::desc(R"(generate non-owning views 'FooableRef' of each interface; interfaces that derive from several interfaces, e.g. 'struct FooableBarable : Fooable, Barable {};', hold each object once and convert to the views of all their bases (requires '-custom'))"),
+                   cl::init(false),
+                   cl::cat(ClangTypeEraseCategory));
+
+cl::opt<bool> NullObject("null-object",
+                         cl::desc(R"(empty and moved-from interfaces refer to a table whose entries report calls to 'clang::type_erasure::setFailureHandler' and abort, instead of asserting that the interface is not empty in each method (requires '-custom'))"),
+                         cl::init(false),
+                         cl::cat(ClangTypeEraseCategory));
+
+cl::opt<bool> DeferredDestruction("deferred-destruction",
+                                  cl::desc(R"(delete objects on the heap in batches on a background thread when the last interface that refers to them is destroyed, objects in the buffer are still destroyed immediately, see DeferredDestruction.h (requires '-custom'))"),
+                                  cl::init(false),
+                                  cl::cat(ClangTypeEraseCategory));
+
+cl::opt<bool> Lazy("lazy",
+                   cl::desc(R"(support implementations that are built by a factory in the first call of a method, e.g. 'Fooable fooable = clang::type_erasure::lazy<Foo>(factory);', see Lazy.h (requires '-custom'))"),
+                   cl::init(false),
+                   cl::cat(ClangTypeEraseCategory));
+
+cl::opt<bool> Synchronized("synchronized",
+                           cl::desc(R"(generate thread-safe variants 'SynchronizedFooable', whose const methods take a shared lock and non-const methods an exclusive lock; with '-copy-on-write/--cow' const methods read from snapshots without locking, see Synchronized.h (requires '-custom'))"),
+                           cl::init(false),
+                           cl::cat(ClangTypeEraseCategory));
+
+cl::opt<bool> ActiveObject("active-object",
+                           cl::desc(R"(generate proxies 'ActiveFooable' that own a 'Fooable' and call its methods on a dedicated thread; each method returns a std::future or calls a completion callback with the result, see ActiveObject.h (requires '-custom'))"),
+                           cl::init(false),
+                           cl::cat(ClangTypeEraseCategory));
+
+cl::opt<unsigned> MemoizeCacheSize("memoize-cache-size",
+                                   cl::desc(R"(number of results cached per interface and method annotated with '[[clang::annotate("te_memoize")]]' (requires '-custom'))"),
+                                   cl::init(8),
+                                   cl::cat(ClangTypeEraseCategory));
+
+cl::opt<std::string> MemoizePolicy("memoize-policy",
+                                   cl::desc(R"(replacement policy of the caches of memoized methods, 'lru' or 'fifo', see Memoize.h)"),
+                                   cl::init("lru"),
+                                   cl::cat(ClangTypeEraseCategory));
+
+cl::opt<std::string> StorageStats("storage-stats",
+                                  cl::desc(R"(storage statistics written by clang::type_erasure::writeStorageStats, the buffer size is increased such that all implementations of the interfaces in <source0> that have been stored on the heap fit into the buffer; implementations spilled because of their alignment or a throwing move constructor stay on the heap regardless of the buffer size)"),
+                                  cl::init(""),
+                                  cl::cat(ClangTypeEraseCategory));
+
+cl::opt<unsigned> StorageStatsLimit("storage-stats-limit",
+                                    cl::desc(R"(largest buffer size '-storage-stats' may choose, larger spilled implementations are reported and stay on the heap)"),
+                                    cl::init(256),
+                                    cl::cat(ClangTypeEraseCategory));
+
+cl::opt<std::string> FunctionSignature("function",
+                              cl::desc(R"(write a callable with the given signature, e.g. "int(double, Foo&) const noexcept", to <source0> and generate its type-erased interface)"),
+                              cl::init(""),
+                              cl::cat(ClangTypeEraseCategory));
+
+cl::opt<std::string> CallableName("name",
+                          cl::desc(R"(name of the callable generated with '-function')"),
+                          cl::init("Function"),
+                          cl::cat(ClangTypeEraseCategory));
+
+cl::list<std::string> FunctionIncludes("function-include",
+                                       cl::desc(R"(include for the types in the signature of '-function', incl. angle brackets or quotes)"),
+                                       cl::ZeroOrMore,
+                                       cl::cat(ClangTypeEraseCategory));
+
+cl::opt<bool> InlineOnly("inline-only",
+                         cl::desc(R"(reject implementations that do not fit into the buffer at compile time, implies '-small-buffer-optimization')"),
+                         cl::init(false),
+                         cl::cat(ClangTypeEraseCategory));
+
+cl::list<std::string> Flavours("flavour",
+                               cl::desc(R"(additional storage flavour '<suffix>=<policies>' of each interface, with '+'-separated policies 'sbo', 'cow' and 'non-copyable', e.g. 'Shared=cow' generates 'FooableShared' with converting moves from and to 'Fooable' (requires '-custom'))"),
+                               cl::ZeroOrMore,
+                               cl::cat(ClangTypeEraseCategory));
+
 
 // Collect all other arguments, which will be passed to the front end.
 static cl::list<std::string>
@@ -133,7 +254,138 @@ std::string concat(const std::string& Path,
 }
 
 const auto STORAGE = "Storage.h";
+const auto THIN_STORAGE = "ThinStorage.h";
+const auto HANDLE_STORAGE = "HandleStorage.h";
+const auto SHARED_MEMORY_STORAGE = "SharedMemoryStorage.h";
 const auto SMART_PTR_STORAGE = "SmartPointerStorage.h";
+const auto STORAGE_STATS = "StorageStats.h";
+const auto ERROR_HANDLING = "ErrorHandling.h";
+const auto DEFERRED_DESTRUCTION = "DeferredDestruction.h";
+const auto LAZY = "Lazy.h";
+const auto MEMOIZE = "Memoize.h";
+const auto SYNCHRONIZED = "Synchronized.h";
+const auto ACTIVE_OBJECT = "ActiveObject.h";
+const auto ATOMIC = "Atomic.h";
+const auto QUEUE = "Queue.h";
+const auto VISIT = "Visit.h";
+const auto INSTRUMENTATION = "Instrumentation.h";
+
+/// Returns the names of the classes declared in SourceFile and of their first bases,
+/// which identify the storage statistics of derived interfaces.
+std::set<std::string> getDeclaredClasses(const std::string& SourceFile)
+{
+    std::ifstream Source(SourceFile);
+    const std::string Content((std::istreambuf_iterator<char>(Source)),
+                              std::istreambuf_iterator<char>());
+    const std::regex Declaration(R"(\b(?:class|struct)\s+(\w+)\s*(?::\s*(?:public\s+)?(?:\w+::)*(\w+))?[^{;]*\{)");
+    std::set<std::string> Classes;
+    for(std::sregex_iterator It(Content.begin(), Content.end(), Declaration), End; It != End; ++It)
+    {
+        Classes.insert((*It)[1]);
+        if((*It)[2].matched)
+            Classes.insert((*It)[2]);
+    }
+    return Classes;
+}
+
+/// Returns the smallest buffer size not below BufferSize that holds all spilled
+/// implementations of the Interfaces in StatsFile, ignoring those larger than Limit.
+unsigned getBufferSize(const std::string& StatsFile,
+                       const std::set<std::string>& Interfaces,
+                       unsigned BufferSize,
+                       unsigned Limit)
+{
+    std::ifstream Stats(StatsFile);
+    if(!Stats)
+    {
+        llvm::outs() << " === Cannot read storage statistics from '" << StatsFile << "'.\n";
+        return BufferSize;
+    }
+
+    // writeStorageStats writes the interface, e.g. "ns::DeferredDestruction<Tag>" or
+    // "ns::Tag::Interface" without '-custom', followed by its spilled types, one per line
+    const std::regex Interface(R"regex("interface": "(?:[^"]*?[^\w"])??(\w+)(?:::Interface)?>*")regex");
+    const std::regex SpilledType(R"regex(\{"type": "(.*)", "size": (\d+), "count": (\d+)\})regex");
+    std::smatch Match;
+    bool Generated = false;
+    for(std::string Line; std::getline(Stats, Line);)
+    {
+        if(std::regex_search(Line, Match, Interface))
+            Generated = Interfaces.count(Match[1]) != 0;
+        else if(Generated && std::regex_search(Line, Match, SpilledType))
+        {
+            const auto Size = static_cast<unsigned>(std::stoul(Match[2]));
+            if(Size > Limit)
+                llvm::outs() << " === Spilled type '" << Match[1].str() << "' of size " << Size
+                             << " exceeds '-storage-stats-limit' " << Limit << " and stays on the heap.\n";
+            else
+                BufferSize = std::max(BufferSize, Size);
+        }
+    }
+    return BufferSize;
+}
+
+std::string getCustomStorageType(bool CopyOnWrite,
+                                 bool SmallBufferOptimization,
+                                 bool NonCopyable,
+                                 unsigned BufferSize,
+                                 bool NoRTTI)
+{
+    const std::string rttiEnabled = NoRTTI ? "false" : "true";
+    const auto Buffer = std::to_string(BufferSize) + ", ";
+    if(NonCopyable)
+        return SmallBufferOptimization
+                ? "clang::type_erasure::NonCopyableSBOStorage<" + Buffer + rttiEnabled + ">"
+                : "clang::type_erasure::NonCopyableStorage<" + rttiEnabled + ">";
+    if(CopyOnWrite)
+        return SmallBufferOptimization
+                ? "clang::type_erasure::SBOCOWStorage<" + Buffer + rttiEnabled + ">"
+                : "clang::type_erasure::COWStorage<" + rttiEnabled + ">";
+    return SmallBufferOptimization
+            ? "clang::type_erasure::SBOStorage<" + Buffer + rttiEnabled + ">"
+            : "clang::type_erasure::Storage<" + rttiEnabled + ">";
+}
+
+std::string getThinStorageType(bool CopyOnWrite,
+                               bool NonCopyable,
+                               bool NoRTTI)
+{
+    const std::string rttiEnabled = NoRTTI ? "false" : "true";
+    if(NonCopyable)
+        return "clang::type_erasure::NonCopyableThinStorage<" + rttiEnabled + ">";
+    return CopyOnWrite
+            ? "clang::type_erasure::ThinCOWStorage<" + rttiEnabled + ">"
+            : "clang::type_erasure::ThinStorage<" + rttiEnabled + ">";
+}
+
+std::string getHandleStorageType(bool NonCopyable,
+                                 bool NoRTTI)
+{
+    const std::string rttiEnabled = NoRTTI ? "false" : "true";
+    return NonCopyable
+            ? "clang::type_erasure::NonCopyableHandleStorage<" + rttiEnabled + ">"
+            : "clang::type_erasure::HandleStorage<" + rttiEnabled + ">";
+}
+
+/// Parses '<suffix>=<policies>', invalid flavours have an empty suffix.
+type_erasure::Config::Flavour getFlavour(const std::string& Option,
+                                         const type_erasure::Config& Configuration)
+{
+    type_erasure::Config::Flavour Flavour;
+    std::smatch Match;
+    if(!std::regex_match(Option, Match, std::regex(R"(^([A-Za-z_]\w*)=((sbo|cow|non-copyable)(\+(sbo|cow|non-copyable))*)$)")))
+        return Flavour;
+
+    const std::string Policies = "+" + Match[2].str() + "+";
+    Flavour.Suffix = Match[1];
+    Flavour.SmallBufferOptimization = Policies.find("+sbo+") != std::string::npos;
+    Flavour.CopyOnWrite = Policies.find("+cow+") != std::string::npos;
+    Flavour.NonCopyable = Policies.find("+non-copyable+") != std::string::npos;
+    Flavour.StorageType = getCustomStorageType(Flavour.CopyOnWrite, Flavour.SmallBufferOptimization,
+                                               Flavour.NonCopyable, Configuration.BufferSize,
+                                               Configuration.NoRTTI);
+    return Flavour;
+}
 
 type_erasure::Config getConfiguration(int Argc, const char **Argv)
 {
@@ -141,12 +393,39 @@ type_erasure::Config getConfiguration(int Argc, const char **Argv)
 
     type_erasure::Config Configuration;
     Configuration.CopyOnWrite = CopyOnWrite;
-    Configuration.SmallBufferOptimization = SmallBufferOptimization;
+    Configuration.SmallBufferOptimization = SmallBufferOptimization || InlineOnly;
+    Configuration.InlineOnly = InlineOnly;
     Configuration.NonCopyable = NonCopyable;
     Configuration.HeaderOnly = HeaderOnly;
     Configuration.CustomFunctionTable = CustomFunctionTable;
     Configuration.NoRTTI = NoRTTI;
+    Configuration.Atomic = Atomic;
+    Configuration.Queue = Queue;
+    Configuration.Instrument = Instrument;
+    Configuration.Bulk = Bulk;
+    Configuration.Thin = Thin || Handle || SharedMemory;
+    Configuration.Handle = Handle;
+    Configuration.SharedMemory = SharedMemory;
+    Configuration.NoExceptions = NoExceptions;
+    Configuration.Refs = Refs;
+    Configuration.NullObject = NullObject;
+    Configuration.DeferredDestruction = DeferredDestruction;
+    Configuration.Lazy = Lazy;
+    Configuration.Synchronized = Synchronized;
+    Configuration.ActiveObject = ActiveObject;
+    Configuration.MemoizeCacheSize = MemoizeCacheSize;
+    Configuration.MemoizePolicy = MemoizePolicy == "fifo" ? "clang::type_erasure::FifoPolicy"
+                                                          : "clang::type_erasure::LruPolicy";
     Configuration.BufferSize = BufferSize;
+    if(!StorageStats.empty())
+    {
+        // with '-function' <source0> is only written later and declares just the callable
+        auto Interfaces = getDeclaredClasses(SourcePaths.front());
+        if(!FunctionSignature.empty())
+            Interfaces.insert(CallableName);
+        Configuration.BufferSize = getBufferSize(StorageStats, Interfaces, BufferSize, StorageStatsLimit);
+        llvm::outs() << " === Buffer size from storage statistics: " << Configuration.BufferSize << '\n';
+    }
     Configuration.CppStandard = CppStandard;
     Configuration.IncludeDir = makeAbsolute(IncludeDir);
     Configuration.UtilDir = concat(Configuration.IncludeDir,
@@ -154,39 +433,44 @@ type_erasure::Config getConfiguration(int Argc, const char **Argv)
     Configuration.UtilInclude = UtilInclude;
     Configuration.StorageInclude = "<" +
                                    (Configuration.CustomFunctionTable
-                                   ? concat(UtilDir, STORAGE)
+                                   ? concat(UtilDir, Configuration.SharedMemory ? SHARED_MEMORY_STORAGE :
+                                                     Configuration.Handle ? HANDLE_STORAGE :
+                                                     Configuration.Thin ? THIN_STORAGE :
+                                                     Configuration.DeferredDestruction ? DEFERRED_DESTRUCTION : STORAGE)
                                    : concat(UtilDir, SMART_PTR_STORAGE))
                                    + ">";
+    Configuration.LazyInclude = "<" + concat(UtilDir, LAZY) + ">";
+    Configuration.MemoizeInclude = "<" + concat(UtilDir, MEMOIZE) + ">";
+    Configuration.SynchronizedInclude = "<" + concat(UtilDir, SYNCHRONIZED) + ">";
+    Configuration.ActiveObjectInclude = "<" + concat(UtilDir, ACTIVE_OBJECT) + ">";
+    Configuration.AtomicInclude = "<" + concat(UtilDir, ATOMIC) + ">";
+    Configuration.QueueInclude = "<" + concat(UtilDir, QUEUE) + ">";
+    Configuration.InstrumentationInclude = "<" + concat(UtilDir, INSTRUMENTATION) + ">";
     Configuration.CastName = CastName;
     Configuration.TargetDir = concat(Configuration.IncludeDir,
                                      TargetDir);
     Configuration.DetailDir = concat(Configuration.TargetDir,
                                      DetailDir);
     Configuration.SourceFile = SourcePaths.front();
-    if(Configuration.CustomFunctionTable)
+    if(Configuration.SharedMemory)
+        Configuration.StorageType = std::string("clang::type_erasure::SharedMemoryStorage<") +
+                                    (Configuration.NoRTTI ? "false" : "true") + ">";
+    else if(Configuration.Handle)
+        Configuration.StorageType = getHandleStorageType(Configuration.NonCopyable,
+                                                         Configuration.NoRTTI);
+    else if(Configuration.Thin)
+        Configuration.StorageType = getThinStorageType(Configuration.CopyOnWrite,
+                                                       Configuration.NonCopyable,
+                                                       Configuration.NoRTTI);
+    else if(Configuration.CustomFunctionTable)
     {
-        const std::string rttiEnabled = Configuration.NoRTTI ? "false" : "true";
-        if(!Configuration.NonCopyable)
-        {
-            Configuration.StorageType =
-                    Configuration.CopyOnWrite ?
-                        (Configuration.SmallBufferOptimization ?
-                             ("clang::type_erasure::SBOCOWStorage<" + std::to_string(Configuration.BufferSize) + ", " +
-                              rttiEnabled + ">").c_str() :
-                             "clang::type_erasure::COWStorage<" + rttiEnabled + ">") :
-                        (Configuration.SmallBufferOptimization ?
-                             ("clang::type_erasure::SBOStorage<" + std::to_string(Configuration.BufferSize) + ", " +
-                              rttiEnabled + ">").c_str() :
-                             "clang::type_erasure::Storage<" + rttiEnabled + ">");
-        }
-        else
-        {
-            Configuration.StorageType =
-                        (Configuration.SmallBufferOptimization ?
-                             ("clang::type_erasure::NonCopyableSBOStorage<" + std::to_string(Configuration.BufferSize) + ", " +
-                              rttiEnabled + ">").c_str() :
-                             "clang::type_erasure::NonCopyableStorage<" + rttiEnabled + ">");
-        }
+        Configuration.StorageType = getCustomStorageType(Configuration.CopyOnWrite,
+                                                         Configuration.SmallBufferOptimization,
+                                                         Configuration.NonCopyable,
+                                                         Configuration.BufferSize,
+                                                         Configuration.NoRTTI);
+        for(const auto& Flavour : Flavours)
+            Configuration.Flavours.push_back(getFlavour(Flavour, Configuration));
     } else {
         Configuration.StorageType = "clang::type_erasure::polymorphic::";
         if(Configuration.CopyOnWrite) {
@@ -199,6 +483,76 @@ type_erasure::Config getConfiguration(int Argc, const char **Argv)
     return Configuration;
 }
 
+std::vector<std::string> splitArguments(const std::string& Arguments)
+{
+    std::vector<std::string> Result(1);
+    auto Depth = 0;
+    for(auto Char : Arguments)
+    {
+        if(Char == ',' && Depth == 0)
+        {
+            Result.emplace_back();
+            continue;
+        }
+        if(Char == '<' || Char == '(' || Char == '[')
+            ++Depth;
+        if(Char == '>' || Char == ')' || Char == ']')
+            --Depth;
+        Result.back() += Char;
+    }
+
+    for(auto& Argument : Result)
+        Argument = std::regex_replace(Argument, std::regex(R"(^\s+|\s+$)"), "");
+    if(Result.size() == 1 && (Result.front().empty() || Result.front() == "void"))
+        Result.clear();
+    return Result;
+}
+
+/// Writes the definition of a callable with signature '-function' to File.
+bool writeCallable(const std::string& File)
+{
+    std::smatch Match;
+    if(!std::regex_match(FunctionSignature.getValue(), Match,
+                         std::regex(R"(^\s*([^(]*[^(\s])\s*\((.*)\)\s*(const)?\s*(noexcept)?\s*$)")))
+    {
+        llvm::outs() << " === Invalid signature '" << FunctionSignature << "', expected e.g. \"int(double, Foo&) const\".\n";
+        return false;
+    }
+
+    const std::string GeneratedMarker = "// This file was generated with clang-type-erase -function.";
+    if(boost::filesystem::exists(File))
+    {
+        std::ifstream Existing(File);
+        std::string FirstLine;
+        std::getline(Existing, FirstLine);
+        if(FirstLine != GeneratedMarker)
+        {
+            llvm::outs() << " === Refusing to overwrite '" << File << "', which was not generated with '-function'.\n";
+            return false;
+        }
+    }
+
+    std::ofstream Stream(File);
+    Stream << GeneratedMarker << "\n\n"
+           << "#pragma once\n\n";
+    for(const auto& Include : FunctionIncludes)
+        Stream << "#include " << Include << '\n';
+    if(!FunctionIncludes.empty())
+        Stream << '\n';
+
+    const auto Arguments = splitArguments(Match[2]);
+    Stream << "class " << CallableName << "\n"
+           << "{\n"
+           << "public:\n"
+           << "    " << Match[1] << " operator()(";
+    for(std::size_t I = 0; I < Arguments.size(); ++I)
+        Stream << (I == 0 ? "" : ", ") << Arguments[I] << " arg" << I;
+    Stream << ")" << (Match[3].matched ? " const" : "") << (Match[4].matched ? " noexcept" : "") << ";\n"
+           << "};\n";
+    llvm::outs() << " === Writing callable '" << CallableName << "' to '" << File << "'\n";
+    return static_cast<bool>(Stream);
+}
+
 bool checkInput(const type_erasure::Config& Configuration)
 {
     if(!boost::filesystem::exists(Configuration.SourceFile))
@@ -213,6 +567,97 @@ bool checkInput(const type_erasure::Config& Configuration)
                         " === Invalid combination of options '-non-copyable/--nc' and '-copy-on-write/--cow'.\n";
         return false;
     }
+
+    if(Configuration.Bulk && !Configuration.CustomFunctionTable)
+    {
+        llvm::outs() << " === Bulk operations require '-custom'.\n";
+        return false;
+    }
+
+    if(Configuration.Thin && (!Configuration.CustomFunctionTable || Configuration.SmallBufferOptimization ||
+                              Configuration.Bulk || !Flavours.empty()))
+    {
+        llvm::outs() << " === '-thin', '-handle' and '-shared-memory' require '-custom' and can not be combined with "
+                        "'-sbo', '-inline-only', '-bulk' or '-flavour'.\n";
+        return false;
+    }
+
+    if(Configuration.Handle && Configuration.CopyOnWrite)
+    {
+        llvm::outs() << " === Handle storages do not support '-copy-on-write/--cow'.\n";
+        return false;
+    }
+
+    if(Configuration.SharedMemory && (Configuration.Handle || Configuration.CopyOnWrite || Configuration.NonCopyable))
+    {
+        llvm::outs() << " === Shared memory storages can not be combined with '-handle', '-copy-on-write/--cow' "
+                        "or '-non-copyable/--nc'.\n";
+        return false;
+    }
+
+    if(Configuration.NoExceptions && !Configuration.CustomFunctionTable)
+    {
+        llvm::outs() << " === '-no-exceptions' requires '-custom'.\n";
+        return false;
+    }
+
+    if(Configuration.Refs && !Configuration.CustomFunctionTable)
+    {
+        llvm::outs() << " === '-refs' requires '-custom'.\n";
+        return false;
+    }
+
+    if(Configuration.NullObject && (!Configuration.CustomFunctionTable || Configuration.Thin))
+    {
+        llvm::outs() << " === '-null-object' requires '-custom' and can not be combined with '-thin', "
+                        "'-handle' or '-shared-memory'.\n";
+        return false;
+    }
+
+    if(Configuration.DeferredDestruction && (!Configuration.CustomFunctionTable || Configuration.Thin))
+    {
+        llvm::outs() << " === '-deferred-destruction' requires '-custom' and can not be combined with '-thin', "
+                        "'-handle' or '-shared-memory'.\n";
+        return false;
+    }
+
+    if(Configuration.Lazy && !Configuration.CustomFunctionTable)
+    {
+        llvm::outs() << " === '-lazy' requires '-custom'.\n";
+        return false;
+    }
+
+    if(Configuration.Synchronized && !Configuration.CustomFunctionTable)
+    {
+        llvm::outs() << " === '-synchronized' requires '-custom'.\n";
+        return false;
+    }
+
+    if(Configuration.ActiveObject && !Configuration.CustomFunctionTable)
+    {
+        llvm::outs() << " === '-active-object' requires '-custom'.\n";
+        return false;
+    }
+
+    if(Configuration.MemoizeCacheSize == 0 || (MemoizePolicy != "lru" && MemoizePolicy != "fifo"))
+    {
+        llvm::outs() << " === Memoization requires '-memoize-cache-size' greater than zero and "
+                        "'-memoize-policy=lru' or '-memoize-policy=fifo'.\n";
+        return false;
+    }
+
+    if(!Flavours.empty() && !Configuration.CustomFunctionTable)
+    {
+        llvm::outs() << " === Storage flavours require '-custom'.\n";
+        return false;
+    }
+
+    for(const auto& Flavour : Configuration.Flavours)
+        if(Flavour.Suffix.empty() || (Flavour.NonCopyable && Flavour.CopyOnWrite))
+        {
+            llvm::outs() << " === Invalid storage flavour, expected e.g. '-flavour=Shared=cow' or '-flavour=Local=sbo+non-copyable'.\n";
+            return false;
+        }
     return true;
 }
 
@@ -288,6 +733,8 @@ void formatGeneratedFiles(const type_erasure::Config& Configuration)
 int main(int Argc, const char **Argv)
 {
     auto Configuration = getConfiguration(Argc, Argv);
+    if(!FunctionSignature.empty() && !writeCallable(Configuration.SourceFile))
+        return 1;
     if(!checkInput(Configuration))
         return 1;
 
@@ -307,15 +754,50 @@ int main(int Argc, const char **Argv)
     {
         const auto SuccessfulCopy =
                 copyFile(Configuration.UtilDir, "TypeErasureUtil.h") &&
+                copyFile(Configuration.UtilDir, STORAGE_STATS) &&
+                copyFile(Configuration.UtilDir, ERROR_HANDLING) &&
+                copyFile(Configuration.UtilDir, VISIT) &&
+                (!Configuration.Thin || Configuration.Handle || Configuration.SharedMemory ||
+                 copyFile(Configuration.UtilDir, THIN_STORAGE)) &&
+                (!Configuration.Handle || copyFile(Configuration.UtilDir, HANDLE_STORAGE)) &&
+                (!Configuration.SharedMemory || copyFile(Configuration.UtilDir, SHARED_MEMORY_STORAGE)) &&
+                (!Configuration.DeferredDestruction || copyFile(Configuration.UtilDir, DEFERRED_DESTRUCTION)) &&
+                (!Configuration.Lazy || copyFile(Configuration.UtilDir, LAZY)) &&
+                copyFile(Configuration.UtilDir, MEMOIZE) &&
+                (!Configuration.Synchronized || (copyFile(Configuration.UtilDir, ATOMIC) &&
+                                                 copyFile(Configuration.UtilDir, SYNCHRONIZED))) &&
+                (!Configuration.ActiveObject || (copyFile(Configuration.UtilDir, QUEUE) &&
+                                                 copyFile(Configuration.UtilDir, ACTIVE_OBJECT))) &&
         copyFile(Configuration.UtilDir, STORAGE);
         if(!SuccessfulCopy && !boost::filesystem::exists(Configuration.UtilDir/boost::filesystem::path(STORAGE)))
             return 1;
     } else {
         const auto SuccessfulCopy =
+                copyFile(Configuration.UtilDir, STORAGE_STATS) &&
+                copyFile(Configuration.UtilDir, VISIT) &&
                 copyFile(Configuration.UtilDir, SMART_PTR_STORAGE);
         if(!SuccessfulCopy && !boost::filesystem::exists(Configuration.UtilDir/boost::filesystem::path(SMART_PTR_STORAGE)))
             return 1;
     }
+    if(Configuration.Atomic)
+    {
+        const auto SuccessfulCopy = copyFile(Configuration.UtilDir, ATOMIC);
+        if(!SuccessfulCopy && !boost::filesystem::exists(Configuration.UtilDir/boost::filesystem::path(ATOMIC)))
+            return 1;
+    }
+    if(Configuration.Queue)
+    {
+        const auto SuccessfulCopy = copyFile(Configuration.UtilDir, ERROR_HANDLING) &&
+                                    copyFile(Configuration.UtilDir, QUEUE);
+        if(!SuccessfulCopy && !boost::filesystem::exists(Configuration.UtilDir/boost::filesystem::path(QUEUE)))
+            return 1;
+    }
+    if(Configuration.Instrument)
+    {
+        const auto SuccessfulCopy = copyFile(Configuration.UtilDir, INSTRUMENTATION);
+        if(!SuccessfulCopy && !boost::filesystem::exists(Configuration.UtilDir/boost::filesystem::path(INSTRUMENTATION)))
+            return 1;
+    }
     const auto SuccessfulCopy =
             copyFile(Configuration.SourceFile,
                      Configuration.TargetDir,
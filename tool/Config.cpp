@@ -105,6 +105,8 @@ namespace clang
                             readValue(ConfigFile, Configuration.HeaderOnly);
                         else if(Buffer == "no-rtti")
                             readValue(ConfigFile, Configuration.NoRTTI);
+                        else if(Buffer == "inline-only")
+                            readValue(ConfigFile, Configuration.InlineOnly);
                         else if(Buffer == "buffer-size")
                             readValue(ConfigFile, Configuration.BufferSize);
                         else //if(buffer == "cpp-standard")
@@ -135,7 +137,25 @@ namespace clang
                << "non-copyable: " << Configuration.NonCopyable << '\n'
                << "header-only: " << Configuration.HeaderOnly << '\n'
                << "no-rtti: " << Configuration.NoRTTI << '\n'
+               << "atomic: " << Configuration.Atomic << '\n'
+               << "queue: " << Configuration.Queue << '\n'
+               << "instrument: " << Configuration.Instrument << '\n'
+               << "bulk: " << Configuration.Bulk << '\n'
+               << "thin: " << Configuration.Thin << '\n'
+               << "handle: " << Configuration.Handle << '\n'
+               << "shared-memory: " << Configuration.SharedMemory << '\n'
+               << "no-exceptions: " << Configuration.NoExceptions << '\n'
+               << "refs: " << Configuration.Refs << '\n'
+               << "null-object: " << Configuration.NullObject << '\n'
+               << "deferred-destruction: " << Configuration.DeferredDestruction << '\n'
+               << "lazy: " << Configuration.Lazy << '\n'
+               << "synchronized: " << Configuration.Synchronized << '\n'
+               << "active-object: " << Configuration.ActiveObject << '\n'
+               << "memoize-cache-size: " << Configuration.MemoizeCacheSize << '\n'
+               << "memoize-policy: " << Configuration.MemoizePolicy << '\n'
+               << "inline-only: " << Configuration.InlineOnly << '\n'
                << "buffer-size: " << Configuration.BufferSize << '\n'
+               << "flavours: " << Configuration.Flavours.size() << '\n'
                << "cpp-standard: " << Configuration.CppStandard << '\n'
                << "interface type: " << Configuration.InterfaceType << '\n'
                << "interface var: " << Configuration.InterfaceType << '\n'
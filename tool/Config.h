@@ -2,6 +2,7 @@
 
 #include <ostream>
 #include <string>
+#include <vector>
 
 namespace clang
 {
@@ -9,6 +10,16 @@ namespace clang
     {
         struct Config
         {
+            /// Additional storage flavour of each interface, generated as '<interface><Suffix>'.
+            struct Flavour
+            {
+                std::string Suffix;
+                bool CopyOnWrite = false;
+                bool SmallBufferOptimization = false;
+                bool NonCopyable = false;
+                std::string StorageType;
+            };
+
             Config();
 
             bool CopyOnWrite = false;
@@ -19,6 +30,33 @@ namespace clang
             bool NoOverwriteWarning = false;
             bool UseCppConcepts = false;
             bool CustomFunctionTable = false;
+            bool Atomic = false;
+            bool Queue = false;
+            bool Instrument = false;
+            bool Bulk = false;
+            /// The function table is stored with the object instead of in the interface, set
+            /// for '-thin', '-handle' and '-shared-memory'.
+            bool Thin = false;
+            bool Handle = false;
+            bool SharedMemory = false;
+            /// Thunks, methods and constructors are noexcept for builds with '-fno-exceptions'.
+            bool NoExceptions = false;
+            /// Non-owning views '<interface>Ref' of each interface and of the bases of combined interfaces.
+            bool Refs = false;
+            /// Empty and moved-from interfaces refer to a table whose entries call the failure handler.
+            bool NullObject = false;
+            /// Heap blocks are deleted on a background thread, the storage tags are wrapped in 'DeferredDestruction'.
+            bool DeferredDestruction = false;
+            /// Implementations built by a factory on their first use, see Lazy.h.
+            bool Lazy = false;
+            /// Thread-safe variants 'Synchronized<interface>' with reader/writer locking by method constness.
+            bool Synchronized = false;
+            /// Proxies 'Active<interface>' that call the methods on a dedicated thread, see ActiveObject.h.
+            bool ActiveObject = false;
+            /// Size and replacement policy of the caches of methods annotated with 'te_memoize'.
+            unsigned MemoizeCacheSize = 8;
+            std::string MemoizePolicy = "clang::type_erasure::LruPolicy";
+            bool InlineOnly = false;
             unsigned BufferSize = 128;
             unsigned CppStandard = 11;
             std::string InterfaceType = "Interface";
@@ -30,6 +68,13 @@ namespace clang
             std::string DetailDir = "detail";
             std::string UtilInclude = "<util/type_erasure_util.h>";
             std::string StorageInclude = "<util/storage.h>";
+            std::string LazyInclude = "<util/Lazy.h>";
+            std::string MemoizeInclude = "<util/Memoize.h>";
+            std::string SynchronizedInclude = "<util/Synchronized.h>";
+            std::string ActiveObjectInclude = "<util/ActiveObject.h>";
+            std::string AtomicInclude = "<util/Atomic.h>";
+            std::string QueueInclude = "<util/Queue.h>";
+            std::string InstrumentationInclude = "<util/Instrumentation.h>";
             std::string UtilDir = "util";
             std::string SourceFile = "";
             std::string IncludeDir = "";
@@ -42,6 +87,7 @@ namespace clang
                                                "clang::type_erasure::SBOStorage" :
                                                "clang::type_erasure::Storage");
             std::string FormattingCommand = "clang-format -i";
+            std::vector<Flavour> Flavours;
         };
 
         std::ostream& operator<<(std::ostream& OS, const Config& Configuration);
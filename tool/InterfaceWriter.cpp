@@ -9,10 +9,13 @@
 
 #include <algorithm>
 #include <fstream>
+#include <iterator>
 #include <numeric>
 #include <regex>
 #include <sstream>
 #include <tuple>
+#include <utility>
+#include <vector>
 
 namespace clang
 {
@@ -21,6 +24,7 @@ namespace clang
         namespace
         {
             const auto WRAPPER = "Wrapper";
+            const auto WRAPPER_BASE = "WrapperBase";
             const auto ConstructorPlaceholder = "[[CONSTRUCTOR_PLACEHOLDER]]";
             const auto ConstructorPlaceholderRegex = std::regex("\\[\\[CONSTRUCTOR_PLACEHOLDER\\]\\]");
 
@@ -211,40 +215,161 @@ namespace clang
                 return Stream.str();
             }
 
+            /// With '-inline-only', implementations that do not fit into the buffer are rejected at compile time.
+            /// The custom storages also require the alignment and a nothrow move constructor, see
+            /// FitsIntoBuffer in Storage.h.
+            std::string constructorBody(const Config& Configuration)
+            {
+                if(!Configuration.InlineOnly)
+                    return "{}";
+                const auto Fits = Configuration.CustomFunctionTable
+                                  ? "clang::type_erasure::detail::FitsIntoBuffer<" + utils::decayed("T", Configuration) +
+                                    ", clang::type_erasure::detail::SmallBuffer<" + std::to_string(Configuration.BufferSize) +
+                                    ">>::value"
+                                  : "sizeof(" + std::string(WRAPPER) + "<" + utils::decayed("T", Configuration) + ">) <= " +
+                                    std::to_string(Configuration.BufferSize);
+                return "{\nstatic_assert(" + Fits + ", \"the implementation does not fit into the buffer\");\n}";
+            }
+
+            std::string getTableType(const std::string& InterfaceName,
+                                     const Config& Configuration)
+            {
+                return InterfaceName + "Detail::" + Configuration.FunctionTableType + "<" + InterfaceName + ">";
+            }
+
+            /// Table of empty interfaces with '-null-object'.
+            std::string getEmptyTable(const std::string& InterfaceName)
+            {
+                return InterfaceName + "Detail::empty_table<" + InterfaceName + ">()";
+            }
+
+            /// Function table used in the methods. Thin storages keep the table in their heap block.
+            std::string getTable(const std::string& InterfaceName,
+                                 const Config& Configuration)
+            {
+                if(!Configuration.Thin)
+                    return Configuration.FunctionTableObject;
+                return Configuration.StorageObject + ".functions<" + getTableType(InterfaceName, Configuration) + ">()";
+            }
+
+            /// Empty and moved-from interfaces refer to the table of empty interfaces, such that
+            /// calling their methods is diagnosed without checking for emptiness in each call.
+            void writeNullObjectMembers(std::ostream& File,
+                                        const std::string& ClassName,
+                                        const std::string& InterfaceName,
+                                        const Config& Configuration,
+                                        bool Memoizing)
+            {
+                const auto& Table = Configuration.FunctionTableObject;
+                const auto& Storage = Configuration.StorageObject;
+                File << ClassName << "() noexcept\n"
+                     << ": " << Table << "(" << getEmptyTable(InterfaceName) << ")\n"
+                     << "{}\n\n";
+                if(!Configuration.NonCopyable)
+                    File << ClassName << "(const " << ClassName << "&) = default;\n"
+                         << ClassName << "& operator=(const " << ClassName << "&) = default;\n\n";
+                File << ClassName << "(" << ClassName << "&& other) noexcept\n"
+                     << ": " << Table << "(other." << Table << "), " << Storage << "(std::move(other." << Storage << "))\n"
+                     << "{\n"
+                     << "other." << Table << " = " << getEmptyTable(InterfaceName) << ";\n"
+                     << "}\n\n"
+                     << ClassName << "& operator=(" << ClassName << "&& other) noexcept\n"
+                     << "{\n"
+                     << "if(this == &other)\n"
+                     << "return *this;\n"
+                     << Table << " = other." << Table << ";\n"
+                     << Storage << " = std::move(other." << Storage << ");\n"
+                     << "other." << Table << " = " << getEmptyTable(InterfaceName) << ";\n"
+                     << (Memoizing ? "invalidate_memos_();\n" : "")
+                     << "return *this;\n"
+                     << "}\n\n";
+            }
+
             void writeConstructors(std::ostream& File,
                                    const std::string& ClassName,
-                                   const Config& Configuration)
+                                   const std::string& InterfaceName,
+                                   const Config& Configuration,
+                                   bool Memoizing)
             {
                 // default constructor
-                File << ClassName << "() noexcept = default;\n\n";
+                if(Configuration.NullObject)
+                    writeNullObjectMembers(File, ClassName, InterfaceName, Configuration, Memoizing);
+                else
+                    File << ClassName << "() noexcept = default;\n\n";
 
-                // construct from implementation
-                if(Configuration.CustomFunctionTable)
+                // construct from implementation, thin storages take the table with the object
+                if(Configuration.Thin)
                 {
                     File << "template <class T,\n"
-                         << enable_if("T", ClassName, ClassName + "Detail", Configuration) << ">\n"
-                         << ClassName << "(T&& value)\n"
+                         << enable_if("T", InterfaceName, InterfaceName + "Detail", Configuration) << ">\n"
+                         << ClassName << "(T&& value)" << utils::getNoexcept(Configuration) << "\n"
+                         << ": " << Configuration.StorageObject << "(clang::type_erasure::in_place_type<"
+                         << utils::decayed("T", Configuration) << ">, "
+                         << getTableType(InterfaceName, Configuration) << "{\n"
+                         << ConstructorPlaceholder << "}, std::forward<T>(value))\n"
+                         << constructorBody(Configuration) << "\n\n";
+
+                    File << "template <class T, class... Args,\n"
+                         << enable_if("T", InterfaceName, InterfaceName + "Detail", Configuration) << ">\n"
+                         << "explicit " << ClassName << "(clang::type_erasure::in_place_type_t<T>, Args&&... args)"
+                         << utils::getNoexcept(Configuration) << "\n"
+                         << ": " << Configuration.StorageObject << "(clang::type_erasure::in_place_type<T>, "
+                         << getTableType(InterfaceName, Configuration) << "{\n"
+                         << ConstructorPlaceholder << "}, std::forward<Args>(args)...)\n"
+                         << constructorBody(Configuration) << "\n\n";
+
+                    if(Configuration.SharedMemory)
+                        File << "/// Registers T in this process, required before objects of type T that have been "
+                             << "stored by other processes are used.\n"
+                             << "template <class T,\n"
+                             << enable_if("T", InterfaceName, InterfaceName + "Detail", Configuration) << ">\n"
+                             << "static void register_type()\n"
+                             << "{\n"
+                             << "decltype(" << Configuration.StorageObject << ")::registerType<T>("
+                             << getTableType(InterfaceName, Configuration) << "{\n"
+                             << ConstructorPlaceholder << "});\n"
+                             << "}\n\n";
+                }
+                else if(Configuration.CustomFunctionTable)
+                {
+                    File << "template <class T,\n"
+                         << enable_if("T", InterfaceName, InterfaceName + "Detail", Configuration) << ">\n"
+                         << ClassName << "(T&& value)" << utils::getNoexcept(Configuration) << "\n"
                          << ": " << Configuration.FunctionTableObject << "( {\n"
                          << ConstructorPlaceholder << "} )"
-                         << ", \n" << Configuration.StorageObject << "(std::forward<T>(value))\n{}" << "\n\n";
+                         << ", \n" << Configuration.StorageObject << "(std::forward<T>(value))\n"
+                         << constructorBody(Configuration) << "\n\n";
+
+                    // construct the implementation in the storage
+                    File << "template <class T, class... Args,\n"
+                         << enable_if("T", InterfaceName, InterfaceName + "Detail", Configuration) << ">\n"
+                         << "explicit " << ClassName << "(clang::type_erasure::in_place_type_t<T>, Args&&... args)"
+                         << utils::getNoexcept(Configuration) << "\n"
+                         << ": " << Configuration.FunctionTableObject << "( {\n"
+                         << ConstructorPlaceholder << "} )"
+                         << ", \n" << Configuration.StorageObject
+                         << "(clang::type_erasure::in_place_type<T>, std::forward<Args>(args)...)\n"
+                         << constructorBody(Configuration) << "\n\n";
                 }
                 else
                 {
                     File << "template <class T,\n"
                          << enable_if("T", ClassName, ClassName + "Detail", Configuration) << ">\n"
-                         << ClassName << "(T&& value)\n"
-                         << ": " << Configuration.StorageObject << "(std::forward<T>(value))\n{}" << "\n\n";
+                         << ClassName << "(T&& value)" << utils::getNoexcept(Configuration) << "\n"
+                         << ": " << Configuration.StorageObject << "(std::forward<T>(value))\n"
+                         << constructorBody(Configuration) << "\n\n";
                 }
             }
 
             void writeOperators(std::ostream& File,
                                 const std::string& ClassName,
+                                const std::string& InterfaceName,
                                 const Config& Configuration)
             {
                 // assignment
                 File << "template <class T,\n"
-                     << enable_if("T", ClassName, ClassName + "Detail", Configuration) << ">\n"
-                     << ClassName << "& operator=(T&& value)\n{\n"
+                     << enable_if("T", InterfaceName, InterfaceName + "Detail", Configuration) << ">\n"
+                     << ClassName << "& operator=(T&& value)" << utils::getNoexcept(Configuration) << "\n{\n"
                      << "return * this = " << ClassName << " ( std::forward<T>(value) );\n"
                      << "}\n\n";
 
@@ -254,14 +379,19 @@ namespace clang
             }
 
             void writeCasts(std::ostream& File,
-                             const Config& Configuration)
+                             const std::string& ClassName,
+                             const Config& Configuration,
+                             bool Memoizing)
             {
-                auto Write = [&File,&Configuration](const char* ConstSpecifier)
+                auto Write = [&File,&Configuration,Memoizing](const char* ConstSpecifier)
                 {
+                    // the object may be modified through the pointer
+                    const auto Invalidate = Memoizing && ConstSpecifier[0] == '\0';
                     File << "template <class T>\n"
                          << ConstSpecifier << "T* " << Configuration.CastName << "() "
                          << ConstSpecifier << "noexcept\n"
                          << "{\n"
+                         << (Invalidate ? "invalidate_memos_();\n" : "")
                          << "return " << Configuration.StorageObject << ".template target<T>();\n"
                          << "}\n"
                          << '\n';
@@ -269,18 +399,47 @@ namespace clang
 
                 Write("");
                 Write("const ");
+
+                File << "template <class T>\n"
+                     << "bool is() const noexcept\n"
+                     << "{\n"
+                     << "return " << Configuration.StorageObject << ".template is<T>();\n"
+                     << "}\n"
+                     << '\n'
+                     << "friend bool same_type(const " << ClassName << "& lhs, const " << ClassName << "& rhs) noexcept\n"
+                     << "{\n"
+                     << "return lhs." << Configuration.StorageObject << ".type() == rhs."
+                     << Configuration.StorageObject << ".type();\n"
+                     << "}\n"
+                     << '\n';
+            }
+
+            void writeStorageStats(std::ostream& File,
+                                   const std::string& StorageTag,
+                                   const Config& Configuration)
+            {
+                File << "#ifdef CLANG_TYPE_ERASE_STORAGE_STATS\n"
+                     << "static clang::type_erasure::StorageStats storage_stats()\n"
+                     << "{\n"
+                     << "return clang::type_erasure::storageStats<"
+                     << (Configuration.CustomFunctionTable ? utils::getStorageTagType(Configuration, StorageTag)
+                                                           : std::string("Interface")) << ">();\n"
+                     << "}\n"
+                     << "#endif\n"
+                     << '\n';
             }
 
             void writePrivateSection(std::ostream& File,
                                      const std::string& ClassName,
+                                     const std::string& StorageTag,
                                      const Config& Configuration)
             {
                 if(Configuration.CustomFunctionTable)
                 {
-                    File << "private:\n"
-                         << ClassName << "Detail::" << Configuration.FunctionTableType << "<" << ClassName
-                         << "> " << Configuration.FunctionTableObject << ";\n"
-                         << Configuration.StorageType << " " << Configuration.StorageObject << ";\n";
+                    File << "private:\n";
+                    if(!Configuration.Thin)
+                        File << getTableType(ClassName, Configuration) << " " << Configuration.FunctionTableObject << ";\n";
+                    File << utils::getStorageType(Configuration, StorageTag) << " " << Configuration.StorageObject << ";\n";
                 }
                 else
                 {
@@ -291,6 +450,352 @@ namespace clang
                 }
             }
 
+            /// Caches of the memoized methods, which are cleared before non-const methods are called.
+            void writeMemoCaches(std::ostream& File,
+                                 const std::vector<const CXXMethodDecl*>& Methods,
+                                 const Config& Configuration)
+            {
+                if(Methods.empty())
+                    return;
+                File << "void invalidate_memos_() noexcept\n"
+                     << "{\n";
+                for(const auto Method : Methods)
+                    File << utils::getMemoCacheName(*Method, Configuration) << ".clear();\n";
+                File << "}\n\n";
+                for(const auto Method : Methods)
+                    File << utils::getMemoCacheType(*Method, Configuration) << " "
+                         << utils::getMemoCacheName(*Method, Configuration) << ";\n";
+            }
+
+            /// Methods of an interface and its bases that can be called through the synchronized
+            /// variant, i.e. that do not return references, which would outlive the lock, and do not
+            /// refer to the interface.
+            void collectSynchronizedMethods(const CXXRecordDecl& Declaration,
+                                            std::vector<const CXXMethodDecl*>& Methods)
+            {
+                for(const auto Base : utils::getInterfaceBases(Declaration))
+                    collectSynchronizedMethods(*Base, Methods);
+                const auto ClassName = Declaration.getName().str();
+                for(const auto Method : Declaration.methods())
+                    if(Method->isUserProvided() && !Method->getReturnType()->isReferenceType() &&
+                       !utils::refersTo(*Method, ClassName))
+                        Methods.push_back(Method);
+            }
+
+            /// 'Synchronized<ClassName>' with '-synchronized': const methods take a shared lock, non-const
+            /// methods an exclusive lock. Copy-on-write interfaces are read from snapshots without locking.
+            void writeSynchronized(std::ostream& File,
+                                   const CXXRecordDecl& Declaration,
+                                   const std::string& ClassName,
+                                   const Config& Configuration)
+            {
+                if(!Configuration.Synchronized)
+                    return;
+                const auto SynchronizedName = "Synchronized" + ClassName;
+                File << "\n/// " << ClassName << " that is shared between threads, "
+                     << (Configuration.CopyOnWrite
+                         ? "const methods are called on snapshots without locking, non-const methods are serialized "
+                           "and publish a new snapshot.\n"
+                         : "const methods hold a shared lock, non-const methods an exclusive lock.\n")
+                     << "class " << SynchronizedName << "\n"
+                     << "{\n"
+                     << "public:\n"
+                     << SynchronizedName << "() = default;\n\n"
+                     << "explicit " << SynchronizedName << "(" << ClassName << " value)\n"
+                     << ": value_(std::move(value))\n"
+                     << "{}\n\n";
+
+                std::vector<const CXXMethodDecl*> Methods;
+                collectSynchronizedMethods(Declaration, Methods);
+                for(const auto Method : Methods)
+                {
+                    File << Method->getReturnType().getAsString(printingPolicy()) << ' '
+                         << Method->getNameAsString() << "(";
+                    std::for_each(Method->param_begin(),
+                                  Method->param_end(),
+                                  [Method,&File](const auto& Param)
+                    {
+                        File << (Param == *Method->param_begin() ? "" : ", ")
+                             << Param->getType().getAsString(printingPolicy()) << ' ' << Param->getNameAsString();
+                    });
+                    const auto Const = std::string(Method->isConst() ? "const " : "");
+                    File << ")" << utils::getQualifiers(*Method) << "\n"
+                         << "{\n"
+                         << "return value_." << (Method->isConst() ? "read" : "write")
+                         << "([&](" << Const << ClassName << "& object) { return object." << Method->getNameAsString()
+                         << "(" << utils::useFunctionArgumentsInInterface(*Method, ClassName, Configuration) << "); });\n"
+                         << "}\n\n";
+                }
+
+                File << ClassName << " load() const\n"
+                     << "{\n"
+                     << "return value_.load();\n"
+                     << "}\n\n"
+                     << "void store(" << ClassName << " value)\n"
+                     << "{\n"
+                     << "value_.store(std::move(value));\n"
+                     << "}\n\n"
+                     << "private:\n"
+                     << "clang::type_erasure::" << (Configuration.CopyOnWrite ? "SnapshotSynchronized" : "Synchronized")
+                     << "<" << ClassName << "> value_;\n"
+                     << "};\n";
+            }
+
+            /// Methods of the synchronized variant that can also be called through the active object,
+            /// i.e. that do not take non-const lvalue references, which the caller can not observe
+            /// being written on the thread of the object.
+            void collectActiveObjectMethods(const CXXRecordDecl& Declaration,
+                                            std::vector<const CXXMethodDecl*>& Methods)
+            {
+                std::vector<const CXXMethodDecl*> Candidates;
+                collectSynchronizedMethods(Declaration, Candidates);
+                std::copy_if(begin(Candidates), end(Candidates), std::back_inserter(Methods), [](const auto Method)
+                {
+                    return std::none_of(Method->param_begin(), Method->param_end(), [](const auto& Param)
+                    {
+                        const auto Type = Param->getType();
+                        return Type->isLValueReferenceType() && !Type.getNonReferenceType().isConstQualified();
+                    });
+                });
+            }
+
+            /// 'Active<ClassName>' with '-active-object': owns a ClassName whose methods are called on a
+            /// dedicated thread. Each method is generated twice, returning a std::future of the result
+            /// and calling a completion callback with it. The arguments are captured by value.
+            void writeActiveObject(std::ostream& File,
+                                   const CXXRecordDecl& Declaration,
+                                   const std::string& ClassName,
+                                   const Config& Configuration)
+            {
+                if(!Configuration.ActiveObject)
+                    return;
+                const auto ActiveName = "Active" + ClassName;
+                File << "\n/// " << ClassName << " whose methods are called on a dedicated thread. Each method "
+                     << "returns a std::future of its result or calls done with it on that thread.\n"
+                     << "class " << ActiveName << "\n"
+                     << "{\n"
+                     << "public:\n"
+                     << "explicit " << ActiveName << "(" << ClassName << " value)\n"
+                     << ": active_(std::move(value))\n"
+                     << "{}\n\n";
+
+                std::vector<const CXXMethodDecl*> Methods;
+                collectActiveObjectMethods(Declaration, Methods);
+                for(const auto Method : Methods)
+                {
+                    std::stringstream Parameters;
+                    std::stringstream Captures;
+                    std::for_each(Method->param_begin(),
+                                  Method->param_end(),
+                                  [Method,&Parameters,&Captures](const auto& Param)
+                    {
+                        const auto Separator = Param == *Method->param_begin() ? "" : ", ";
+                        const auto Name = Param->getNameAsString();
+                        Parameters << Separator << Param->getType().getAsString(printingPolicy()) << ' ' << Name;
+                        Captures << Separator << Name << " = std::move(" << Name << ")";
+                    });
+                    const auto Call = "[" + Captures.str() + "](" + ClassName + "& object) mutable { return object." +
+                                      Method->getNameAsString() + "(" +
+                                      utils::useFunctionArgumentsInInterface(*Method, ClassName, Configuration) + "); }";
+
+                    File << "std::future<" << Method->getReturnType().getAsString(printingPolicy()) << "> "
+                         << Method->getNameAsString() << "(" << Parameters.str() << ")\n"
+                         << "{\n"
+                         << "return active_.call(" << Call << ");\n"
+                         << "}\n\n"
+                         << "template <class Done>\n"
+                         << "void " << Method->getNameAsString() << "(" << Parameters.str()
+                         << (Method->param_empty() ? "" : ", ") << "Done done)\n"
+                         << "{\n"
+                         << "active_.post(" << Call << ", std::move(done));\n"
+                         << "}\n\n";
+                }
+
+                File << "private:\n"
+                     << "clang::type_erasure::ActiveObject<" << ClassName << "> active_;\n"
+                     << "};\n";
+            }
+
+            void writeAtomic(std::ostream& File,
+                             const std::string& ClassName,
+                             const Config& Configuration)
+            {
+                if(!Configuration.Atomic)
+                    return;
+                File << "\nusing Atomic" << ClassName << " = clang::type_erasure::Atomic<" << ClassName << ">;\n";
+            }
+
+            void writeQueue(std::ostream& File,
+                            const std::string& ClassName,
+                            const Config& Configuration)
+            {
+                if(!Configuration.Queue)
+                    return;
+                File << "\ntemplate <std::size_t capacity>\n"
+                     << "using " << ClassName << "Queue = clang::type_erasure::Queue<" << ClassName << ", capacity>;\n";
+            }
+
+            /// Initializers of the function table, the sub-tables of the base interfaces come first.
+            std::vector<std::string> getTableEntries(const CXXRecordDecl& Declaration,
+                                                     const Config& Configuration)
+            {
+                std::vector<std::string> Entries;
+                for(const auto Base : utils::getInterfaceBases(Declaration))
+                {
+                    const auto BaseEntries = getTableEntries(*Base, Configuration);
+                    Entries.push_back(std::accumulate(begin(BaseEntries), end(BaseEntries), std::string("{ "),
+                                                      [](std::string Initializer, const std::string& Entry)
+                    {
+                        return Initializer += Entry + ", ";
+                    }) + "}");
+                }
+
+                const auto ClassName = Declaration.getName().str();
+                std::for_each(Declaration.method_begin(),
+                              Declaration.method_end(),
+                              [&Entries,&ClassName,&Configuration](const auto& Method)
+                {
+                    if(!Method->isUserProvided())
+                        return;
+                    Entries.push_back("&" + ClassName + "Detail::execution_wrapper<" + ClassName +
+                                      ", std::decay_t<T>>::" + utils::getFunctionName(*Method, Configuration));
+                    if(utils::hasBulkOperation(*Method, Configuration))
+                        Entries.push_back(Entries.back() + "_n");
+                });
+                return Entries;
+            }
+
+            /// Calls Method for count interfaces, runs with the same implementation are handed to
+            /// the bulk entry at once.
+            void writeBulkMethod(std::ostream& File,
+                                 const CXXMethodDecl& Method,
+                                 const std::string& ClassName,
+                                 const std::string& Table,
+                                 const Config& Configuration,
+                                 bool Memoizing)
+            {
+                const auto Const = std::string(Method.isConst() ? "const " : "");
+                const auto ResultType = utils::getBulkResultType(Method);
+                const auto Entry = Table + "." + utils::getFunctionName(Method, Configuration) + "_n";
+                File << "/// Calls " << Method.getNameAsString() << " for count objects";
+                if(ResultType != "void")
+                    File << " and stores the results in results[0..count)";
+                File << ". Consecutive objects with the same implementation type are handed to "
+                     << "'static void " << utils::getBulkName(Method) << "(" << Const << "Impl* const*, std::size_t"
+                     << (ResultType != "void" ? ", " + ResultType + "*" : "") << ", ...)' of the implementation, if provided.\n"
+                     << "static void " << utils::getBulkName(Method) << "(" << Const << ClassName << "* objects, std::size_t count";
+                if(ResultType != "void")
+                    File << ", " << ResultType << "* results";
+                std::for_each(Method.param_begin(),
+                              Method.param_end(),
+                              [&File](const auto& Param)
+                {
+                    File << ", " << Param->getType().getAsString(printingPolicy()) << ' ' << Param->getNameAsString();
+                });
+                File << ")" << utils::getNoexcept(Configuration) << "\n"
+                     << "{\n"
+                     << "type_erasure_table_detail::for_each_run(objects, count,\n"
+                     << "[](" << Const << ClassName << "& object) { "
+                     << (Configuration.NullObject ? "" : "assert(object." + Configuration.StorageObject + "); ")
+                     << (Memoizing && !Method.isConst() ? "object.invalidate_memos_(); " : "")
+                     << "return object." << Entry << "; },\n"
+                     << "[](" << Const << ClassName << "& object) { return object." << Configuration.StorageObject << ".object(); },\n"
+                     << "[&](" << Const << "void* const* data, std::size_t first, std::size_t n)\n"
+                     << "{\n"
+                     << "objects[first]." << Entry << "(data, n"
+                     << (ResultType != "void" ? ", results + first" : "")
+                     << utils::useBulkFunctionArguments(Method) << ");\n"
+                     << "});\n"
+                     << "}\n\n";
+            }
+
+            /// The interface and its storage flavours, with the copyability of their storages.
+            std::vector<std::pair<std::string, bool>> getFlavours(const std::string& ClassName,
+                                                                  const Config& Configuration)
+            {
+                std::vector<std::pair<std::string, bool>> Flavours{ {ClassName, !Configuration.NonCopyable} };
+                for(const auto& Flavour : Configuration.Flavours)
+                    Flavours.emplace_back(ClassName + Flavour.Suffix, !Flavour.NonCopyable);
+                return Flavours;
+            }
+
+            /// Copyable flavours can only take over the objects of copyable flavours.
+            bool isConvertible(const std::pair<std::string, bool>& From,
+                               const std::pair<std::string, bool>& To)
+            {
+                return From.first != To.first && (From.second || !To.second);
+            }
+
+            void writeConversionDeclarations(std::ostream& File,
+                                             const std::string& ClassName,
+                                             bool Copyable,
+                                             const std::vector<std::pair<std::string, bool>>& Flavours)
+            {
+                if(Flavours.empty())
+                    return;
+                File << "/// Converting moves from other storage flavours hand over the stored object, "
+                     << "which is not wrapped again.\n";
+                for(const auto& Flavour : Flavours)
+                    if(isConvertible(Flavour, {ClassName, Copyable}))
+                        File << ClassName << "(" << Flavour.first << "&& other);\n";
+                File << '\n';
+            }
+
+            /// The converting moves are defined after all flavours.
+            void writeConversions(std::ostream& File,
+                                  const std::vector<std::pair<std::string, bool>>& Flavours,
+                                  const Config& Configuration)
+            {
+                const auto& InterfaceName = Flavours.front().first;
+                for(const auto& To : Flavours)
+                    for(const auto& From : Flavours)
+                        if(isConvertible(From, To))
+                            File << "\ninline " << To.first << "::" << To.first << "(" << From.first << "&& other)\n"
+                                 << ": " << Configuration.FunctionTableObject << "(other." << Configuration.FunctionTableObject << "), "
+                                 << Configuration.StorageObject << "(std::move(other." << Configuration.StorageObject << "))\n"
+                                 << (Configuration.NullObject
+                                     ? "{\nother." + Configuration.FunctionTableObject + " = " + getEmptyTable(InterfaceName) + ";\n}\n"
+                                     : std::string("{}\n"));
+            }
+
+            /// Conversions from Derived to its base interface Base share or move the storage, which
+            /// requires the same storage tag. The descriptors of thin storages only hold the table of
+            /// the interface that created them.
+            bool supportsUpcast(const CXXRecordDecl& Derived,
+                                const CXXRecordDecl& Base,
+                                const Config& Configuration)
+            {
+                return !Configuration.Thin && utils::getStorageTag(Derived) == utils::getStorageTag(Base);
+            }
+
+            /// Interfaces in the main file that derive from Base and are converted to it, found
+            /// before Base is written.
+            void collectUpcastingInterfaces(const DeclContext& DeclarationContext,
+                                            const CXXRecordDecl& Base,
+                                            const SourceManager& SM,
+                                            const Config& Configuration,
+                                            std::vector<const CXXRecordDecl*>& Derived)
+            {
+                for(const auto Declaration : DeclarationContext.decls())
+                {
+                    if(const auto Namespace = dyn_cast<NamespaceDecl>(Declaration))
+                    {
+                        collectUpcastingInterfaces(*Namespace, Base, SM, Configuration, Derived);
+                        continue;
+                    }
+                    const auto Record = dyn_cast<CXXRecordDecl>(Declaration);
+                    if(!Record || !Record->isThisDeclarationADefinition() ||
+                       !SM.isWrittenInMainFile(Record->getBeginLoc()))
+                        continue;
+                    const auto Bases = utils::getInterfaceBases(*Record);
+                    if(std::any_of(begin(Bases), end(Bases), [&Base](const CXXRecordDecl* Candidate)
+                    {
+                        return Candidate->getCanonicalDecl() == Base.getCanonicalDecl();
+                    }) && supportsUpcast(*Record, Base, Configuration))
+                        Derived.push_back(Record);
+                }
+            }
+
             template <class Decl>
             bool isMember(const std::string& ClassName,
                           const Decl& Declaration)
@@ -335,6 +840,18 @@ namespace clang
             InterfaceFile << '\n';
 
             InterfaceFile << "#include " << Configuration.StorageInclude << "\n";
+            if(Configuration.Lazy)
+                InterfaceFile << "#include " << Configuration.LazyInclude << "\n";
+            if(Configuration.Atomic)
+                InterfaceFile << "#include " << Configuration.AtomicInclude << "\n";
+            if(Configuration.Synchronized)
+                InterfaceFile << "#include " << Configuration.SynchronizedInclude << "\n";
+            if(Configuration.ActiveObject)
+                InterfaceFile << "#include " << Configuration.ActiveObjectInclude << "\n";
+            if(Configuration.Queue)
+                InterfaceFile << "#include " << Configuration.QueueInclude << "\n";
+            if(Configuration.Instrument && !Configuration.CustomFunctionTable)
+                InterfaceFile << "#include " << Configuration.InstrumentationInclude << "\n";
 
             if(Configuration.CopyOnWrite || !Configuration.CustomFunctionTable) {
                 InterfaceFile << "#include <memory>\n";
@@ -372,6 +889,8 @@ namespace clang
                                                  AliasesAndStaticMemberString);
                 };
 
+                if(UsesMemoization)
+                    InterfaceFile << "#include " << Configuration.MemoizeInclude << "\n";
                 InterfaceFile << Content;
             } catch (...) {}
         }
@@ -397,7 +916,8 @@ namespace clang
             if(!Context.getSourceManager().isWrittenInMainFile(Declaration->getBeginLoc()))
                 return true;
             utils::handleClosingNamespaces(InterfaceFileStream, *Declaration, OpenNamespaces);
-            if(std::distance(Declaration->method_begin(), Declaration->method_end()) == 0)
+            if(std::distance(Declaration->method_begin(), Declaration->method_end()) == 0 &&
+               (!Configuration.CustomFunctionTable || utils::getInterfaceBases(*Declaration).empty()))
                 return true;
 
             return Configuration.CustomFunctionTable
@@ -521,72 +1041,317 @@ namespace clang
             return InterfaceFile;
         }
 
-        bool InterfaceGenerator::VisitCustomCXXRecordDecl(CXXRecordDecl* Declaration)
+        void InterfaceGenerator::writeCustomMethod(std::ostream& ClassStream,
+                                                   const CXXMethodDecl& Method,
+                                                   const std::string& ClassName,
+                                                   const std::string& Table,
+                                                   const std::string& Storage)
         {
-            const auto ClassName = Declaration->getName().str();
-            CurrentClass = ClassName;
-
-            std::stringstream ClassStream;
-            if(const auto Comment = Context.getCommentForDecl(Declaration, &PP))
+            if(const auto Comment = Context.getCommentForDecl(&Method, &PP))
                 copyComment(ClassStream, *Comment, Context.getSourceManager());
-            ClassStream << "class " << ClassName << "\n"
+
+            const auto ReturnType = Method.getReturnType().getAsString(printingPolicy());
+            ClassStream << ReturnType << ' '
+                        << Method.getNameAsString() << "(";
+            if(!Method.param_empty())
+                std::for_each(Method.param_begin(),
+                              Method.param_end(),
+                              [&Method,&ClassStream](const auto& Param)
+                {
+                    ClassStream << Param->getType().getAsString(printingPolicy()) << ' ' << Param->getNameAsString();
+                    if(&(*(Method.param_end()-1)) != &Param)
+                        ClassStream << ", ";
+                });
+
+
+            std::stringstream Call;
+            Call << Table << "." << utils::getFunctionName(Method, Configuration)
+                 << '('
+                 << (utils::returnsClassNameRef(Method, ClassName) ? "*this, " : "")
+                 << Storage << ".object()"
+                 << (Method.param_empty() ? "" : ", ")
+                 << utils::useFunctionArgumentsInInterface(Method, ClassName, Configuration)
+                 << ")";
+
+            // the views do not cache results
+            const auto InInterface = Memoizing && Storage == Configuration.StorageObject;
+            ClassStream << ")" << utils::getQualifiers(Method, Configuration)
+                        << "{\n"
+                        << (Configuration.NullObject ? "" : "assert(" + Storage + ");\n")
+                        << (InInterface && !Method.isConst() ? "invalidate_memos_();\n" : "")
+                        << (ReturnType == "void" ? "" : "return ");
+            if(InInterface && utils::isMemoized(Method, Configuration))
+            {
+                ClassStream << utils::getMemoCacheName(Method, Configuration) << ".get([&] { return " << Call.str() << "; }";
+                std::for_each(Method.param_begin(), Method.param_end(), [&ClassStream](const auto& Param)
+                {
+                    ClassStream << ", " << Param->getNameAsString();
+                });
+                ClassStream << ");\n";
+            }
+            else
+                ClassStream << Call.str() << ";\n";
+            ClassStream << "}\n\n";
+        }
+
+        void InterfaceGenerator::writeInheritedMethods(std::ostream& ClassStream,
+                                                       const CXXRecordDecl& Declaration,
+                                                       const std::string& Table,
+                                                       const std::string& Storage)
+        {
+            // the views only forward the methods, bulk operations and warnings belong to the interface
+            const auto InInterface = Storage == Configuration.StorageObject;
+            for(const auto Base : utils::getInterfaceBases(Declaration))
+            {
+                const auto BaseName = Base->getName().str();
+                const auto BaseTable = Table + "." + utils::getBaseTableName(BaseName);
+                writeInheritedMethods(ClassStream, *Base, BaseTable, Storage);
+                std::for_each(Base->method_begin(),
+                              Base->method_end(),
+                              [this,&ClassStream,&BaseName,&BaseTable,&Storage,InInterface](const auto& Method)
+                {
+                    if(!Method->isUserProvided())
+                        return;
+                    // methods of base interfaces that refer to the base interface can not be forwarded
+                    if(utils::refersTo(*Method, BaseName))
+                    {
+                        if(InInterface)
+                            llvm::errs() << " === " << CurrentClass << ": '" << Method->getNameAsString()
+                                         << "' refers to the base interface '" << BaseName << "' and is not inherited.\n";
+                        return;
+                    }
+                    writeCustomMethod(ClassStream, *Method, BaseName, BaseTable, Storage);
+                    if(InInterface && utils::hasBulkOperation(*Method, Configuration))
+                        writeBulkMethod(ClassStream, *Method, CurrentClass, BaseTable, Configuration, Memoizing);
+                });
+            }
+        }
+
+        void InterfaceGenerator::writeRef(std::ostream& ClassStream,
+                                          const CXXRecordDecl& Declaration)
+        {
+            const auto InterfaceName = Declaration.getName().str();
+            const auto RefName = InterfaceName + "Ref";
+            const auto TableType = getTableType(InterfaceName, Configuration);
+            ClassStream << "/// Non-owning view of an object that implements " << InterfaceName << ", obtained from "
+                        << InterfaceName << " or from interfaces that derive from it. The view is invalidated if the "
+                        << "interface is modified, moved or destroyed.\n"
+                        << "class " << RefName << "\n"
                         << "{\n"
                         << "public:\n"
-                        << getAliasesAndStaticMemberPlaceholder(CurrentClass) << "\n\n";
-            writeConstructors(ClassStream, ClassName, Configuration);
-            writeOperators(ClassStream, ClassName, Configuration);
+                        << RefName << "(const " << TableType << "& table, void* object) noexcept\n"
+                        << ": table_(&table), object_(object)\n"
+                        << "{}\n\n"
+                        << "explicit operator bool () const noexcept\n{\n"
+                        << "return object_ != nullptr;\n}\n\n"
+                        << "void* object() const noexcept\n{\n"
+                        << "return object_;\n}\n\n";
+
+            // methods that take or return the interface require the interface itself
+            std::for_each(Declaration.method_begin(),
+                          Declaration.method_end(),
+                          [this,&ClassStream,&InterfaceName](const auto& Method)
+            {
+                if(Method->isUserProvided() && !utils::refersTo(*Method, InterfaceName))
+                    writeCustomMethod(ClassStream, *Method, InterfaceName, "(*table_)", "(*this)");
+            });
+            writeInheritedMethods(ClassStream, Declaration, "(*table_)", "(*this)");
 
-            std::vector<std::string> FunctionNames;
-            std::for_each(Declaration->method_begin(),
-                          Declaration->method_end(),
-                          [this,&FunctionNames,&ClassName,&ClassStream](const auto& Method)
+            ClassStream << "private:\n"
+                        << "const " << TableType << "* table_;\n"
+                        << "void* object_;\n"
+                        << "};\n\n";
+        }
+
+        void InterfaceGenerator::writeRefConversions(std::ostream& ClassStream,
+                                                     const CXXRecordDecl& Declaration,
+                                                     const std::string& Table,
+                                                     std::vector<std::string>& Refs)
+        {
+            // the first path to a base that is reached along several paths is used
+            const auto RefName = Declaration.getName().str() + "Ref";
+            if(std::find(begin(Refs), end(Refs), RefName) != end(Refs))
+                return;
+            Refs.push_back(RefName);
+            ClassStream << "operator " << RefName << "() &\n{\n"
+                        << "return " << RefName << "(" << Table << ", " << Configuration.StorageObject << ".object());\n"
+                        << "}\n\n";
+            for(const auto Base : utils::getInterfaceBases(Declaration))
+                writeRefConversions(ClassStream, *Base, Table + "." + utils::getBaseTableName(Base->getName().str()), Refs);
+        }
+
+        void InterfaceGenerator::writeUpcasts(std::ostream& ClassStream,
+                                              const CXXRecordDecl& Declaration)
+        {
+            const auto ClassName = Declaration.getName().str();
+            for(const auto Base : utils::getInterfaceBases(Declaration))
             {
-                if(!Method->isUserProvided())
-                    return;
-                if(const auto Comment = Context.getCommentForDecl(Method, &PP))
-                    copyComment(ClassStream, *Comment, Context.getSourceManager());
+                const auto BaseName = Base->getName().str();
+                const auto BaseInterface = std::find_if(begin(Interfaces), end(Interfaces),
+                                                        [&BaseName](const Interface& Entry)
+                {
+                    return Entry.ClassName == BaseName;
+                });
+                // the descriptors of thin storages only hold the table of the interface that created them
+                if(Configuration.Thin)
+                {
+                    llvm::errs() << " === " << ClassName << ": no conversion to '" << BaseName << "' is generated, "
+                                 << "interfaces generated with '-thin', '-handle' or '-shared-memory' do not support upcasts.\n";
+                    continue;
+                }
+                // different storage types or the base is not generated from this file, otherwise the
+                // base has granted access to its constructor from table and storage, see writeUpcastAccess
+                if(!supportsUpcast(Declaration, *Base, Configuration) || BaseInterface == end(Interfaces))
+                {
+                    llvm::errs() << " === " << ClassName << ": no conversion to '" << BaseName << "' is generated, "
+                                 << "upcasts are supported along the first bases of interfaces in the same file.\n";
+                    continue;
+                }
 
-                FunctionNames.emplace_back(utils::getFunctionName(*Method, Configuration));
-                const auto ReturnType = Method->getReturnType().getAsString(printingPolicy());
-                ClassStream << ReturnType << ' '
-                            << Method->getNameAsString() << "(";
-                if(!Method->param_empty())
-                    std::for_each(Method->param_begin(),
-                                  Method->param_end(),
-                                  [&Method,&ClassStream](const auto& Param)
-                    {
-                        ClassStream << Param->getType().getAsString(printingPolicy()) << ' ' << Param->getNameAsString();
-                        if(&(*(Method->param_end()-1)) != &Param)
-                            ClassStream << ", ";
-                    });
+                // the storage is copied or moved, the table of the base is a sub-table
+                const auto BaseTable = Configuration.FunctionTableObject + "." + utils::getBaseTableName(BaseName);
+                ClassStream << "operator " << BaseName << "() const &\n{\n"
+                            << "return " << BaseName << "(" << BaseTable << ", " << Configuration.StorageObject << ");\n"
+                            << "}\n\n"
+                            << "operator " << BaseName << "() &&\n{\n";
+                if(Configuration.NullObject)
+                    ClassStream << BaseName << " base(" << BaseTable << ", std::move(" << Configuration.StorageObject << "));\n"
+                                << Configuration.FunctionTableObject << " = " << getEmptyTable(ClassName) << ";\n"
+                                << (Memoizing ? "invalidate_memos_();\n" : "")
+                                << "return base;\n";
+                else
+                    ClassStream << "return " << BaseName << "(" << BaseTable << ", std::move(" << Configuration.StorageObject << "));\n";
+                ClassStream << "}\n\n";
+            }
+        }
 
+        void InterfaceGenerator::writeUpcastAccess(std::ostream& ClassStream,
+                                                   const CXXRecordDecl& Declaration)
+        {
+            std::vector<const CXXRecordDecl*> Derived;
+            collectUpcastingInterfaces(*Context.getTranslationUnitDecl(), Declaration, Context.getSourceManager(),
+                                       Configuration, Derived);
+            if(Derived.empty())
+                return;
+
+            const auto ClassName = Declaration.getName().str();
+            for(const auto Interface : Derived)
+                ClassStream << "friend class " << Interface->getName().str() << ";\n";
+            ClassStream << "// used for upcasts from derived interfaces\n"
+                        << ClassName << "(" << ClassName << "Detail::" << Configuration.FunctionTableType << "<"
+                        << ClassName << "> function, "
+                        << utils::getStorageType(Configuration, utils::getStorageTag(Declaration)) << " impl)\n"
+                        << ": " << Configuration.FunctionTableObject << "(function), "
+                        << Configuration.StorageObject << "(std::move(impl))\n{}\n\n";
+        }
+
+        void InterfaceGenerator::writeCustomClass(std::ostream& ClassStream,
+                                                  const CXXRecordDecl& Declaration,
+                                                  const std::string& ClassName,
+                                                  const Config& ClassConfiguration)
+        {
+            const auto InterfaceName = Declaration.getName().str();
+            const auto StorageTag = utils::getStorageTag(Declaration);
+            const auto Flavours = utils::hasFlavours(Declaration, Configuration)
+                                  ? getFlavours(InterfaceName, Configuration)
+                                  : std::vector<std::pair<std::string, bool>>();
 
-                ClassStream << ")" << (Method->isConst() ? " const" : "")
-                            << "{\n"
-                            << "assert(" << Configuration.StorageObject << ");\n"
-                            << (ReturnType == "void" ? "" : "return ")
-                            << Configuration.FunctionTableObject << "." << utils::getFunctionName(*Method, Configuration)
-                            << '('
-                            << (utils::returnsClassNameRef(*Method, ClassName) ? "*this, " : "")
-                            << Configuration.StorageObject
-                            << (Method->param_empty() ? "" : ", ")
-                            << utils::useFunctionArgumentsInInterface(*Method, ClassName, Configuration)
-                            << ");\n"
-                            << "}\n\n";
+            if(const auto Comment = Context.getCommentForDecl(&Declaration, &PP))
+                copyComment(ClassStream, *Comment, Context.getSourceManager());
+            ClassStream << "class " << ClassName << "\n"
+                        << "{\n";
+            if(ClassName == InterfaceName)
+                writeUpcastAccess(ClassStream, Declaration);
+            for(const auto& Flavour : Flavours)
+                if(Flavour.first != ClassName)
+                    ClassStream << "friend class " << Flavour.first << ";\n";
+            ClassStream << "public:\n"
+                        << getAliasesAndStaticMemberPlaceholder(InterfaceName) << "\n\n";
+            const auto MemoizedMethods = utils::getMemoizedMethods(Declaration, Configuration);
+            Memoizing = !MemoizedMethods.empty();
+            UsesMemoization = UsesMemoization || Memoizing;
+            writeConstructors(ClassStream, ClassName, InterfaceName, ClassConfiguration, Memoizing);
+            writeConversionDeclarations(ClassStream, ClassName, !ClassConfiguration.NonCopyable, Flavours);
+            writeOperators(ClassStream, ClassName, InterfaceName, ClassConfiguration);
+
+            std::for_each(Declaration.method_begin(),
+                          Declaration.method_end(),
+                          [this,&ClassName,&InterfaceName,&ClassStream](const auto& Method)
+            {
+                if(!Method->isUserProvided())
+                    return;
+                const auto Table = getTable(InterfaceName, Configuration);
+                writeCustomMethod(ClassStream, *Method, InterfaceName, Table, Configuration.StorageObject);
+                if(utils::hasBulkOperation(*Method, Configuration))
+                    writeBulkMethod(ClassStream, *Method, ClassName, Table, Configuration, Memoizing);
             });
+            writeInheritedMethods(ClassStream, Declaration, getTable(InterfaceName, Configuration),
+                                  Configuration.StorageObject);
+            writeUpcasts(ClassStream, Declaration);
+            // non-const calls through the views would not invalidate the memoized results
+            if(Configuration.Refs && Memoizing)
+                llvm::errs() << " === " << ClassName << ": no conversion to '" << InterfaceName << "Ref' is generated, "
+                             << "'-refs' can not be combined with methods annotated with 'te_memoize'.\n";
+            else if(Configuration.Refs)
+            {
+                std::vector<std::string> Refs;
+                writeRefConversions(ClassStream, Declaration, getTable(InterfaceName, Configuration), Refs);
+            }
 
-            writeCasts(ClassStream, Configuration);
-            writePrivateSection(ClassStream, ClassName, Configuration);
+            writeCasts(ClassStream, ClassName, ClassConfiguration, Memoizing);
+            writeStorageStats(ClassStream, StorageTag, ClassConfiguration);
+            writePrivateSection(ClassStream, InterfaceName, StorageTag, ClassConfiguration);
+            writeMemoCaches(ClassStream, MemoizedMethods, Configuration);
             ClassStream << "};\n";
+        }
+
+        bool InterfaceGenerator::VisitCustomCXXRecordDecl(CXXRecordDecl* Declaration)
+        {
+            const auto ClassName = Declaration->getName().str();
+            CurrentClass = ClassName;
+
+            for(const auto Method : Declaration->methods())
+                if(utils::hasMemoizeAnnotation(*Method) && !utils::isMemoized(*Method, Configuration))
+                    llvm::errs() << " === " << ClassName << ": '" << Method->getNameAsString() << "' is not memoized, "
+                                 << "memoized methods are const, return a value and take their arguments by value "
+                                 << "or const reference.\n";
+
+            std::stringstream ClassStream;
+            if(Configuration.Refs)
+                writeRef(ClassStream, *Declaration);
+            writeCustomClass(ClassStream, *Declaration, ClassName, Configuration);
+            writeSynchronized(ClassStream, *Declaration, ClassName, Configuration);
+            writeActiveObject(ClassStream, *Declaration, ClassName, Configuration);
+            writeAtomic(ClassStream, ClassName, Configuration);
+            writeQueue(ClassStream, ClassName, Configuration);
+
+            if(utils::hasFlavours(*Declaration, Configuration))
+            {
+                for(const auto& Flavour : Configuration.Flavours)
+                {
+                    auto FlavourConfiguration = Configuration;
+                    FlavourConfiguration.CopyOnWrite = Flavour.CopyOnWrite;
+                    FlavourConfiguration.SmallBufferOptimization = Flavour.SmallBufferOptimization;
+                    FlavourConfiguration.NonCopyable = Flavour.NonCopyable;
+                    FlavourConfiguration.InlineOnly = Configuration.InlineOnly && Flavour.SmallBufferOptimization;
+                    FlavourConfiguration.StorageType = Flavour.StorageType;
+                    ClassStream << '\n';
+                    writeCustomClass(ClassStream, *Declaration, ClassName + Flavour.Suffix, FlavourConfiguration);
+                    writeSynchronized(ClassStream, *Declaration, ClassName + Flavour.Suffix, FlavourConfiguration);
+                }
+                writeConversions(ClassStream, getFlavours(ClassName, Configuration), Configuration);
+            }
+            else if(!Configuration.Flavours.empty())
+                llvm::errs() << " === " << ClassName << ": no storage flavours are generated for interfaces "
+                             << "in hierarchies or with methods that refer to the interface.\n";
 
-            const auto Initializer = std::accumulate(begin(FunctionNames),
-                                                     end(FunctionNames),
+            const auto Entries = getTableEntries(*Declaration, Configuration);
+            const auto Initializer = std::accumulate(begin(Entries),
+                                                     end(Entries),
                                                      std::string(),
-                                                     [&ClassName,&FunctionNames](std::string Initializer, const std::string& FunctionName)
+                                                     [&Entries](std::string Initializer, const std::string& Entry)
             {
-                return Initializer += "&" + ClassName + "Detail::execution_wrapper<" + ClassName +
-                                      ", type_erasure_table_detail::remove_reference_wrapper_t<std::decay_t<T>>>::" +
-                                      FunctionName + (&FunctionNames.back() != &FunctionName ? ", " : "");
+                return Initializer += Entry + (&Entries.back() != &Entry ? ", " : "");
             });
 
             InterfaceFileStream << getClassPlaceholder(Interfaces.size());
@@ -598,37 +1363,79 @@ namespace clang
         bool InterfaceGenerator::VisitSimpleCXXRecordDecl(CXXRecordDecl* Declaration)
         {
             const auto ClassName = Declaration->getName().str();
+            const auto QualifiedClassName = Declaration->getQualifiedNameAsString();
             CurrentClass = ClassName;
 
             std::stringstream ClassStream;
             std::stringstream BaseImplStream;
+            std::stringstream ImplStream;
             std::stringstream ForwardingStream;
             if(const auto Comment = Context.getCommentForDecl(Declaration, &PP))
                 copyComment(ClassStream, *Comment, Context.getSourceManager());
             ClassStream << "class " << ClassName << "\n"
                         << "{\n";
-            ClassStream << "struct Interface { virtual ~Interface() = default; ";
+            // hidden interfaces and final wrappers allow whole program devirtualization
+            ClassStream << "struct CLANG_TYPE_ERASE_HIDDEN Interface { virtual ~Interface() = default; ";
+            ClassStream << "virtual clang::type_erasure::polymorphic::TypeTag type_tag() const noexcept = 0;";
             if(!Configuration.NonCopyable)
             ClassStream << "virtual " << (Configuration.CopyOnWrite || Configuration.SmallBufferOptimization
                                           ? "std::shared_ptr<Interface>"
                                           : "std::unique_ptr<Interface>")
                         << "clone() const = 0;";
-            BaseImplStream << "template <class Impl> struct " << WRAPPER << " : Interface {"
-                           << "template <class T> " << WRAPPER <<"(T&& t) : impl(std::forward<T>(t)){}\n\n";
-            if(!Configuration.NonCopyable)
+            // the methods are implemented once for values and references, the final wrappers
+            // only differ in their type tags and copies
+            BaseImplStream << "template <class Impl> struct " << WRAPPER_BASE << " : Interface {"
+                           << "template <class T> " << WRAPPER_BASE << "(T&& t) : impl(std::forward<T>(t)){}\n\n";
+            const auto WriteWrapper = [&ClassStream,&Configuration](std::ostream& Stream,
+                                                                     const std::string& Wrapped,
+                                                                     const std::string& Base,
+                                                                     const std::string& Copy,
+                                                                     const std::string& Move,
+                                                                     bool WriteInterface)
             {
-                if(Configuration.CopyOnWrite || Configuration.SmallBufferOptimization)
-                    BaseImplStream << "std::shared_ptr<Interface> clone() const override {"
-                                   << "return std::make_shared<" << WRAPPER << "<Impl>>(impl);";
-                else
-                    BaseImplStream << "std::unique_ptr<Interface> clone() const override {"
-                                   << "return std::make_unique<" << WRAPPER << "<Impl>>(impl);";
-                BaseImplStream << "}\n\n";
-            }
+                Stream << "struct " << WRAPPER << (Wrapped == "Impl" ? "" : "<" + Wrapped + ">")
+                       << " final : " << Base << " {"
+                       << "template <class T> " << WRAPPER << "(T&& t) : " << Base << "(std::forward<T>(t)){}\n\n"
+                       << "clang::type_erasure::polymorphic::TypeTag type_tag() const noexcept override {"
+                       << "return clang::type_erasure::polymorphic::typeTag<" << Wrapped << ">();}\n\n";
+                if(!Configuration.NonCopyable)
+                {
+                    if(Configuration.CopyOnWrite || Configuration.SmallBufferOptimization)
+                        Stream << "std::shared_ptr<Interface> clone() const override {"
+                               << "return std::make_shared<" << WRAPPER << ">(" << Copy << ");";
+                    else
+                        Stream << "std::unique_ptr<Interface> clone() const override {"
+                               << "return std::make_unique<" << WRAPPER << ">(" << Copy << ");";
+                    Stream << "}\n\n";
+                }
+                // the small buffer storages copy and move objects in the buffer without allocation,
+                // the storages keep the returned pointers
+                if(Configuration.SmallBufferOptimization)
+                {
+                    if(!Configuration.NonCopyable)
+                    {
+                        if(WriteInterface)
+                            ClassStream << "virtual Interface* clone_into(void* buffer) const = 0;";
+                        Stream << "Interface* clone_into(void* buffer) const override {"
+                               << "return new(buffer) " << WRAPPER << "(" << Copy << ");}\n\n";
+                    }
+                    if(WriteInterface)
+                        ClassStream << "virtual Interface* move_into(void* buffer) = 0;";
+                    Stream << "Interface* move_into(void* buffer) override {"
+                           << "return new(buffer) " << WRAPPER << "(" << Move << ");}\n\n";
+                }
+                Stream << "};\n\n";
+            };
+            ImplStream << "template <class Impl> ";
+            WriteWrapper(ImplStream, "Impl", std::string(WRAPPER_BASE) + "<Impl>",
+                         "this->impl", "std::forward<Impl>(this->impl)", true);
+            ImplStream << "template <class Impl> ";
+            WriteWrapper(ImplStream, "std::reference_wrapper<Impl>", std::string(WRAPPER_BASE) + "<Impl&>",
+                         "std::ref(this->impl)", "std::ref(this->impl)", false);
 
             std::for_each(Declaration->method_begin(),
                           Declaration->method_end(),
-                          [this,&ClassName,
+                          [this,&ClassName,&QualifiedClassName,
                            &ClassStream,&BaseImplStream,&ForwardingStream](const auto& Method)
             {
                 if(!Method->isUserProvided())
@@ -649,7 +1456,7 @@ namespace clang
                         if(&(*(Method->param_end()-1)) != &Param)
                             SignatureStream << ", ";
                     });
-                SignatureStream << ")" << (Method->isConst() ? " const" : "");
+                SignatureStream << ")" << utils::getQualifiers(*Method);
                 const auto ReturnsReferenceToSelf = ClassName != ReturnType && utils::ContainsClassName(ReturnType, ClassName);
                 const auto SignatureEnd = SignatureStream.str();
                 const auto SignatureInInterface = (ReturnsReferenceToSelf ? std::string("void") : ReturnType) + ' ' +
@@ -661,8 +1468,10 @@ namespace clang
                             std::string Override, auto writeArgs, bool ReturnsReferenceToSelf, bool InInterface)
                 {
                     Stream << (InInterface ? SignatureInInterface : Signature) << " " << Override << " "
-                           << "{\n"
-                           << (!InInterface ? std::string("assert(") + StorageObject + ");\n" : std::string())
+                           << "{\n";
+                    if(InInterface)
+                        utils::writeInstrumentation(Stream, *Method, QualifiedClassName, Configuration);
+                    Stream << (!InInterface ? std::string("assert(") + StorageObject + ");\n" : std::string())
                            << (ReturnType == "void" || ReturnsReferenceToSelf ? "" : "return ")
                            << StorageObject << Accessor
                            << (InInterface ? Method->getNameAsString() : utils::getFunctionName(*Method, Configuration))
@@ -681,21 +1490,21 @@ namespace clang
 
             ClassStream << "};\n\n";
             BaseImplStream << "Impl impl;};\n\n"
-                           << "template <class Impl> struct " << WRAPPER << "<std::reference_wrapper<Impl>>"
-                           << " : " << WRAPPER << "<Impl&>{"
-                           << "template <class T> " << WRAPPER <<"(T&& t) : " << WRAPPER << "<Impl&>(std::forward<T>(t)){}\n\n"
-                           << "};\n\n";
+                           << ImplStream.str();
             ClassStream << BaseImplStream.str() << "\n"
                         << "public:\n"
                         << getAliasesAndStaticMemberPlaceholder(CurrentClass) << "\n\n";
 
-            writeConstructors(ClassStream, ClassName, Configuration);
+            writeConstructors(ClassStream, ClassName, ClassName, Configuration, false);
             ClassStream << ForwardingStream.str();
-            writeOperators(ClassStream, ClassName, Configuration);
+            writeOperators(ClassStream, ClassName, ClassName, Configuration);
 
-            writeCasts(ClassStream, Configuration);
-            writePrivateSection(ClassStream, ClassName, Configuration);
+            writeCasts(ClassStream, ClassName, Configuration, false);
+            writeStorageStats(ClassStream, ClassName, Configuration);
+            writePrivateSection(ClassStream, ClassName, ClassName, Configuration);
             ClassStream << "};\n";
+            writeAtomic(ClassStream, ClassName, Configuration);
+            writeQueue(ClassStream, ClassName, Configuration);
 
             InterfaceFileStream << getClassPlaceholder(Interfaces.size());
             Interfaces.emplace_back(CurrentClass, ClassStream.str());
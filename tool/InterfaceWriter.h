@@ -63,6 +63,46 @@ namespace clang
             bool VisitSimpleCXXRecordDecl(CXXRecordDecl* Declaration);
             bool VisitCustomCXXRecordDecl(CXXRecordDecl* Declaration);
 
+            /// Writes the interface with custom function table as ClassName, which is either the
+            /// interface itself or one of its storage flavours.
+            void writeCustomClass(std::ostream& ClassStream,
+                                  const CXXRecordDecl& Declaration,
+                                  const std::string& ClassName,
+                                  const Config& ClassConfiguration);
+
+            /// Forwards Method to Table, the object is provided by Storage.object().
+            void writeCustomMethod(std::ostream& ClassStream,
+                                   const CXXMethodDecl& Method,
+                                   const std::string& ClassName,
+                                   const std::string& Table,
+                                   const std::string& Storage);
+
+            /// Forwards the methods of the base interfaces to their sub-tables.
+            void writeInheritedMethods(std::ostream& ClassStream,
+                                       const CXXRecordDecl& Declaration,
+                                       const std::string& Table,
+                                       const std::string& Storage);
+
+            /// Non-owning view '<interface>Ref' of the object and table of an interface.
+            void writeRef(std::ostream& ClassStream,
+                          const CXXRecordDecl& Declaration);
+
+            /// Conversions to the views of the interface and of all its bases, which refer to
+            /// the sub-tables of the bases.
+            void writeRefConversions(std::ostream& ClassStream,
+                                     const CXXRecordDecl& Declaration,
+                                     const std::string& Table,
+                                     std::vector<std::string>& Refs);
+
+            /// Conversions to base interfaces that copy or move the storage.
+            void writeUpcasts(std::ostream& ClassStream,
+                              const CXXRecordDecl& Declaration);
+
+            /// Friend declarations of the interfaces that derive from the written interface and its
+            /// constructor from table and storage, which their upcasts use.
+            void writeUpcastAccess(std::ostream& ClassStream,
+                                   const CXXRecordDecl& Declaration);
+
             std::ofstream InterfaceFile;
             std::stringstream InterfaceFileStream;
             ASTContext& Context;
@@ -72,6 +112,10 @@ namespace clang
             std::vector<Interface> Interfaces;
             std::vector<AliasAndStaticMemberEntry> AliasesAndStaticMembers;
             std::string CurrentClass;
+            /// The class that is written has methods annotated with 'te_memoize', whose caches are
+            /// cleared by its non-const methods.
+            bool Memoizing = false;
+            bool UsesMemoization = false;
         };
     }
 }
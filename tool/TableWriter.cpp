@@ -19,6 +19,14 @@ namespace clang
                 Stream << "template < class " << Configuration.InterfaceType
                        << "> struct " << Configuration.FunctionTableType << " {\n";
 
+                // the tables of the base interfaces come first, such that upcasts copy sub-tables
+                for(const auto Base : utils::getInterfaceBases(Declaration))
+                {
+                    const auto BaseName = Base->getName().str();
+                    Stream << BaseName << "Detail::" << Configuration.FunctionTableType << "< " << BaseName << " > "
+                           << utils::getBaseTableName(BaseName) << " ;\n";
+                }
+
                 std::for_each(Declaration.method_begin(), Declaration.method_end(),
                               [&Stream,&Declaration,&Configuration](const auto& Method)
                 {
@@ -28,10 +36,87 @@ namespace clang
                     Stream << "using " << FunctionName << "_function = "
                            << utils::getFunctionPointer(*Method, Declaration.getName().str(), Configuration) << " ;\n"
                            << FunctionName << "_function " << FunctionName << " ;\n";
+                    if(utils::hasBulkOperation(*Method, Configuration))
+                        Stream << "using " << FunctionName << "_n_function = void ( * ) ( "
+                               << utils::getBulkFunctionArguments(*Method, Declaration.getName().str(),
+                                                                  utils::getStorageType(Configuration, utils::getStorageTag(Declaration)))
+                               << " )" << utils::getFunctionPointerNoexcept(Configuration) << " ;\n"
+                               << FunctionName << "_n_function " << FunctionName << "_n ;\n";
                 });
                 Stream << "};\n\n";
             }
 
+            /// Table of empty interfaces for '-null-object', whose entries report the call to the
+            /// failure handler, see ErrorHandling.h.
+            void writeEmptyTable(std::ostream& Stream,
+                                 const CXXRecordDecl& Declaration,
+                                 const Config& Configuration)
+            {
+                const auto TableType = Configuration.FunctionTableType + "< " + Configuration.InterfaceType + " >";
+                std::vector<std::string> Entries;
+                for(const auto Base : utils::getInterfaceBases(Declaration))
+                {
+                    const auto BaseName = Base->getName().str();
+                    Entries.push_back(BaseName + "Detail::empty_table< " + BaseName + " > ( )");
+                }
+                std::for_each(Declaration.method_begin(), Declaration.method_end(),
+                              [&Entries,&TableType,&Configuration](const auto& Method)
+                {
+                    if(!Method->isUserProvided())
+                        return;
+                    const auto FunctionName = utils::getFunctionName(*Method, Configuration);
+                    Entries.push_back("&clang::type_erasure::detail::EmptyCall< typename " + TableType + "::" +
+                                      FunctionName + "_function >::call");
+                    if(utils::hasBulkOperation(*Method, Configuration))
+                        Entries.push_back("&clang::type_erasure::detail::EmptyCall< typename " + TableType + "::" +
+                                          FunctionName + "_n_function >::call");
+                });
+
+                Stream << "template < class " << Configuration.InterfaceType << " >\n"
+                       << TableType << " empty_table ( ) noexcept\n{\n"
+                       << "return { ";
+                for(const auto& Entry : Entries)
+                    Stream << Entry << (&Entry == &Entries.back() ? "" : " ,\n");
+                Stream << " } ;\n"
+                       << "}\n\n";
+            }
+
+            /// The bulk entry calls the bulk operation of the implementation if it has one and
+            /// falls back to calling the method for each object otherwise.
+            void writeBulkWrapper(std::ostream& Stream,
+                                  const CXXMethodDecl& Method,
+                                  const std::string& ClassName,
+                                  const Config& Configuration)
+            {
+                const auto FunctionName = utils::getFunctionName(Method, Configuration);
+                const auto HasResults = utils::getBulkResultType(Method) != "void";
+                const auto Arguments = utils::getBulkFunctionArguments(Method, ClassName,
+                                                                       utils::getStorageType(Configuration, utils::getStorageTag(*Method.getParent())),
+                                                                       true);
+                const auto Object = std::string(Method.isConst() ? "const " : "") +
+                                    "type_erasure_table_detail::remove_reference_wrapper_t< Impl >";
+                const auto UseArguments = utils::useBulkFunctionArguments(Method);
+
+                const auto Noexcept = utils::getNoexcept(Configuration);
+                Stream << "static void " << FunctionName << "_n ( " << Arguments << " )" << Noexcept << "\n{\n"
+                       << FunctionName << "_n ( HasBulkMemFn_" << FunctionName
+                       << "< type_erasure_table_detail::remove_reference_wrapper_t< Impl > > ( ) , data , count"
+                       << (HasResults ? " , results" : "") << UseArguments << " );\n"
+                       << "}\n\n"
+                       << "static void " << FunctionName << "_n ( std::true_type , " << Arguments << " )" << Noexcept << "\n{\n"
+                       << "type_erasure_table_detail::for_each_chunk< Impl >( data , count , [&]( " << Object
+                       << " * const * objects , std::size_t first , std::size_t n )\n{\n"
+                       << "type_erasure_table_detail::remove_reference_wrapper_t< Impl >::" << utils::getBulkName(Method)
+                       << " ( objects , n" << (HasResults ? " , results + first" : "") << UseArguments << " );\n"
+                       << (HasResults ? "" : "(void)first;\n")
+                       << "} );\n"
+                       << "}\n\n"
+                       << "static void " << FunctionName << "_n ( std::false_type , " << Arguments << " )" << Noexcept << "\n{\n"
+                       << "for ( std::size_t i = 0 ; i < count ; ++i )\n"
+                       << (HasResults ? "results[i] = " : "") << FunctionName << " ( data[i]" << UseArguments << " );\n"
+                       << "}\n\n";
+            }
+
             void writeWrapper(std::ostream& Stream,
                               const CXXRecordDecl& Declaration,
                               const Config& Configuration)
@@ -55,11 +140,13 @@ namespace clang
                     if( std::get<1>(NewReturnType) )
                         Stream << (Method->getReturnType().isConstQualified() ? "const " : "") << Configuration.InterfaceType << " & "
                                << Configuration.InterfaceObject << ", ";
-                    Stream << utils::getFunctionArguments(*Method, ClassName, Configuration.StorageType, true)
-                           << " )\n{\n"
-                           << (Method->getReturnType().getAsString(printingPolicy()) == "void" || ReturnsClassNameRef
+                    Stream << utils::getFunctionArguments(*Method, ClassName,
+                                                       utils::getStorageType(Configuration, utils::getStorageTag(Declaration)), true)
+                           << " )" << utils::getNoexcept(Configuration) << "\n{\n";
+                    utils::writeInstrumentation(Stream, *Method, Declaration.getQualifiedNameAsString(), Configuration);
+                    Stream << (Method->getReturnType().getAsString(printingPolicy()) == "void" || ReturnsClassNameRef
                                ? "" : "return ")
-                           << "data.template get<Impl>()."
+                           << "type_erasure_table_detail::object_access<Impl>::get(data)."
                            << Method->getNameAsString() << " ( "
                            << utils::useFunctionArguments(*Method, ClassName, Configuration)
                            << " );\n"
@@ -67,16 +154,50 @@ namespace clang
                                ? std::string("return ") + Configuration.InterfaceObject + ";\n"
                                : std::string(""))
                            << "}\n\n";
+                    if(utils::hasBulkOperation(*Method, Configuration))
+                        writeBulkWrapper(Stream, *Method, ClassName, Configuration);
                 });
                 Stream << "} ;\n\n";
             }
 
+            /// Bulk operations of implementations are optional, thus not part of the concept.
+            void writeBulkConcept(std::ostream& Stream,
+                                  const CXXMethodDecl& Method,
+                                  const Config& Configuration)
+            {
+                const auto FunctionName = utils::getFunctionName(Method, Configuration);
+                const auto ResultType = utils::getBulkResultType(Method);
+                Stream << "template < class T >\n"
+                       << "using TryBulkMemFn_" << FunctionName << " = "
+                       << "decltype( T::" << utils::getBulkName(Method) << "( std::declval< "
+                       << (Method.isConst() ? "const " : "") << "T * const * >() , std::size_t()"
+                       << (ResultType != "void" ? " , std::declval< " + ResultType + " * >()" : "");
+                std::for_each(Method.param_begin(),
+                              Method.param_end(),
+                              [&Stream](const auto& Param)
+                {
+                    Stream << " , std::declval< " << Param->getType().getAsString(printingPolicy()) << " & >()";
+                });
+                Stream << " ) );\n"
+                       << '\n'
+                       << "template < class T , class = void >\n"
+                       << "struct HasBulkMemFn_" << FunctionName << " : std::false_type"
+                       << "{};\n"
+                       << '\n'
+                       << "template < class T >\n"
+                       << "struct HasBulkMemFn_" << FunctionName
+                       << "< T , type_erasure_table_detail::voider< TryBulkMemFn_" << FunctionName << " < T > > > : std::true_type"
+                       << "{};\n\n";
+            }
+
             void writeConcepts(std::ofstream& Stream,
                                const CXXRecordDecl& Declaration,
                                const Config& Configuration)
             {
                 std::vector<std::string> Concepts;
                 Concepts.reserve(std::distance(Declaration.method_begin(), Declaration.method_end()));
+                for(const auto Base : utils::getInterfaceBases(Declaration))
+                    Concepts.emplace_back(Base->getName().str() + "Detail::ConceptImpl");
 
                 std::for_each(Declaration.method_begin(),
                               Declaration.method_end(),
@@ -89,6 +210,8 @@ namespace clang
                     const auto TryMemFnName = "TryMemFn_" + FunctionName;
                     const auto HasMemFnName = "HasMemFn_" + FunctionName;
                     Concepts.emplace_back(HasMemFnName);
+                    if(utils::hasBulkOperation(*Method, Configuration))
+                        writeBulkConcept(Stream, *Method, Configuration);
 
                     Stream << "template < class T >\n"
                            << "using " << TryMemFnName << " = "
@@ -135,6 +258,8 @@ namespace clang
             TableFile << "#pragma once\n\n"
                         << "#include " << Configuration.UtilInclude << '\n'
                         << "#include " << Configuration.StorageInclude << "\n\n";
+            if(Configuration.Instrument)
+                TableFile << "#include " << Configuration.InstrumentationInclude << "\n\n";
             if(Configuration.CopyOnWrite)
                 TableFile << "#include <memory>\n\n";
         }
@@ -163,16 +288,51 @@ namespace clang
             if(!Context.getSourceManager().isWrittenInMainFile(Declaration->getBeginLoc()))
                 return true;
             utils::handleClosingNamespaces(TableFile, *Declaration, OpenNamespaces);
-            if(std::distance(Declaration->method_begin(), Declaration->method_end()) == 0)
+            if(std::distance(Declaration->method_begin(), Declaration->method_end()) == 0 &&
+               utils::getInterfaceBases(*Declaration).empty())
                 return true;
 
+            // the storage type refers to the interface
+            if(Configuration.CustomFunctionTable)
+                TableFile << "class " << Declaration->getName().str() << ";\n\n";
             TableFile << "namespace " << Declaration->getName().str() << "Detail {\n";
 
             writeTable(TableFile, *Declaration, Configuration);
-            writeWrapper(TableFile, *Declaration, Configuration);
+            if(Configuration.NullObject)
+                writeEmptyTable(TableFile, *Declaration, Configuration);
+            // the wrapper dispatches on the optional bulk operations detected with the concepts
             writeConcepts(TableFile, *Declaration, Configuration);
+            writeWrapper(TableFile, *Declaration, Configuration);
 
             TableFile << "}\n\n";
+
+            // conversions to base interfaces share the storage instead of wrapping the derived interface
+            const auto ClassName = Declaration->getName().str();
+            for(const auto Base : utils::getInterfaceBases(*Declaration))
+            {
+                if(utils::getStorageTag(*Base) != utils::getStorageTag(*Declaration) ||
+                   !Context.getSourceManager().isWrittenInMainFile(Base->getBeginLoc()))
+                    continue;
+                const auto BaseName = Base->getName().str();
+                TableFile << "namespace " << BaseName << "Detail {\n"
+                          << "template <>\n"
+                          << "struct Concept<" << BaseName << ", " << ClassName << ", false> : std::false_type\n"
+                          << "{};\n"
+                          << "}\n\n";
+            }
+
+            // storage flavours are converted with converting moves instead of wrapping them
+            if(utils::hasFlavours(*Declaration, Configuration))
+            {
+                for(const auto& Flavour : Configuration.Flavours)
+                    TableFile << "class " << ClassName << Flavour.Suffix << ";\n";
+                TableFile << "\nnamespace " << ClassName << "Detail {\n";
+                for(const auto& Flavour : Configuration.Flavours)
+                    TableFile << "template <>\n"
+                              << "struct Concept<" << ClassName << ", " << ClassName << Flavour.Suffix << ", false> : std::false_type\n"
+                              << "{};\n";
+                TableFile << "}\n\n";
+            }
             return true;
         }
 
@@ -2,9 +2,11 @@
 
 #include "Config.h"
 
+#include "clang/AST/Attr.h"
 #include "clang/AST/DeclCXX.h"
 #include "clang/AST/PrettyPrinter.h"
 
+#include <algorithm>
 #include <regex>
 #include <sstream>
 
@@ -45,6 +47,21 @@ namespace clang
                 }
 
 
+                void writeParameters(std::ostream& Stream,
+                                     const CXXMethodDecl& Method,
+                                     const std::string& ClassName,
+                                     const std::string& Storage,
+                                     bool PrintNames)
+                {
+                    std::for_each(Method.param_begin(),
+                                  Method.param_end(),
+                                  [&Stream,&ClassName,&PrintNames,&Storage](const auto& Param)
+                    {
+                        Stream << " , " << replaceClassNameInParam(Param->getType().getAsString(printingPolicy()), ClassName, Storage)
+                               << (PrintNames ? (' ' + Param->getNameAsString()).c_str() : "");
+                    });
+                }
+
                 bool isMovable(const std::string& Type)
                 {
                     return std::regex_match(Type, std::regex(".*&&\\s*")) ||
@@ -59,8 +76,10 @@ namespace clang
                     if(!Configuration.CustomFunctionTable || !ContainsClassName(ArgType, ClassName))
                         return ArgName;
 
+                    // the argument stores an object of the same type, which is unwrapped at compile time
                     const auto IsPtr = std::regex_match(ArgType, std::regex(".*\\*"));
-                    return (IsPtr ? "& " : "") + ArgName + ".template get<Impl>()";
+                    return (IsPtr ? "& " : "") + std::string("type_erasure_table_detail::object_access<Impl>::get(") +
+                           ArgName + ".object())";
                 }
 
                 std::string adjustArgumentForInterface(const std::string& ArgType,
@@ -151,22 +170,71 @@ namespace clang
             }
 
 
+            std::string getQualifiers(const CXXMethodDecl& Method)
+            {
+                const auto Prototype = Method.getType()->getAs<FunctionProtoType>();
+                return std::string(Method.isConst() ? " const" : "") +
+                       (Prototype && Prototype->isNothrow() ? " noexcept" : "");
+            }
+
+
+            std::string getQualifiers(const CXXMethodDecl& Method, const Config& Configuration)
+            {
+                const auto Prototype = Method.getType()->getAs<FunctionProtoType>();
+                return std::string(Method.isConst() ? " const" : "") +
+                       ((Prototype && Prototype->isNothrow()) || Configuration.NoExceptions ? " noexcept" : "");
+            }
+
+
+            std::string getNoexcept(const Config& Configuration)
+            {
+                return Configuration.NoExceptions ? " noexcept" : "";
+            }
+
+
+            std::string getFunctionPointerNoexcept(const Config& Configuration)
+            {
+                return Configuration.NoExceptions && Configuration.CppStandard >= 17 ? " noexcept" : "";
+            }
+
+
             std::string getFunctionArguments(const CXXMethodDecl& Method,
                                              const std::string& ClassName,
                                              const std::string& Storage,
                                              bool PrintNames)
             {
                 std::stringstream Stream;
-                Stream << (Method.isConst() ? "const " : "") << Storage << " & " << (PrintNames ? " data" : "");
-                if(!Method.param_empty())
-                    std::for_each(Method.param_begin(),
-                                  Method.param_end(),
-                                  [&Stream,&ClassName,&PrintNames,&Storage](const auto& Param)
-                    {
-                        Stream << " , " << replaceClassNameInParam(Param->getType().getAsString(printingPolicy()), ClassName, Storage)
-                               << (PrintNames ? (' ' + Param->getNameAsString()).c_str() : "");
-                    });
+                Stream << (Method.isConst() ? "const " : "") << "void * " << (PrintNames ? " data" : "");
+                writeParameters(Stream, Method, ClassName, Storage, PrintNames);
+                return Stream.str();
+            }
+
 
+            std::string getBulkFunctionArguments(const CXXMethodDecl& Method,
+                                                 const std::string& ClassName,
+                                                 const std::string& Storage,
+                                                 bool PrintNames)
+            {
+                std::stringstream Stream;
+                Stream << (Method.isConst() ? "const " : "") << "void * const * " << (PrintNames ? " data" : "")
+                       << " , std::size_t " << (PrintNames ? " count" : "");
+                const auto ResultType = getBulkResultType(Method);
+                if(ResultType != "void")
+                    Stream << " , " << ResultType << " * " << (PrintNames ? " results" : "");
+                writeParameters(Stream, Method, ClassName, Storage, PrintNames);
+                return Stream.str();
+            }
+
+
+            std::string useBulkFunctionArguments(const CXXMethodDecl& Method)
+            {
+                std::stringstream Stream;
+                std::for_each(Method.param_begin(),
+                              Method.param_end(),
+                              [&Stream](const auto& Param)
+                {
+                    Stream << " , " << Param->getNameAsString();
+                });
                 return Stream.str();
             }
 
@@ -294,9 +362,199 @@ namespace clang
                 Stream << std::get<0>(ReturnType) << " ( * ) ( ";
                 if( std::get<1>(ReturnType) )
                     Stream << (Method.getReturnType().isConstQualified() ? "const " : "") << Configuration.InterfaceType << " & , ";
-                Stream << getFunctionArguments(Method, ClassName, Configuration.StorageType) << " )";
+                Stream << getFunctionArguments(Method, ClassName,
+                                               getStorageType(Configuration, getStorageTag(*Method.getParent()))) << " )"
+                       << getFunctionPointerNoexcept(Configuration);
+                return Stream.str();
+            }
+
+
+            bool hasBulkOperation(const CXXMethodDecl& Method,
+                                  const Config& Configuration)
+            {
+                if(!Configuration.Bulk || !Configuration.CustomFunctionTable ||
+                   !Method.getDeclName().isIdentifier() || Method.getReturnType()->isReferenceType() ||
+                   refersTo(Method, Method.getParent()->getName().str()))
+                    return false;
+                return std::none_of(Method.param_begin(), Method.param_end(), [](const auto& Param)
+                {
+                    return Param->getType()->isRValueReferenceType();
+                });
+            }
+
+
+            std::string getBulkName(const CXXMethodDecl& Method)
+            {
+                return Method.getNameAsString() + "_n";
+            }
+
+
+            std::string getBulkResultType(const CXXMethodDecl& Method)
+            {
+                return Method.getReturnType().getUnqualifiedType().getAsString(printingPolicy());
+            }
+
+
+            bool hasMemoizeAnnotation(const CXXMethodDecl& Method)
+            {
+                return std::any_of(Method.specific_attr_begin<AnnotateAttr>(),
+                                   Method.specific_attr_end<AnnotateAttr>(),
+                                   [](const AnnotateAttr* Attribute)
+                {
+                    return Attribute->getAnnotation() == "te_memoize";
+                });
+            }
+
+
+            bool isMemoized(const CXXMethodDecl& Method,
+                            const Config& Configuration)
+            {
+                if(!Configuration.CustomFunctionTable || !hasMemoizeAnnotation(Method) || !Method.isConst() ||
+                   Method.getReturnType()->isVoidType() || Method.getReturnType()->isReferenceType() ||
+                   refersTo(Method, Method.getParent()->getName().str()))
+                    return false;
+                return std::none_of(Method.param_begin(), Method.param_end(), [](const auto& Param)
+                {
+                    const auto Type = Param->getType();
+                    return Type->isRValueReferenceType() ||
+                           (Type->isLValueReferenceType() && !Type.getNonReferenceType().isConstQualified());
+                });
+            }
+
+
+            std::vector<const CXXMethodDecl*> getMemoizedMethods(const CXXRecordDecl& Declaration,
+                                                                 const Config& Configuration)
+            {
+                std::vector<const CXXMethodDecl*> Methods;
+                for(const auto Base : getInterfaceBases(Declaration))
+                {
+                    const auto BaseMethods = getMemoizedMethods(*Base, Configuration);
+                    Methods.insert(end(Methods), begin(BaseMethods), end(BaseMethods));
+                }
+                for(const auto Method : Declaration.methods())
+                    if(Method->isUserProvided() && isMemoized(*Method, Configuration))
+                        Methods.push_back(Method);
+                return Methods;
+            }
+
+
+            std::string getMemoCacheName(const CXXMethodDecl& Method,
+                                         const Config& Configuration)
+            {
+                return Method.getParent()->getName().str() + "_" + getFunctionName(Method, Configuration) + "_memo_";
+            }
+
+
+            std::string getMemoCacheType(const CXXMethodDecl& Method,
+                                         const Config& Configuration)
+            {
+                std::stringstream Stream;
+                Stream << "clang::type_erasure::MemoCache<" << Configuration.MemoizePolicy << ", "
+                       << Configuration.MemoizeCacheSize << ", " << getBulkResultType(Method);
+                std::for_each(Method.param_begin(), Method.param_end(), [&Stream](const auto& Param)
+                {
+                    Stream << ", " << Param->getType().getAsString(printingPolicy());
+                });
+                Stream << ">";
                 return Stream.str();
             }
+
+
+            std::string getStorageTagType(const Config& Configuration,
+                                          const std::string& ClassName)
+            {
+                return Configuration.DeferredDestruction
+                        ? "clang::type_erasure::DeferredDestruction<" + ClassName + ">"
+                        : ClassName;
+            }
+
+
+            std::string getStorageType(const Config& Configuration,
+                                       const std::string& ClassName)
+            {
+                if(!Configuration.CustomFunctionTable)
+                    return Configuration.StorageType;
+                auto StorageType = Configuration.StorageType;
+                return StorageType.insert(StorageType.rfind('>'), ", " + getStorageTagType(Configuration, ClassName));
+            }
+
+
+            std::vector<const CXXRecordDecl*> getInterfaceBases(const CXXRecordDecl& Declaration)
+            {
+                std::vector<const CXXRecordDecl*> Bases;
+                for(const auto& Base : Declaration.bases())
+                    if(Base.getAccessSpecifier() == AS_public)
+                        if(const auto BaseDeclaration = Base.getType()->getAsCXXRecordDecl())
+                            Bases.push_back(BaseDeclaration);
+                return Bases;
+            }
+
+
+            std::string getBaseTableName(const std::string& BaseName)
+            {
+                return BaseName + "_table";
+            }
+
+
+            std::string getStorageTag(const CXXRecordDecl& Declaration)
+            {
+                const auto Bases = getInterfaceBases(Declaration);
+                return Bases.empty() ? Declaration.getName().str() : getStorageTag(*Bases.front());
+            }
+
+
+            bool refersTo(const CXXMethodDecl& Method,
+                          const std::string& ClassName)
+            {
+                return ContainsClassName(Method.getReturnType().getAsString(printingPolicy()), ClassName) ||
+                       std::any_of(Method.param_begin(), Method.param_end(), [&ClassName](const auto& Param)
+                {
+                    return ContainsClassName(Param->getType().getAsString(printingPolicy()), ClassName);
+                });
+            }
+
+
+            bool hasFlavours(const CXXRecordDecl& Declaration,
+                             const Config& Configuration)
+            {
+                if(!Configuration.CustomFunctionTable || Configuration.Flavours.empty() ||
+                   !getInterfaceBases(Declaration).empty())
+                    return false;
+                const auto ClassName = Declaration.getName().str();
+                return std::none_of(Declaration.method_begin(), Declaration.method_end(),
+                                    [&ClassName](const auto& Method)
+                {
+                    return Method->isUserProvided() && refersTo(*Method, ClassName);
+                });
+            }
+
+
+            void writeInstrumentation(std::ostream& OS,
+                                      const CXXMethodDecl& Method,
+                                      const std::string& QualifiedClassName,
+                                      const Config& Configuration)
+            {
+                if(!Configuration.Instrument)
+                    return;
+
+                std::stringstream Signature;
+                Signature << Method.getNameAsString() << "(";
+                std::for_each(Method.param_begin(),
+                              Method.param_end(),
+                              [&Method,&Signature](const auto& Param)
+                {
+                    Signature << (Param == *Method.param_begin() ? "" : ", ")
+                              << Param->getType().getAsString(printingPolicy());
+                });
+                Signature << ")" << (Method.isConst() ? " const" : "");
+
+                OS << "static auto& type_erasure_counters = clang::type_erasure::detail::registerMethod(\""
+                   << QualifiedClassName << "\", \"" << Signature.str() << "\", "
+                   << "clang::type_erasure::detail::typeName<"
+                   << (Configuration.CustomFunctionTable ? "std::remove_const_t<type_erasure_table_detail::remove_reference_wrapper_t<Impl>>" : "Impl")
+                   << ">());\n"
+                   << "const clang::type_erasure::MethodCall type_erasure_call(type_erasure_counters);\n";
+            }
         }
     }
 }
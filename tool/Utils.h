@@ -5,11 +5,13 @@
 #include <stack>
 #include <string>
 #include <tuple>
+#include <vector>
 
 namespace clang
 {
     struct PrintingPolicy;
     class CXXMethodDecl;
+    class CXXRecordDecl;
     class QualType;
 
     namespace type_erasure
@@ -33,11 +35,34 @@ namespace clang
 
             std::string getFunctionName(const CXXMethodDecl& Method, const Config& Configuration);
 
+            /// " const" and " noexcept", as declared for Method.
+            std::string getQualifiers(const CXXMethodDecl& Method);
+
+            /// Qualifiers of the generated methods, which are noexcept with '-no-exceptions'.
+            std::string getQualifiers(const CXXMethodDecl& Method, const Config& Configuration);
+
+            /// " noexcept" for the generated functions with '-no-exceptions'.
+            std::string getNoexcept(const Config& Configuration);
+
+            /// " noexcept" for the function pointer types of the tables with '-no-exceptions',
+            /// the exception specification is only part of function types since C++17.
+            std::string getFunctionPointerNoexcept(const Config& Configuration);
+
             std::string getFunctionArguments(const CXXMethodDecl& Method,
                                              const std::string& ClassName,
                                              const std::string& Storage,
                                              bool PrintNames=false);
 
+            /// Arguments of the bulk entry of Method in the function table: the stored objects, their
+            /// number, the results if Method returns a value and the arguments of Method.
+            std::string getBulkFunctionArguments(const CXXMethodDecl& Method,
+                                                 const std::string& ClassName,
+                                                 const std::string& Storage,
+                                                 bool PrintNames=false);
+
+            /// The argument names of Method, as lvalues, since they are used for multiple objects.
+            std::string useBulkFunctionArguments(const CXXMethodDecl& Method);
+
             std::string useFunctionArguments(const CXXMethodDecl& Method,
                                              const std::string& ClassName,
                                              const Config& Configuration);
@@ -58,6 +83,74 @@ namespace clang
                                            const std::string& ClassName,
                                            const Config& Configuration);
 
+            /// With '-bulk', methods get a bulk operation if their arguments can be used for multiple
+            /// objects and their results can be stored in an array.
+            bool hasBulkOperation(const CXXMethodDecl& Method,
+                                  const Config& Configuration);
+
+            /// Name of the bulk operation of Method, in the interface and in the implementations.
+            std::string getBulkName(const CXXMethodDecl& Method);
+
+            /// Result type of the bulk operation of Method, "void" if Method does not return a value.
+            std::string getBulkResultType(const CXXMethodDecl& Method);
+
+            /// True if Method is annotated with '[[clang::annotate("te_memoize")]]'.
+            bool hasMemoizeAnnotation(const CXXMethodDecl& Method);
+
+            /// In custom mode, annotated const methods that return a value and take their arguments
+            /// by value or const reference are memoized.
+            bool isMemoized(const CXXMethodDecl& Method,
+                            const Config& Configuration);
+
+            /// Memoized methods of an interface and of its bases, which share the caches of the interface.
+            std::vector<const CXXMethodDecl*> getMemoizedMethods(const CXXRecordDecl& Declaration,
+                                                                 const Config& Configuration);
+
+            /// Name of the cache of a memoized method in the interface.
+            std::string getMemoCacheName(const CXXMethodDecl& Method,
+                                         const Config& Configuration);
+
+            /// 'clang::type_erasure::MemoCache' for the results of Method, with the policy and size
+            /// of '-memoize-policy' and '-memoize-cache-size'.
+            std::string getMemoCacheType(const CXXMethodDecl& Method,
+                                         const Config& Configuration);
+
+            /// Tag of the storages of the interface ClassName, wrapped in 'DeferredDestruction'
+            /// for '-deferred-destruction'.
+            std::string getStorageTagType(const Config& Configuration,
+                                          const std::string& ClassName);
+
+            /// In custom mode, the interface is passed as tag to the storage, to identify
+            /// it in the storage statistics.
+            std::string getStorageType(const Config& Configuration,
+                                       const std::string& ClassName);
+
+            /// Public bases of an interface, which are interfaces themselves.
+            std::vector<const CXXRecordDecl*> getInterfaceBases(const CXXRecordDecl& Declaration);
+
+            /// Name of the sub-table of a base interface in the function table.
+            std::string getBaseTableName(const std::string& BaseName);
+
+            /// Interfaces in a hierarchy share the storage tag of the root interface (following the
+            /// first base), such that upcasts can move or share the storage.
+            std::string getStorageTag(const CXXRecordDecl& Declaration);
+
+            /// True if the return type or a parameter of Method refers to ClassName.
+            bool refersTo(const CXXMethodDecl& Method,
+                          const std::string& ClassName);
+
+            /// Storage flavours are generated for interfaces that are not part of a hierarchy and
+            /// do not refer to themselves, such that all flavours share the function table.
+            bool hasFlavours(const CXXRecordDecl& Declaration,
+                             const Config& Configuration);
+
+            /// Writes the counting of the calls of Method for the implementation 'Impl' if
+            /// '-instrument' is set.
+            void writeInstrumentation(std::ostream& OS,
+                                      const CXXMethodDecl& Method,
+                                      const std::string& QualifiedClassName,
+                                      const Config& Configuration);
+
             template <class Decl>
             void handleClosingNamespaces(std::ostream& File,
                                          const Decl& Declaration,